@@ -147,3 +147,43 @@ aql_add_value(aql_adt_t *adt, domain_t domain, void *value_ptr)
 
   return DB_OK;
 }
+
+#if DB_FEATURE_GROUP
+db_result_t
+aql_set_group_attribute(aql_adt_t *adt, char *name)
+{
+  aql_attribute_t *attr;
+  aql_attribute_t *aggregated;
+  int i;
+
+  /* Group on a projected or processed attribute if there is one. An
+     aggregated attribute, as in SELECT SUM(k) ... GROUP BY k, is read
+     from the same column, so it is used rather than added again. */
+  aggregated = NULL;
+  for(i = 0; i < AQL_ATTRIBUTE_COUNT(adt); i++) {
+    attr = &adt->attributes[i];
+    if(strcmp(attr->name, name) == 0) {
+      if(adt->aggregators[i] == AQL_NONE) {
+        attr->flags |= ATTRIBUTE_FLAG_GROUP;
+        return DB_OK;
+      }
+      if(aggregated == NULL) {
+        aggregated = attr;
+      }
+    }
+  }
+  if(aggregated != NULL) {
+    aggregated->flags |= ATTRIBUTE_FLAG_GROUP;
+    return DB_OK;
+  }
+
+  /* The attribute is not projected, so add it for processing only. */
+  i = AQL_ATTRIBUTE_COUNT(adt);
+  if(DB_ERROR(aql_add_attribute(adt, name, DOMAIN_UNSPECIFIED, 0, 0))) {
+    return DB_LIMIT_ERROR;
+  }
+  adt->attributes[i].flags = ATTRIBUTE_FLAG_NO_STORE | ATTRIBUTE_FLAG_GROUP;
+
+  return DB_OK;
+}
+#endif /* DB_FEATURE_GROUP */
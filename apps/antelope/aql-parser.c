@@ -479,6 +479,26 @@ PARSER(join)
   RETURN(OK);
 }
 
+#if DB_FEATURE_GROUP
+PARSER(group)
+{
+  CONSUME(BY);
+  CONSUME(IDENTIFIER);
+
+  PRINTF("Group by attribute %s\n", VALUE);
+  if(DB_ERROR(AQL_SET_GROUP(adt, VALUE))) {
+    RETURN(SYNTAX_ERROR);
+  }
+
+  /* Grouped selections are always aggregated, so that a GROUP BY
+     without aggregators yields the distinct values of the attribute. */
+  AQL_SET_FLAG(adt, AQL_FLAG_AGGREGATE);
+  AQL_SET_FLAG(adt, AQL_FLAG_GROUP);
+
+  RETURN(OK);
+}
+#endif /* DB_FEATURE_GROUP */
+
 PARSER(select)
 {
   AQL_SET_TYPE(adt, AQL_TYPE_SELECT);
@@ -502,11 +522,24 @@ PARSER(select)
     }
 
     AQL_SET_CONDITION(adt, &p);
-  } else {
+    NEXT;
+  } else if(TOKEN != GROUP) {
     REWIND;
     RETURN(OK);
   }
 
+  if(TOKEN == GROUP) {
+#if DB_FEATURE_GROUP
+    if(!PARSE(group)) {
+      RETURN(SYNTAX_ERROR);
+    }
+#else
+    RETURN(SYNTAX_ERROR);
+#endif /* DB_FEATURE_GROUP */
+  } else {
+    REWIND;
+  }
+
   CONSUME(END);
 
   return OK;
@@ -104,6 +104,8 @@ enum token {
   MEMHASH = 46,
   RELATION = 47,
   ATTRIBUTE = 48,
+  GROUP = 49,
+  BY = 50,
 
   INTEGER_VALUE = 251,
   FLOAT_VALUE = 252,
@@ -179,6 +181,7 @@ typedef struct aql_adt aql_adt_t;
 #define AQL_FLAG_AGGREGATE		1
 #define AQL_FLAG_ASSIGN			2
 #define AQL_FLAG_INVERSE_LOGIC		4
+#define AQL_FLAG_GROUP			8
 
 #define AQL_CLEAR(adt)			aql_clear(adt)
 #define AQL_SET_TYPE(adt, type)	(((adt))->optype = (type))
@@ -200,6 +203,8 @@ typedef struct aql_adt aql_adt_t;
     (adt)->aggregators[(adt)->attribute_count] = (function);		\
     aql_add_attribute((adt), (attr), DOMAIN_UNSPECIFIED, 0, 0);	\
   } while(0)  
+#define AQL_SET_GROUP(adt, attr)					\
+    aql_set_group_attribute((adt), (attr))
 #define AQL_ATTRIBUTE_COUNT(adt)	((adt)->attribute_count)
 #define AQL_SET_CONDITION(adt, cond)	((adt)->lvm_instance = (cond))
 #define AQL_ADD_VALUE(adt, domain, value)				\
@@ -215,6 +220,7 @@ db_result_t aql_add_attribute(aql_adt_t *adt, char *name,
                                domain_t domain, unsigned element_size,
                                int processed_only);
 db_result_t aql_add_value(aql_adt_t *adt, domain_t domain, void *value);
+db_result_t aql_set_group_attribute(aql_adt_t *adt, char *name);
 db_result_t db_query(db_handle_t *handle, const char *format, ...);
 db_result_t db_process(db_handle_t *handle);
 
@@ -54,6 +54,11 @@
 #define DB_FEATURE_REMOVE		1
 #endif /* DB_FEATURE_REMOVE */
 
+/* Support grouped aggregation (GROUP BY) in selections. */
+#ifndef DB_FEATURE_GROUP
+#define DB_FEATURE_GROUP		0
+#endif /* DB_FEATURE_GROUP */
+
 /* Support floating-point values in attributes. */
 #ifndef DB_FEATURE_FLOATS
 #define DB_FEATURE_FLOATS		0
@@ -98,6 +103,12 @@
 #define DB_MAX_ATTRIBUTES_PER_RELATION	6
 #endif /* DB_MAX_ATTRIBUTES_PER_RELATION */
 
+/* The maximum number of distinct groups in a GROUP BY selection. The
+   aggregation state of each group is kept in a hash table in RAM. */
+#ifndef DB_GROUP_TABLE_SIZE
+#define DB_GROUP_TABLE_SIZE		8
+#endif /* DB_GROUP_TABLE_SIZE */
+
 /* The maximum physical storage size on an attribute value. */
 #ifndef DB_MAX_ELEMENT_SIZE
 #define DB_MAX_ELEMENT_SIZE		16
@@ -81,6 +81,25 @@ struct source_map {
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
 #endif /* DB_FEATURE_JOIN */
 
+#if DB_FEATURE_GROUP
+/*
+ * The group structure holds the aggregation state for one distinct
+ * value of the attribute in a GROUP BY clause. The groups are kept in
+ * a fixed-size hash table with linear probing, which lets a grouped
+ * selection be aggregated in a single pass over the relation without
+ * storing intermediate results.
+ */
+struct group {
+  long values[AQL_ATTRIBUTE_LIMIT];
+  unsigned char key[DB_MAX_ELEMENT_SIZE];
+  uint8_t used;
+};
+
+static struct group groups[DB_GROUP_TABLE_SIZE];
+static struct source_dest_map *group_map;
+static unsigned group_cursor;
+#endif /* DB_FEATURE_GROUP */
+
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char extra_row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
 static unsigned char result_row[AQL_ATTRIBUTE_LIMIT * DB_MAX_ELEMENT_SIZE];
@@ -548,7 +567,8 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 }
 
 static void
-aggregate(attribute_t *attr, attribute_value_t *value)
+aggregate(uint8_t aggregator, long *aggregation_value,
+          attribute_value_t *value)
 {
   long long_value;
 
@@ -563,25 +583,25 @@ aggregate(attribute_t *attr, attribute_value_t *value)
     return;
   }
 
-  switch(attr->aggregator) {
+  switch(aggregator) {
   case AQL_COUNT:
-    attr->aggregation_value++;
+    (*aggregation_value)++;
     break;
   case AQL_SUM:
-    attr->aggregation_value += long_value;
+    *aggregation_value += long_value;
     break;
   case AQL_MEAN:
     break;
   case AQL_MEDIAN:
     break;
   case AQL_MAX:
-    if(long_value > attr->aggregation_value) {
-      attr->aggregation_value = long_value;
+    if(long_value > *aggregation_value) {
+      *aggregation_value = long_value;
     }
     break;
   case AQL_MIN:
-    if(long_value < attr->aggregation_value) {
-      attr->aggregation_value = long_value;
+    if(long_value < *aggregation_value) {
+      *aggregation_value = long_value;
     }
     break;
   default:
@@ -589,6 +609,126 @@ aggregate(attribute_t *attr, attribute_value_t *value)
   }
 }
 
+#if DB_FEATURE_GROUP
+static void
+group_init(unsigned attribute_count)
+{
+  struct source_dest_map *attr_map_ptr;
+
+  memset(groups, 0, sizeof(groups));
+  group_cursor = 0;
+  group_map = NULL;
+
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + attribute_count;
+      attr_map_ptr++) {
+    if(attr_map_ptr->to_attr->flags & ATTRIBUTE_FLAG_GROUP) {
+      group_map = attr_map_ptr;
+      break;
+    }
+  }
+}
+
+static struct group *
+group_find(unsigned char *from_ptr, unsigned attribute_count)
+{
+  unsigned char key[DB_MAX_ELEMENT_SIZE];
+  attribute_t *attr;
+  struct group *group;
+  unsigned i;
+  unsigned j;
+  unsigned probes;
+
+  attr = group_map->to_attr;
+
+  /* Normalize the key, so that string values compare equal regardless
+     of what follows the terminating null character. */
+  memset(key, 0, sizeof(key));
+  if(attr->domain == DOMAIN_STRING) {
+    for(i = 0; i < attr->element_size - 1 && from_ptr[i] != '\0'; i++) {
+      key[i] = from_ptr[i];
+    }
+  } else {
+    memcpy(key, from_ptr, attr->element_size);
+  }
+
+  i = crc16_data(key, attr->element_size, 0) % DB_GROUP_TABLE_SIZE;
+  for(probes = 0; probes < DB_GROUP_TABLE_SIZE; probes++) {
+    group = &groups[i];
+    if(!group->used) {
+      /* Start a new group with the initial aggregation values. */
+      group->used = 1;
+      memcpy(group->key, key, sizeof(group->key));
+      for(j = 0; j < attribute_count; j++) {
+        group->values[j] = attr_map[j].to_attr->aggregation_value;
+      }
+      return group;
+    }
+
+    if(memcmp(group->key, key, attr->element_size) == 0) {
+      return group;
+    }
+
+    if(++i == DB_GROUP_TABLE_SIZE) {
+      i = 0;
+    }
+  }
+
+  PRINTF("DB: The group table is full (%u groups)\n",
+         (unsigned)DB_GROUP_TABLE_SIZE);
+  return NULL;
+}
+
+static db_result_t
+group_next(db_handle_t *handle, aql_adt_t *adt, unsigned attribute_count)
+{
+  struct group *group;
+  struct source_dest_map *attr_map_ptr;
+  attribute_t *result_attr;
+  attribute_value_t value;
+  unsigned char *to_ptr;
+
+  /* Emit one tuple for each group that has been aggregated. */
+  while(group_cursor < DB_GROUP_TABLE_SIZE) {
+    group = &groups[group_cursor++];
+    if(!group->used) {
+      continue;
+    }
+
+    for(attr_map_ptr = attr_map;
+        attr_map_ptr < attr_map + attribute_count;
+        attr_map_ptr++) {
+      result_attr = attr_map_ptr->to_attr;
+      to_ptr = result_row + attr_map_ptr->to_offset;
+
+      if(result_attr->aggregator != AQL_NONE) {
+        /* The attribute to group on may itself be aggregated. */
+        value.domain = DOMAIN_INT;
+        VALUE_INT(&value) = group->values[attr_map_ptr - attr_map];
+        db_value_to_phy(to_ptr, result_attr, &value);
+      } else if(attr_map_ptr == group_map) {
+        memcpy(to_ptr, group->key, result_attr->element_size);
+      }
+    }
+
+    if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
+      if(DB_ERROR(storage_put_row(handle->result_rel, result_row))) {
+        PRINTF("DB: Failed to store a row in the result relation!\n");
+        return DB_STORAGE_ERROR;
+      }
+    }
+
+    handle->current_row++;
+    return DB_GOT_ROW;
+  }
+
+  handle->flags &= ~DB_HANDLE_FLAG_GROUP_OUTPUT;
+  AQL_GET_FLAGS(adt) &= ~(AQL_FLAG_AGGREGATE | AQL_FLAG_GROUP);
+
+  return DB_FINISHED;
+}
+#endif /* DB_FEATURE_GROUP */
+
 static db_result_t
 generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_count,
                        relation_t *from_rel, relation_t *to_rel, 
@@ -746,6 +886,7 @@ relation_process_select(void *handle_ptr)
   uint8_t intbuf[2];
   attribute_value_t value;
   lvm_status_t wanted_result;
+  long *aggregation_values;
 
   handle = (db_handle_t *)handle_ptr;
   adt = (aql_adt_t *)handle->adt;
@@ -753,6 +894,12 @@ relation_process_select(void *handle_ptr)
   attribute_count = handle->result_rel->attribute_count;
   attr_map_end = attr_map + attribute_count;
 
+#if DB_FEATURE_GROUP
+  if(handle->flags & DB_HANDLE_FLAG_GROUP_OUTPUT) {
+    return group_next(handle, adt, attribute_count);
+  }
+#endif /* DB_FEATURE_GROUP */
+
   if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
     handle->tuple_id = index_get_next(&handle->index_iterator);
     if(handle->tuple_id == INVALID_TUPLE) {
@@ -822,13 +969,30 @@ relation_process_select(void *handle_ptr)
   if(adt->lvm_instance == NULL ||
      lvm_execute(adt->lvm_instance) == wanted_result) {
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
+      aggregation_values = NULL;
+#if DB_FEATURE_GROUP
+      if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+        struct group *group;
+
+        group = group_find(row + group_map->from_offset, attribute_count);
+        if(group == NULL) {
+          return DB_LIMIT_ERROR;
+        }
+        aggregation_values = group->values;
+      }
+#endif /* DB_FEATURE_GROUP */
+
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
         from_ptr = row + attr_map_ptr->from_offset;
         result = db_phy_to_value(&value, attr_map_ptr->to_attr, from_ptr);
         if(DB_ERROR(result)) {
 	  return result;
         }
-        aggregate(attr_map_ptr->to_attr, &value);
+        aggregate(attr_map_ptr->to_attr->aggregator,
+                  aggregation_values != NULL ?
+                    &aggregation_values[attr_map_ptr - attr_map] :
+                    &attr_map_ptr->to_attr->aggregation_value,
+                  &value);
       }
     } else {
       if(AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
@@ -845,6 +1009,14 @@ relation_process_select(void *handle_ptr)
   return DB_OK;
 
 end_aggregation:
+#if DB_FEATURE_GROUP
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP) {
+    /* All tuples have been aggregated; return the groups one by one. */
+    handle->flags |= DB_HANDLE_FLAG_GROUP_OUTPUT;
+    return group_next(handle, adt, attribute_count);
+  }
+#endif /* DB_FEATURE_GROUP */
+
   /* Generate aggregated result if requested. */
   for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
     result_attr = attr_map_ptr->to_attr;
@@ -880,6 +1052,7 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
   attribute_t *attr;
   int i;
   int normal_attributes;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -929,8 +1102,10 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
     attr->aggregator = adt->aggregators[i];
     switch(attr->aggregator) {
     case AQL_NONE:
-      if(!(adt->attributes[i].flags & ATTRIBUTE_FLAG_NO_STORE)) {
-        /* Only count attributes projected into the result set. */
+      if(!(adt->attributes[i].flags &
+           (ATTRIBUTE_FLAG_NO_STORE | ATTRIBUTE_FLAG_GROUP))) {
+        /* Only count attributes projected into the result set.
+           The attribute to group on is not aggregated. */
         normal_attributes++;
       }
       break;
@@ -949,13 +1124,21 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
   }
 
   /* Preclude mixes of normal attributes and aggregated ones in 
-     selection results. */
-  if(normal_attributes > 0 &&
-     handle->result_rel->attribute_count > normal_attributes) {
+     selection results. Attributes that are used only for processing
+     the condition are not part of the result. */
+  if(normal_attributes > 0 && (AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE)) {
      return DB_RELATIONAL_ERROR;
   }
 
-  return generate_selection_result(handle, rel, adt);
+  result = generate_selection_result(handle, rel, adt);
+
+#if DB_FEATURE_GROUP
+  if(!DB_ERROR(result) && (AQL_GET_FLAGS(adt) & AQL_FLAG_GROUP)) {
+    group_init(handle->result_rel->attribute_count);
+  }
+#endif /* DB_FEATURE_GROUP */
+
+  return result;
 }
 
 #if DB_FEATURE_JOIN
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2015, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP congestion control (CoCoA) for the transaction layer.
+ *
+ *      RTT samples from exchanges without retransmissions feed the
+ *      strong estimator (RTO = SRTT + 4 RTTVAR), samples after one or
+ *      two retransmissions feed the weak estimator (RTO = SRTT +
+ *      RTTVAR), measured from the first transmission. Both are blended
+ *      into the overall RTO of the destination. Estimates that have not
+ *      been updated for a while age towards the default timeout.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "er-coap-transactions.h"
+#include "er-coap-cocoa.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_CONGESTION_CONTROL
+
+#define RTO_DEFAULT       COAP_RESPONSE_TIMEOUT_TICKS
+#define RTO_MAX           (60 * CLOCK_SECOND)
+
+#define ESTIMATOR_STRONG  0x01
+#define ESTIMATOR_WEAK    0x02
+
+struct rtt_estimator {
+  struct rtt_estimator *next;
+  uip_ipaddr_t addr;
+  clock_time_t srtt_strong;
+  clock_time_t rttvar_strong;
+  clock_time_t srtt_weak;
+  clock_time_t rttvar_weak;
+  clock_time_t rto;
+  clock_time_t last_update;
+  uint8_t flags;
+};
+
+MEMB(estimators_memb, struct rtt_estimator, COAP_MAX_RTT_ESTIMATORS);
+/* most recently used first */
+LIST(estimators_list);
+
+/*---------------------------------------------------------------------------*/
+static struct rtt_estimator *
+estimator_lookup(uip_ipaddr_t *addr, int create)
+{
+  struct rtt_estimator *e;
+
+  for(e = list_head(estimators_list); e != NULL; e = e->next) {
+    if(uip_ipaddr_cmp(&e->addr, addr)) {
+      list_remove(estimators_list, e);
+      list_push(estimators_list, e);
+      return e;
+    }
+  }
+
+  if(!create) {
+    return NULL;
+  }
+
+  e = memb_alloc(&estimators_memb);
+  if(e == NULL) {
+    /* replace the least recently used destination */
+    e = list_chop(estimators_list);
+  }
+  if(e != NULL) {
+    uip_ipaddr_copy(&e->addr, addr);
+    e->rto = RTO_DEFAULT;
+    e->last_update = clock_time();
+    e->flags = 0;
+    list_push(estimators_list, e);
+  }
+  return e;
+}
+/*---------------------------------------------------------------------------*/
+static void
+estimator_age(struct rtt_estimator *e)
+{
+  clock_time_t idle = clock_time() - e->last_update;
+
+  if(e->rto < CLOCK_SECOND && idle > (uint32_t)e->rto * 16) {
+    e->rto <<= 1;
+    e->last_update = clock_time();
+  } else if(e->rto > 3 * CLOCK_SECOND && idle > (uint32_t)e->rto * 4) {
+    e->rto = (RTO_DEFAULT + e->rto) / 2;
+    e->last_update = clock_time();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* RFC 6298 smoothing, returns SRTT + k * RTTVAR */
+static clock_time_t
+estimate(clock_time_t *srtt, clock_time_t *rttvar, int valid,
+         clock_time_t rtt, uint8_t k)
+{
+  uint32_t rto;
+
+  if(!valid) {
+    *srtt = rtt;
+    *rttvar = rtt / 2;
+  } else {
+    clock_time_t delta = *srtt > rtt ? *srtt - rtt : rtt - *srtt;
+
+    *rttvar = ((uint32_t)*rttvar * 3 + delta) / 4;
+    *srtt = ((uint32_t)*srtt * 7 + rtt) / 8;
+  }
+
+  rto = *srtt + (uint32_t)*rttvar * k;
+  return rto > RTO_MAX ? RTO_MAX : rto;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+coap_cocoa_initial_timeout(uip_ipaddr_t *addr, uint8_t *backoff)
+{
+  struct rtt_estimator *e = estimator_lookup(addr, 0);
+  clock_time_t rto = RTO_DEFAULT;
+
+  if(e != NULL) {
+    estimator_age(e);
+    rto = e->rto;
+  }
+
+  /* variable backoff factor, in halves */
+  if(rto < CLOCK_SECOND) {
+    *backoff = 6;
+  } else if(rto > 3 * CLOCK_SECOND) {
+    *backoff = 3;
+  } else {
+    *backoff = 4;
+  }
+
+  /* dithering between RTO and 1.5 RTO */
+  return rto + random_rand() % (rto / 2 + 1);
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+coap_cocoa_backoff(clock_time_t interval, uint8_t backoff)
+{
+  uint32_t next = (uint32_t)interval * backoff / 2;
+
+  return next > RTO_MAX ? RTO_MAX : next;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_cocoa_update(uip_ipaddr_t *addr, clock_time_t rtt,
+                  uint8_t retransmissions)
+{
+  struct rtt_estimator *e;
+  clock_time_t rto;
+
+  if(retransmissions > 2 || (e = estimator_lookup(addr, 1)) == NULL) {
+    return;
+  }
+
+  if(retransmissions == 0) {
+    rto = estimate(&e->srtt_strong, &e->rttvar_strong,
+                   e->flags & ESTIMATOR_STRONG, rtt, 4);
+    e->flags |= ESTIMATOR_STRONG;
+    e->rto = ((uint32_t)e->rto + rto) / 2;
+  } else {
+    rto = estimate(&e->srtt_weak, &e->rttvar_weak,
+                   e->flags & ESTIMATOR_WEAK, rtt, 1);
+    e->flags |= ESTIMATOR_WEAK;
+    e->rto = ((uint32_t)e->rto * 3 + rto) / 4;
+  }
+  if(e->rto == 0) {
+    e->rto = 1;
+  }
+  e->last_update = clock_time();
+
+  PRINTF("CoCoA: RTT %lu (%u retransmissions), RTO %lu\n",
+         (unsigned long)rtt, retransmissions, (unsigned long)e->rto);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* COAP_CONGESTION_CONTROL */
@@ -48,11 +48,36 @@
 #define COAP_SERVER_PORT               COAP_DEFAULT_PORT
 #endif
 
-/* The number of concurrent messages that can be stored for retransmission in the transaction layer. */
+/* The number of concurrent messages that can be stored for retransmission in the transaction layer.
+   Each one holds a packet buffer, i.e., takes a little more than COAP_MAX_PACKET_SIZE bytes of RAM. */
 #ifndef COAP_MAX_OPEN_TRANSACTIONS
-#define COAP_MAX_OPEN_TRANSACTIONS     4
+#define COAP_MAX_OPEN_TRANSACTIONS     8
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/* Number of buckets for the MID lookup of open transactions (power of two). */
+#ifndef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE     8
+#endif /* COAP_TRANSACTION_HASH_SIZE */
+
+#if (COAP_TRANSACTION_HASH_SIZE) & ((COAP_TRANSACTION_HASH_SIZE) - 1)
+#error "COAP_TRANSACTION_HASH_SIZE must be a power of two"
+#endif
+
+/* Adaptive retransmission timeouts per destination (CoCoA) instead of the fixed COAP_RESPONSE_TIMEOUT. */
+#ifndef COAP_CONGESTION_CONTROL
+#define COAP_CONGESTION_CONTROL        0
+#endif /* COAP_CONGESTION_CONTROL */
+
+/* Number of destinations for which RTT estimates are kept (least recently used are replaced). */
+#ifndef COAP_MAX_RTT_ESTIMATORS
+#define COAP_MAX_RTT_ESTIMATORS        4
+#endif /* COAP_MAX_RTT_ESTIMATORS */
+
+/* Block2 requests a blocking request keeps in flight (NSTART); 1 is stop-and-wait. */
+#ifndef COAP_NSTART
+#define COAP_NSTART                    1
+#endif /* COAP_NSTART */
+
 /* Maximum number of failed request attempts before action */
 #ifndef COAP_MAX_ATTEMPTS
 #define COAP_MAX_ATTEMPTS              4
@@ -63,7 +88,7 @@
 #define COAP_MAX_HEADER_SIZE           (4 + COAP_TOKEN_LEN + 3 + 1 + COAP_ETAG_LEN + 4 + 4 + 30)  /* 65 */
 #endif /* COAP_MAX_HEADER_SIZE */
 
-/* Number of observer slots (each takes abot xxx bytes) */
+/* Number of observer slots (each takes sizeof(coap_observer_t), about 70 bytes) */
 #ifndef COAP_MAX_OBSERVERS
 #define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS - 1
 #endif /* COAP_MAX_OBSERVERS */
@@ -76,6 +76,7 @@ coap_receive(void)
   static coap_packet_t message[1]; /* this way the packet can be treated as pointer as usual */
   static coap_packet_t response[1];
   static coap_transaction_t *transaction = NULL;
+  size_t response_len = 0;
 
   if(uip_newdata()) {
 
@@ -208,10 +209,17 @@ coap_receive(void)
                 /* serialize response */
             }
             if(erbium_status_code == NO_ERROR) {
-              if((transaction->packet_len = coap_serialize_message(response,
-                                                                   transaction->
-                                                                   packet)) ==
-                 0) {
+              if(response->type != COAP_TYPE_CON) {
+                /* not retransmitted: serialize straight into uip_buf */
+                response_len = coap_serialize_message_uip(response,
+                                                          transaction->packet);
+                transaction->packet_len = response_len;
+              } else {
+                transaction->packet_len = coap_serialize_message(response,
+                                                                 transaction->
+                                                                 packet);
+              }
+              if(transaction->packet_len == 0) {
                 erbium_status_code = PACKET_SERIALIZATION_ERROR;
               }
             }
@@ -245,7 +253,7 @@ coap_receive(void)
           restful_response_handler callback = transaction->callback;
           void *callback_data = transaction->callback_data;
 
-          coap_clear_transaction(transaction);
+          coap_transaction_acked(transaction);
 
           /* check if someone registered for the response */
           if(callback) {
@@ -269,7 +277,12 @@ coap_receive(void)
 
     /* if(parsed correctly) */
     if(erbium_status_code == NO_ERROR) {
-      if(transaction) {
+      if(transaction && response_len) {
+        /* already in place, uip_udp_packet_send() does not need to copy */
+        coap_send_message(&transaction->addr, transaction->port,
+                          COAP_UIP_OUTPUT_BUF, response_len);
+        coap_clear_transaction(transaction);
+      } else if(transaction) {
         coap_send_transaction(transaction);
       }
     } else if(erbium_status_code == MANUAL_RESPONSE) {
@@ -291,6 +304,10 @@ coap_receive(void)
       }
       coap_init_message(message, reply_type, erbium_status_code,
                         message->mid);
+      if(erbium_status_code == SERVICE_UNAVAILABLE_5_03) {
+        /* back-pressure: tell the client when to retry */
+        coap_set_header_max_age(message, coap_transactions_retry_after());
+      }
       coap_set_payload(message, coap_error_message,
                        strlen(coap_error_message));
       coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
@@ -347,10 +364,8 @@ PROCESS_THREAD(coap_engine, ev, data)
 
     if(ev == tcpip_event) {
       coap_receive();
-    } else if(ev == PROCESS_EVENT_TIMER) {
-      /* retransmissions are handled here */
-      coap_check_transactions();
     }
+    /* retransmissions are driven by a callback timer in the transaction layer */
   } /* while (1) */
 
   PROCESS_END();
@@ -367,6 +382,139 @@ coap_blocking_request_callback(void *callback_data, void *response)
   process_poll(state->process);
 }
 /*---------------------------------------------------------------------------*/
+#if COAP_NSTART > 1
+static int
+send_block_request(struct request_state_t *state, uip_ipaddr_t *remote_ipaddr,
+                   uint16_t remote_port, coap_packet_t *request,
+                   uint32_t block_num, uint16_t block_size)
+{
+  coap_transaction_t *t;
+
+  request->mid = coap_get_mid();
+  if((t = coap_new_transaction(request->mid, remote_ipaddr,
+                               remote_port)) == NULL) {
+    return 0;
+  }
+  t->callback = coap_blocking_request_callback;
+  t->callback_data = state;
+
+  if(block_num > 0) {
+    coap_set_header_block2(request, block_num, 0, block_size);
+  }
+  t->packet_len = coap_serialize_message(request, t->packet);
+  if(t->packet_len == 0) {
+    PRINTF("Could not serialize request #%lu\n", block_num);
+    coap_clear_transaction(t);
+    return 0;
+  }
+  state->mids[state->in_flight++] = request->mid;
+  state->transaction = t;
+
+  coap_send_transaction(t);
+  PRINTF("Requested #%lu (MID %u)\n", block_num, request->mid);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+release_block_request(struct request_state_t *state, uint16_t mid)
+{
+  uint8_t i;
+
+  for(i = 0; i < state->in_flight; ++i) {
+    if(state->mids[i] == mid) {
+      state->mids[i] = state->mids[--state->in_flight];
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Windowed variant: after the first block, up to COAP_NSTART Block2
+ * requests are kept in flight. Blocks are passed to the handler in the
+ * order they arrive; it must place them by their Block2 number.
+ */
+PT_THREAD(coap_blocking_request
+            (struct request_state_t *state, process_event_t ev,
+            uip_ipaddr_t *remote_ipaddr, uint16_t remote_port,
+            coap_packet_t *request,
+            blocking_response_handler request_callback))
+{
+  PT_BEGIN(&state->pt);
+
+  static uint8_t more;
+  static uint8_t last_known;
+  static uint32_t res_block;
+  static uint32_t next_block;
+  static uint16_t block_size;
+
+  state->block_num = 0;
+  state->response = NULL;
+  state->process = PROCESS_CURRENT();
+  state->in_flight = 0;
+
+  last_known = 0;
+  next_block = 1;
+  block_size = REST_MAX_CHUNK_SIZE;
+
+  if(!send_block_request(state, remote_ipaddr, remote_port, request, 0,
+                         block_size)) {
+    PRINTF("Could not send request\n");
+    PT_EXIT(&state->pt);
+  }
+  state->first_mid = request->mid;
+
+  do {
+    PT_YIELD_UNTIL(&state->pt, ev == PROCESS_EVENT_POLL);
+
+    if(!state->response) {
+      PRINTF("Server not responding\n");
+      /* cancel the remaining requests of the window */
+      while(state->in_flight > 0) {
+        coap_clear_transaction(coap_get_transaction_by_mid(
+                                 state->mids[--state->in_flight]));
+      }
+      PT_EXIT(&state->pt);
+    }
+
+    if(!release_block_request(state, state->response->mid)) {
+      continue;
+    }
+
+    more = 0;
+    res_block = 0;
+    if(coap_get_header_block2(state->response, &res_block, &more,
+                              &block_size, NULL) && block_size == 0) {
+      block_size = REST_MAX_CHUNK_SIZE;
+    }
+
+    PRINTF("Received #%lu%s (%u bytes)\n", res_block, more ? "+" : "",
+           state->response->payload_len);
+
+    /* Blocks requested past the end are answered with errors, which
+       carry no Block2 option. Only an error for the first request is
+       passed on. */
+    if(state->response->code < BAD_REQUEST_4_00 ||
+       state->response->mid == state->first_mid) {
+      if(!more) {
+        last_known = 1;
+      }
+      state->block_num = res_block;
+      request_callback(state->response);
+    }
+
+    while(!last_known && state->in_flight < COAP_NSTART) {
+      if(!send_block_request(state, remote_ipaddr, remote_port, request,
+                             next_block, block_size)) {
+        break;
+      }
+      ++next_block;
+    }
+  } while(state->in_flight > 0);
+
+  PT_END(&state->pt);
+}
+#else /* COAP_NSTART > 1 */
 PT_THREAD(coap_blocking_request
             (struct request_state_t *state, process_event_t ev,
             uip_ipaddr_t *remote_ipaddr, uint16_t remote_port,
@@ -433,6 +581,7 @@ PT_THREAD(coap_blocking_request
 
   PT_END(&state->pt);
 }
+#endif /* COAP_NSTART > 1 */
 /*---------------------------------------------------------------------------*/
 /*- REST Engine Interface ---------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
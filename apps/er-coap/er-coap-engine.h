@@ -62,6 +62,11 @@ struct request_state_t {
   coap_transaction_t *transaction;
   coap_packet_t *response;
   uint32_t block_num;
+#if COAP_NSTART > 1
+  uint16_t mids[COAP_NSTART];   /* Block2 requests in flight */
+  uint16_t first_mid;           /* MID of the request for block 0 */
+  uint8_t in_flight;
+#endif
 };
 
 typedef void (*blocking_response_handler)(void *response);
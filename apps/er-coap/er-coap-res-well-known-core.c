@@ -84,6 +84,7 @@ well_known_core_get_handler(void *request, void *response, uint8_t *buffer,
   size_t bufpos = 0;            /* position within buffer (bytes written) */
   size_t tmplen = 0;
   resource_t *resource = NULL;
+  rest_resource_iterator_t iterator;
 
 #if COAP_LINK_FORMAT_FILTERING
   /* For filtering. */
@@ -113,8 +114,8 @@ well_known_core_get_handler(void *request, void *response, uint8_t *buffer,
   }
 #endif
 
-  for(resource = (resource_t *)list_head(rest_get_resources()); resource;
-      resource = resource->next) {
+  for(resource = rest_get_first_resource(&iterator); resource;
+      resource = rest_get_next_resource(&iterator)) {
 #if COAP_LINK_FORMAT_FILTERING
     /* Filtering */
     if(len) {
@@ -40,6 +40,7 @@
 #include "contiki-net.h"
 #include "er-coap-transactions.h"
 #include "er-coap-observe.h"
+#include "er-coap-cocoa.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -54,14 +55,68 @@
 #endif
 
 /*---------------------------------------------------------------------------*/
+#define TRANSACTION_HASH(mid)  ((mid) & (COAP_TRANSACTION_HASH_SIZE - 1))
+
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
+/* confirmable transactions awaiting an ACK, earliest retransmission first */
 LIST(transactions_list);
+/* all open transactions, chained through hash_next */
+static coap_transaction_t *transactions_hash[COAP_TRANSACTION_HASH_SIZE];
 
 static struct process *transaction_handler_process = NULL;
+static struct ctimer retrans_ctimer;
 
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+static void
+retrans_ctimer_callback(void *ptr)
+{
+  coap_check_transactions();
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_retransmission(void)
+{
+  coap_transaction_t *t = list_head(transactions_list);
+
+  if(t == NULL) {
+    ctimer_stop(&retrans_ctimer);
+    return;
+  }
+
+  /* the callback runs in the context of the engine, like the former etimers */
+  PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+  ctimer_set(&retrans_ctimer,
+             timer_expired(&t->retrans_timer) ? 0 :
+             timer_remaining(&t->retrans_timer),
+             retrans_ctimer_callback, NULL);
+  PROCESS_CONTEXT_END(transaction_handler_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+enqueue_retransmission(coap_transaction_t *t)
+{
+  coap_transaction_t *prev = NULL;
+  coap_transaction_t *n;
+  clock_time_t remaining = timer_remaining(&t->retrans_timer);
+
+  list_remove(transactions_list, t);
+
+  for(n = list_head(transactions_list); n != NULL; n = n->next) {
+    if(!timer_expired(&n->retrans_timer)
+       && timer_remaining(&n->retrans_timer) > remaining) {
+      break;
+    }
+    prev = n;
+  }
+  list_insert(transactions_list, prev, t);
+
+  if(prev == NULL) {
+    schedule_retransmission();
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 coap_register_as_transaction_handler()
 {
@@ -75,12 +130,15 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   if(t) {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->retrans_timer.interval = 0;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
     t->port = port;
 
-    list_add(transactions_list, t); /* list itself makes sure same element is not added twice */
+    t->next = NULL;
+    t->hash_next = transactions_hash[TRANSACTION_HASH(mid)];
+    transactions_hash[TRANSACTION_HASH(mid)] = t;
   }
 
   return t;
@@ -100,22 +158,32 @@ coap_send_transaction(coap_transaction_t *t)
       PRINTF("Keeping transaction %u\n", t->mid);
 
       if(t->retrans_counter == 0) {
-        t->retrans_timer.timer.interval =
+#if COAP_CONGESTION_CONTROL
+        t->retrans_timer.interval =
+          coap_cocoa_initial_timeout(&t->addr, &t->retrans_backoff);
+        t->first_sent = clock_time();
+#else
+        t->retrans_timer.interval =
           COAP_RESPONSE_TIMEOUT_TICKS + (random_rand()
                                          %
                                          (clock_time_t)
                                          COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+#endif
         PRINTF("Initial interval %f\n",
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_timer.interval / CLOCK_SECOND);
       } else {
-        t->retrans_timer.timer.interval <<= 1;  /* double */
-        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter,
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+#if COAP_CONGESTION_CONTROL
+        t->retrans_timer.interval =
+          coap_cocoa_backoff(t->retrans_timer.interval, t->retrans_backoff);
+#else
+        t->retrans_timer.interval <<= 1;  /* double */
+#endif
+        PRINTF("Backed off (%u) interval %f\n", t->retrans_counter,
+               (float)t->retrans_timer.interval / CLOCK_SECOND);
       }
 
-      PROCESS_CONTEXT_BEGIN(transaction_handler_process);
-      etimer_restart(&t->retrans_timer);        /* interval updated above */
-      PROCESS_CONTEXT_END(transaction_handler_process);
+      timer_restart(&t->retrans_timer);        /* interval updated above */
+      enqueue_retransmission(t);
 
       t = NULL;
     } else {
@@ -141,11 +209,25 @@ coap_send_transaction(coap_transaction_t *t)
 void
 coap_clear_transaction(coap_transaction_t *t)
 {
+  coap_transaction_t **p;
+
   if(t) {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
-    list_remove(transactions_list, t);
+    for(p = &transactions_hash[TRANSACTION_HASH(t->mid)]; *p != NULL;
+        p = &(*p)->hash_next) {
+      if(*p == t) {
+        *p = t->hash_next;
+        break;
+      }
+    }
+
+    if(list_head(transactions_list) == t) {
+      list_remove(transactions_list, t);
+      schedule_retransmission();
+    } else {
+      list_remove(transactions_list, t);
+    }
     memb_free(&transactions_memb, t);
   }
 }
@@ -154,7 +236,7 @@ coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
+  for(t = transactions_hash[TRANSACTION_HASH(mid)]; t; t = t->hash_next) {
     if(t->mid == mid) {
       PRINTF("Found transaction for MID %u: %p\n", t->mid, t);
       return t;
@@ -164,16 +246,47 @@ coap_get_transaction_by_mid(uint16_t mid)
 }
 /*---------------------------------------------------------------------------*/
 void
+coap_transaction_acked(coap_transaction_t *t)
+{
+#if COAP_CONGESTION_CONTROL
+  if(t->retrans_timer.interval != 0) {
+    coap_cocoa_update(&t->addr, clock_time() - t->first_sent,
+                      t->retrans_counter);
+  }
+#endif
+  coap_clear_transaction(t);
+}
+/*---------------------------------------------------------------------------*/
+void
 coap_check_transactions()
 {
   coap_transaction_t *t = NULL;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
-    if(etimer_expired(&t->retrans_timer)) {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
-    }
+  /* only the head of the queue needs checking; sending re-queues or frees it */
+  while((t = list_head(transactions_list)) != NULL
+        && timer_expired(&t->retrans_timer)) {
+    ++(t->retrans_counter);
+    PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+    coap_send_transaction(t);
+  }
+  schedule_retransmission();
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+coap_transactions_retry_after()
+{
+  coap_transaction_t *t = list_head(transactions_list);
+  uint32_t seconds;
+
+  if(t == NULL) {
+    return COAP_RESPONSE_TIMEOUT;
+  }
+  if(timer_expired(&t->retrans_timer)) {
+    return 1;
   }
+  /* a slot may be freed at the earliest when the next deadline passes */
+  seconds = (timer_remaining(&t->retrans_timer) + CLOCK_SECOND - 1)
+    / CLOCK_SECOND;
+  return seconds > 0 ? seconds : 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -50,11 +50,16 @@
 
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
-  struct coap_transaction *next;        /* for LIST */
+  struct coap_transaction *next;        /* for LIST, ordered by retransmission deadline */
+  struct coap_transaction *hash_next;   /* for the MID lookup */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  struct timer retrans_timer;
   uint8_t retrans_counter;
+#if COAP_CONGESTION_CONTROL
+  uint8_t retrans_backoff;      /* backoff factor in halves */
+  clock_time_t first_sent;      /* for RTT measurement */
+#endif
 
   uip_ipaddr_t addr;
   uint16_t port;
@@ -74,7 +79,9 @@ coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr,
 void coap_send_transaction(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
+void coap_transaction_acked(coap_transaction_t *t);
 
 void coap_check_transactions();
+uint32_t coap_transactions_retry_after();
 
 #endif /* COAP_TRANSACTIONS_H_ */
@@ -307,10 +307,10 @@ coap_init_message(void *packet, coap_message_type_t type, uint8_t code,
   coap_pkt->mid = mid;
 }
 /*---------------------------------------------------------------------------*/
-size_t
-coap_serialize_message(void *packet, uint8_t *buffer)
+/* Serializes header, token, and options; returns the end of the options */
+static uint8_t *
+coap_serialize_header(coap_packet_t *coap_pkt, uint8_t *buffer)
 {
-  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
   uint8_t *option;
   unsigned int current_number = 0;
 
@@ -335,7 +335,7 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   /* empty packet, dont need to do more stuff */
   if(!coap_pkt->code) {
     PRINTF("-Done serializing empty message at %p-\n", coap_pkt->buffer);
-    return 4;
+    return coap_pkt->buffer + COAP_HEADER_LEN;
   }
 
   /* set Token */
@@ -390,20 +390,36 @@ coap_serialize_message(void *packet, uint8_t *buffer)
 
   PRINTF("-Done serializing at %p----\n", option);
 
-  /* Pack payload */
-  if((option - coap_pkt->buffer) <= COAP_MAX_HEADER_SIZE) {
-    /* Payload marker */
-    if(coap_pkt->payload_len) {
-      *option = 0xFF;
-      ++option;
-    }
-    memmove(option, coap_pkt->payload, coap_pkt->payload_len);
-  } else {
-    /* an error occurred: caller must check for !=0 */
+  if((option - coap_pkt->buffer) > COAP_MAX_HEADER_SIZE) {
+    /* an error occurred: caller must check for !=NULL */
     coap_pkt->buffer = NULL;
     coap_error_message = "Serialized header exceeds COAP_MAX_HEADER_SIZE";
+    return NULL;
+  }
+
+  /* Payload marker */
+  if(coap_pkt->code && coap_pkt->payload_len) {
+    *option = 0xFF;
+    ++option;
+  }
+  return option;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+coap_serialize_message(void *packet, uint8_t *buffer)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+  uint8_t *option;
+
+  if((option = coap_serialize_header(coap_pkt, buffer)) == NULL) {
     return 0;
   }
+  if(!coap_pkt->code) {
+    return COAP_HEADER_LEN;
+  }
+
+  /* Pack payload */
+  memmove(option, coap_pkt->payload, coap_pkt->payload_len);
 
   PRINTF("-Done %u B (header len %u, payload len %u)-\n",
          (unsigned int)(coap_pkt->payload_len + option - buffer),
@@ -422,6 +438,41 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   return (option - buffer) + coap_pkt->payload_len; /* packet length */
 }
 /*---------------------------------------------------------------------------*/
+size_t
+coap_serialize_message_uip(void *packet, uint8_t *scratch)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
+  uint8_t *option;
+  size_t header_len;
+
+  /* options may still point into the request, so build them aside first */
+  if((option = coap_serialize_header(coap_pkt, scratch)) == NULL) {
+    return 0;
+  }
+  header_len = option - scratch;
+  if(!coap_pkt->code) {
+    coap_pkt->payload_len = 0;
+  }
+
+  if(header_len + coap_pkt->payload_len > COAP_UIP_OUTPUT_LEN) {
+    coap_pkt->buffer = NULL;
+    coap_error_message = "Serialized message exceeds uIP buffer";
+    return 0;
+  }
+
+  /* the payload is moved once, then the small header is put in front of it */
+  memmove(COAP_UIP_OUTPUT_BUF + header_len, coap_pkt->payload,
+          coap_pkt->payload_len);
+  memcpy(COAP_UIP_OUTPUT_BUF, scratch, header_len);
+  coap_pkt->buffer = COAP_UIP_OUTPUT_BUF;
+
+  PRINTF("-Done %u B in uIP buffer (header len %u)-\n",
+         (unsigned int)(header_len + coap_pkt->payload_len),
+         (unsigned int)header_len);
+
+  return header_len + coap_pkt->payload_len;
+}
+/*---------------------------------------------------------------------------*/
 void
 coap_send_message(uip_ipaddr_t *addr, uint16_t port, uint8_t *data,
                   uint16_t length)
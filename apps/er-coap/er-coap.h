@@ -73,6 +73,10 @@
 #define UIP_UDP_BUF  ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
 #endif
 
+/* outgoing application data is placed here by uip_udp_packet_send() */
+#define COAP_UIP_OUTPUT_BUF  ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+#define COAP_UIP_OUTPUT_LEN  (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
+
 /* bitmap for set options */
 enum { OPTION_MAP_SIZE = sizeof(uint8_t) * 8 };
 
@@ -182,6 +186,7 @@ uint16_t coap_get_mid(void);
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code,
                        uint16_t mid);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
+size_t coap_serialize_message_uip(void *packet, uint8_t *scratch);
 void coap_send_message(uip_ipaddr_t *addr, uint16_t port, uint8_t *data,
                        uint16_t length);
 coap_status_t coap_parse_message(void *request, uint8_t *data,
@@ -59,6 +59,178 @@ PROCESS(rest_engine_process, "REST Engine");
 LIST(restful_services);
 LIST(restful_periodic_services);
 /*---------------------------------------------------------------------------*/
+#if REST_RESOURCE_TREE
+static struct rest_path_node path_root;
+/*---------------------------------------------------------------------------*/
+static struct rest_path_node *
+path_node_init(struct rest_path_node *node, const char *label, int label_len,
+               resource_t *resource)
+{
+  memset(node, 0, sizeof(*node));
+  node->label = label;
+  node->label_len = label_len;
+  node->resource = resource;
+  return node;
+}
+/*---------------------------------------------------------------------------*/
+static void
+path_node_add(struct rest_path_node *parent, struct rest_path_node *node)
+{
+  struct rest_path_node **next;
+
+  /* keep siblings in the order of activation */
+  for(next = &parent->children; *next != NULL; next = &(*next)->sibling);
+  *next = node;
+  node->parent = parent;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns the length of the longest common prefix of the label and the path
+ * that ends at a segment boundary in both, or -1 if the first segments differ.
+ */
+static int
+path_common_prefix(const char *label, int label_len, const char *path,
+                   int path_len)
+{
+  int i;
+  int boundary = -1;
+
+  for(i = 0; i < label_len && i < path_len && label[i] == path[i]; ++i) {
+    if(label[i] == '/') {
+      boundary = i;
+    }
+  }
+  if((i == label_len || label[i] == '/') && (i == path_len || path[i] == '/')) {
+    return i;
+  }
+  return boundary;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Adds a resource to the tree. An insertion adds at most one leaf and
+ * splits at most one label, so the two nodes of the resource suffice.
+ */
+static void
+path_insert(resource_t *resource)
+{
+  struct rest_path_node *node = &path_root;
+  struct rest_path_node *child;
+  struct rest_path_node *split;
+  struct rest_path_node **link;
+  const char *path = resource->url;
+  int len = strlen(path);
+  int common = len;
+
+  if(len > 0) {
+    for(;;) {
+      for(child = node->children; child != NULL; child = child->sibling) {
+        common = path_common_prefix(child->label, child->label_len, path, len);
+        if(common >= 0) {
+          break;
+        }
+      }
+
+      if(child == NULL) {
+        /* no shared segments, the rest of the path becomes a new leaf */
+        child = path_node_init(&resource->path_leaf, path, len, resource);
+        path_node_add(node, child);
+        return;
+      }
+
+      if(common < child->label_len) {
+        /* split the label of the child at the last shared segment */
+        split = path_node_init(&resource->path_split, child->label, common,
+                               NULL);
+        for(link = &node->children; *link != child; link = &(*link)->sibling);
+        *link = split;
+        split->parent = node;
+        split->sibling = child->sibling;
+        child->sibling = NULL;
+        child->label += common + 1;
+        child->label_len -= common + 1;
+        path_node_add(split, child);
+        child = split;
+      }
+
+      if(common == len) {
+        break;
+      }
+
+      /* continue after the separating slash */
+      path += common + 1;
+      len -= common + 1;
+      node = child;
+    }
+    node = child;
+  }
+
+  if(node->resource != NULL) {
+    /* the first resource activated for a path takes precedence */
+    PRINTF("Path already active: %s\n", resource->url);
+  } else {
+    node->resource = resource;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static resource_t *
+path_lookup(const char *url, int url_len)
+{
+  struct rest_path_node *node = &path_root;
+  struct rest_path_node *child;
+  resource_t *parent_resource = NULL;
+  int pos = 0;
+
+  if(url_len == 0) {
+    return node->resource;
+  }
+
+  for(;;) {
+    for(child = node->children; child != NULL; child = child->sibling) {
+      if(child->label_len <= url_len - pos
+         && (pos + child->label_len == url_len
+             || url[pos + child->label_len] == '/')
+         && strncmp(child->label, url + pos, child->label_len) == 0) {
+        break;
+      }
+    }
+    if(child == NULL) {
+      /* fall back to the closest resource that handles sub-resources */
+      return parent_resource;
+    }
+
+    pos += child->label_len;
+    if(pos == url_len) {
+      return child->resource != NULL ? child->resource : parent_resource;
+    }
+
+    if(child->resource != NULL
+       && (child->resource->flags & HAS_SUB_RESOURCES)) {
+      parent_resource = child->resource;
+    }
+
+    /* skip the slash */
+    ++pos;
+    node = child;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct rest_path_node *
+path_next(struct rest_path_node *node)
+{
+  /* pre-order traversal, so that resources are listed by path */
+  if(node->children != NULL) {
+    return node->children;
+  }
+  while(node != &path_root) {
+    if(node->sibling != NULL) {
+      return node->sibling;
+    }
+    node = node->parent;
+  }
+  return NULL;
+}
+#endif /* REST_RESOURCE_TREE */
+/*---------------------------------------------------------------------------*/
 /*- REST Engine API ---------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 /**
@@ -80,6 +252,9 @@ rest_init_engine(void)
   initialized = 1;
 
   list_init(restful_services);
+#if REST_RESOURCE_TREE
+  memset(&path_root, 0, sizeof(path_root));
+#endif
 
   REST.set_service_callback(rest_invoke_restful_service);
 
@@ -107,6 +282,10 @@ rest_activate_resource(resource_t *resource, char *path)
 
   PRINTF("Activating: %s\n", resource->url);
 
+#if REST_RESOURCE_TREE
+  path_insert(resource);
+#endif
+
   /* Only add periodic resources with a periodic_handler and a period > 0. */
   if(resource->flags & IS_PERIODIC && resource->periodic->periodic_handler
      && resource->periodic->period) {
@@ -124,6 +303,38 @@ rest_get_resources(void)
   return restful_services;
 }
 /*---------------------------------------------------------------------------*/
+resource_t *
+rest_get_first_resource(rest_resource_iterator_t *iterator)
+{
+#if REST_RESOURCE_TREE
+  iterator->node = &path_root;
+  if(path_root.resource != NULL) {
+    return path_root.resource;
+  }
+  return rest_get_next_resource(iterator);
+#else
+  iterator->resource = (resource_t *)list_head(restful_services);
+  return iterator->resource;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+resource_t *
+rest_get_next_resource(rest_resource_iterator_t *iterator)
+{
+#if REST_RESOURCE_TREE
+  do {
+    iterator->node = path_next(iterator->node);
+  } while(iterator->node != NULL && iterator->node->resource == NULL);
+
+  return iterator->node != NULL ? iterator->node->resource : NULL;
+#else
+  if(iterator->resource != NULL) {
+    iterator->resource = iterator->resource->next;
+  }
+  return iterator->resource;
+#endif
+}
+/*---------------------------------------------------------------------------*/
 int
 rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
                             uint16_t buffer_size, int32_t *offset)
@@ -133,9 +344,16 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
 
   resource_t *resource = NULL;
   const char *url = NULL;
-  int url_len, res_url_len;
+  int url_len;
+#if !REST_RESOURCE_TREE
+  int res_url_len;
+#endif
 
   url_len = REST.get_url(request, &url);
+#if REST_RESOURCE_TREE
+  /* the most specific resource for the path */
+  resource = path_lookup(url, url_len);
+#else
   for(resource = (resource_t *)list_head(restful_services);
       resource; resource = resource->next) {
 
@@ -146,33 +364,37 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
             && (resource->flags & HAS_SUB_RESOURCES)
             && url[res_url_len] == '/'))
        && strncmp(resource->url, url, res_url_len) == 0) {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
-
-      PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
-             (uint16_t)method, resource->flags);
-
-      if((method & METHOD_GET) && resource->get_handler != NULL) {
-        /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_POST) && resource->post_handler != NULL) {
-        /* call handler function */
-        resource->post_handler(request, response, buffer, buffer_size,
-                               offset);
-      } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
-        /* call handler function */
-        resource->put_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
-        /* call handler function */
-        resource->delete_handler(request, response, buffer, buffer_size,
-                                 offset);
-      } else {
-        allowed = 0;
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
-      }
       break;
     }
   }
+#endif /* REST_RESOURCE_TREE */
+
+  if(resource != NULL) {
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
+
+    PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
+           (uint16_t)method, resource->flags);
+
+    if((method & METHOD_GET) && resource->get_handler != NULL) {
+      /* call handler function */
+      resource->get_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_POST) && resource->post_handler != NULL) {
+      /* call handler function */
+      resource->post_handler(request, response, buffer, buffer_size,
+                             offset);
+    } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
+      /* call handler function */
+      resource->put_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
+      /* call handler function */
+      resource->delete_handler(request, response, buffer, buffer_size,
+                               offset);
+    } else {
+      allowed = 0;
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
+    }
+  }
   if(!found) {
     REST.set_response_status(response, REST.status.NOT_FOUND);
   } else if(allowed) {
@@ -62,6 +62,15 @@
 #define REST_MAX_CHUNK_SIZE     64
 #endif
 
+/*
+ * Resolve request URLs through a radix tree over the path segments of
+ * the activated resources instead of comparing the URL with every
+ * resource. Each resource carries the two tree nodes it may need.
+ */
+#ifndef REST_RESOURCE_TREE
+#define REST_RESOURCE_TREE      0
+#endif
+
 struct resource_s;
 struct periodic_resource_s;
 
@@ -80,6 +89,22 @@ typedef int (*service_callback_t)(void *request, void *response,
                                   uint8_t *buffer, uint16_t preferred_size,
                                   int32_t *offset);
 
+#if REST_RESOURCE_TREE
+/*
+ * A node in the radix tree of resource paths. The label of a node consists
+ * of one or more whole path segments and points into the url of a resource.
+ * A tree of n resources has at most n leaves and n - 1 inner nodes.
+ */
+struct rest_path_node {
+  struct rest_path_node *parent;
+  struct rest_path_node *children;
+  struct rest_path_node *sibling;
+  struct resource_s *resource;
+  const char *label;
+  uint16_t label_len;
+};
+#endif
+
 /* data structure representing a resource in REST */
 struct resource_s {
   struct resource_s *next;        /* for LIST, points to next resource defined */
@@ -95,6 +120,10 @@ struct resource_s {
     restful_trigger_handler trigger;
     restful_trigger_handler resume;
   };
+#if REST_RESOURCE_TREE
+  struct rest_path_node path_leaf;  /* node of the resource in the path tree */
+  struct rest_path_node path_split; /* inner node added when it is activated */
+#endif
 };
 typedef struct resource_s resource_t;
 
@@ -134,6 +163,16 @@ typedef struct periodic_resource_s periodic_resource_t;
   resource_t name = { NULL, NULL, IS_OBSERVABLE | IS_PERIODIC, attributes, get_handler, post_handler, put_handler, delete_handler, { .periodic = &periodic_##name } }; \
   periodic_resource_t periodic_##name = { NULL, &name, period, { { 0 } }, periodic_handler };
 
+/* state for iterating over the activated resources */
+struct rest_resource_iterator {
+#if REST_RESOURCE_TREE
+  struct rest_path_node *node;
+#else
+  resource_t *resource;
+#endif
+};
+typedef struct rest_resource_iterator rest_resource_iterator_t;
+
 struct rest_implementation {
   char *name;
 
@@ -254,5 +293,24 @@ void rest_activate_resource(resource_t *resource, char *path);
  */
 list_t rest_get_resources(void);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Starts an iteration over the activated resources.
+ * \param iterator
+ *             The iteration state, which is passed on to rest_get_next_resource().
+ * \return     The first resource, or NULL if no resources are activated.
+ *
+ * With REST_RESOURCE_TREE, the resources are returned in path order,
+ * otherwise in the order of activation.
+ */
+resource_t *rest_get_first_resource(rest_resource_iterator_t *iterator);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Continues an iteration over the activated resources.
+ * \param iterator
+ *             The iteration state set by rest_get_first_resource().
+ * \return     The next resource, or NULL when all resources have been returned.
+ */
+resource_t *rest_get_next_resource(rest_resource_iterator_t *iterator);
+/*---------------------------------------------------------------------------*/
 
 #endif /*REST_ENGINE_H_ */
@@ -158,6 +158,31 @@ strcasecmp(const char *s1, const char *s2)
 #define RESOLV_SUPPORTS_RECORD_EXPIRATION 1
 #endif
 
+/** How long, in seconds, a server error or a query that went
+ *  unanswered is remembered. */
+#ifndef RESOLV_CONF_ERROR_TTL
+#define RESOLV_CONF_ERROR_TTL 30
+#endif
+
+/** How long, in seconds, a name that does not exist (NXDOMAIN) or that
+ *  has no address is remembered when the server does not say. Servers
+ *  normally include their SOA record, which gives the time (RFC 2308). */
+#ifndef RESOLV_CONF_NEGATIVE_TTL
+#define RESOLV_CONF_NEGATIVE_TTL 30
+#endif
+
+/** The longest time, in seconds, a negative answer is remembered. */
+#ifndef RESOLV_CONF_MAX_NEGATIVE_TTL
+#define RESOLV_CONF_MAX_NEGATIVE_TTL 3600
+#endif
+
+/** A name that is looked up less than this many seconds before its
+ *  record expires is refreshed in the background. The old address is
+ *  used until the new answer has arrived. Set to 0 to disable. */
+#ifndef RESOLV_CONF_PREFETCH_TIME
+#define RESOLV_CONF_PREFETCH_TIME 10
+#endif
+
 #if RESOLV_CONF_SUPPORTS_MDNS && !RESOLV_VERIFY_ANSWER_NAMES
 #error RESOLV_CONF_SUPPORTS_MDNS cannot be set without RESOLV_CONF_VERIFY_ANSWER_NAMES
 #endif
@@ -178,6 +203,7 @@ strcasecmp(const char *s1, const char *s2)
 
 #define DNS_TYPE_A      1
 #define DNS_TYPE_CNAME  5
+#define DNS_TYPE_SOA    6
 #define DNS_TYPE_PTR   12
 #define DNS_TYPE_MX    15
 #define DNS_TYPE_TXT   16
@@ -252,6 +278,7 @@ struct namemap {
   uint8_t state;
   uint8_t tmr;
   uint16_t id;
+  uint16_t hash;
   uint8_t retries;
   uint8_t seqno;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
@@ -260,6 +287,7 @@ struct namemap {
   uip_ipaddr_t ipaddr;
   uint8_t err;
   uint8_t server;
+  uint8_t is_prefetch;
 #if RESOLV_CONF_SUPPORTS_MDNS
   int is_mdns:1, is_probe:1;
 #endif
@@ -628,6 +656,75 @@ mdns_prep_host_announce_packet(void)
 }
 #endif /* RESOLV_CONF_SUPPORTS_MDNS */
 /*---------------------------------------------------------------------------*/
+/** \internal
+ * A case insensitive hash of a name, so that the names in the table
+ * only need to be compared when their hashes match.
+ */
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash = 0;
+
+  while(*name) {
+    hash = (hash << 5) + hash + tolower((unsigned char)*name++);
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static struct namemap *
+find_name(const char *name, uint16_t hash)
+{
+  uint8_t i;
+
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    if(names[i].state != STATE_UNUSED && names[i].hash == hash &&
+       strcasecmp(names[i].name, name) == 0) {
+      return &names[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+/** \internal
+ * Returns how long a negative answer should be remembered: the smaller
+ * of the TTL of the SOA record in the authority section and the
+ * minimum field of that record (RFC 2308, section 5).
+ */
+static unsigned long
+negative_ttl(unsigned char *ptr, uint8_t nanswers, uint8_t nauthrr)
+{
+  const unsigned char *end = (unsigned char *)uip_appdata + uip_datalen();
+  unsigned long ttl, minimum;
+  uint16_t len, n;
+
+  /* The answers, typically CNAME records, come before the authority
+     section. */
+  for(n = nanswers + nauthrr; n > 0; --n) {
+    ptr = skip_name(ptr);
+    if(ptr + 10 > end) {
+      break;
+    }
+    len = (ptr[8] << 8) + ptr[9];
+    if(n <= nauthrr && ptr[0] == 0 && ptr[1] == DNS_TYPE_SOA &&
+              len >= 20 && ptr + 10 + len <= end) {
+      ttl = ((unsigned long)ptr[4] << 24) | ((unsigned long)ptr[5] << 16) |
+        ((unsigned long)ptr[6] << 8) | ptr[7];
+      ptr += 10 + len - 4;
+      minimum = ((unsigned long)ptr[0] << 24) | ((unsigned long)ptr[1] << 16) |
+        ((unsigned long)ptr[2] << 8) | ptr[3];
+      if(minimum < ttl) {
+        ttl = minimum;
+      }
+      return ttl < RESOLV_CONF_MAX_NEGATIVE_TTL ?
+        ttl : RESOLV_CONF_MAX_NEGATIVE_TTL;
+    }
+    ptr += 10 + len;
+  }
+  return RESOLV_CONF_NEGATIVE_TTL;
+}
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+/*---------------------------------------------------------------------------*/
 static char
 try_next_server(struct namemap *namemapptr)
 {
@@ -675,12 +772,18 @@ check_entries(void)
             /* Try the next server (if possible) before failing. Otherwise
                simply mark the entry as failed. */
             if(try_next_server(namemapptr) == 0) {
+              if(namemapptr->is_prefetch) {
+                /* The record we have stays valid until it expires. */
+                namemapptr->state = STATE_DONE;
+                namemapptr->is_prefetch = 0;
+                continue;
+              }
+
               /* STATE_ERROR basically means "not found". */
               namemapptr->state = STATE_ERROR;
 
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-              /* Keep the "not found" error valid for 30 seconds */
-              namemapptr->expiration = clock_seconds() + 30;
+              namemapptr->expiration = clock_seconds() + RESOLV_CONF_ERROR_TTL;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
               resolv_found(namemapptr->name, NULL);
@@ -895,11 +998,6 @@ newdata(void)
 
 /** ANSWER HANDLING SECTION **************************************************/
 
-  if(nanswers == 0) {
-    /* Skip responses with no answers. */
-    return;
-  }
-
 #if RESOLV_CONF_SUPPORTS_MDNS
   if(UIP_UDP_BUF->srcport == UIP_HTONS(MDNS_PORT) &&
      hdr->id == 0) {
@@ -907,6 +1005,10 @@ newdata(void)
      * because we can't use the `id` field. We will look up the
      * appropriate request in a later step. */
 
+    if(nanswers == 0) {
+      /* Skip responses with no answers. */
+      return;
+    }
     i = -1;
     namemapptr = NULL;
   } else
@@ -927,22 +1029,46 @@ newdata(void)
 
     PRINTF("resolver: Incoming response for \"%s\".\n", namemapptr->name);
 
-    /* We'll change this to DONE when we find the record. */
-    namemapptr->state = STATE_ERROR;
-
     namemapptr->err = hdr->flags2 & DNS_FLAG2_ERR_MASK;
 
+    if(namemapptr->err == DNS_FLAG2_ERR_NAME ||
+       (namemapptr->err == DNS_FLAG2_ERR_NONE && nanswers == 0)) {
+      /* The name does not exist, or it has no address. This is a
+       * definite answer, which is cached for as long as the server
+       * tells us to. */
+      namemapptr->state = STATE_ERROR;
+      namemapptr->is_prefetch = 0;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    /* If we remain in the error state, keep it cached for 30 seconds. */
-    namemapptr->expiration = clock_seconds() + 30;
+      namemapptr->expiration = clock_seconds() +
+        negative_ttl(queryptr, nanswers, (uint8_t)uip_ntohs(hdr->numauthrr));
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+      resolv_found(namemapptr->name, NULL);
+      return;
+    }
 
     /* Check for error. If so, call callback to inform. */
     if(namemapptr->err != 0) {
+      if(namemapptr->is_prefetch) {
+        /* Keep using the record we have until it expires. */
+        namemapptr->state = STATE_DONE;
+        namemapptr->is_prefetch = 0;
+        return;
+      }
       namemapptr->state = STATE_ERROR;
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      namemapptr->expiration = clock_seconds() + RESOLV_CONF_ERROR_TTL;
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
       resolv_found(namemapptr->name, NULL);
       return;
     }
+
+    /* We'll change this to DONE when we find the record. */
+    if(!namemapptr->is_prefetch) {
+      namemapptr->state = STATE_ERROR;
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      namemapptr->expiration = clock_seconds() + RESOLV_CONF_ERROR_TTL;
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+    }
   }
 
   i = 0;
@@ -1013,6 +1139,7 @@ newdata(void)
           namemapptr = NULL;
           goto skip_to_next_answer;
         }
+        namemapptr->hash = name_hash(namemapptr->name);
       }
       if(i == RESOLV_ENTRIES) {
         DEBUG_PRINTF
@@ -1046,8 +1173,10 @@ newdata(void)
     DEBUG_PRINTF("resolver: Answer for \"%s\" is usable.\n", namemapptr->name);
 
     namemapptr->state = STATE_DONE;
+    namemapptr->is_prefetch = 0;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    namemapptr->expiration = ans->ttl[1] + (ans->ttl[0] << 8);
+    namemapptr->expiration = ((unsigned long)uip_ntohs(ans->ttl[0]) << 16) |
+      uip_ntohs(ans->ttl[1]);
     namemapptr->expiration += clock_seconds();
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
@@ -1073,6 +1202,9 @@ newdata(void)
     if(try_next_server(namemapptr)) {
       namemapptr->state = STATE_ASKING;
       process_post(&resolv_process, PROCESS_EVENT_TIMER, NULL);
+    } else if(namemapptr->is_prefetch) {
+      namemapptr->state = STATE_DONE;
+      namemapptr->is_prefetch = 0;
     }
   }
 
@@ -1272,16 +1404,37 @@ resolv_query(const char *name)
 
   register struct namemap *nameptr = 0;
 
+  struct namemap *found;
+
+  uint16_t hash;
+
   init();
   
   lseq = lseqi = 0;
 
   /* Remove trailing dots, if present. */
   name = remove_trailing_dots(name);
+  hash = name_hash(name);
+
+  found = find_name(name, hash);
+  if(found != NULL &&
+     (found->state == STATE_NEW || found->state == STATE_ASKING)
+#if RESOLV_CONF_SUPPORTS_MDNS
+     && !found->is_probe
+#endif /* RESOLV_CONF_SUPPORTS_MDNS */
+    ) {
+    /* A query for this name is already on its way. Its answer is
+     * broadcast to all processes, so another one is not needed. A
+     * background refresh now has someone waiting for it, so it must
+     * report failures too. */
+    PRINTF("resolver: Query for \"%s\" already outstanding.\n", name);
+    found->is_prefetch = 0;
+    return;
+  }
 
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
     nameptr = &names[i];
-    if(0 == strcasecmp(nameptr->name, name)) {
+    if(nameptr == found) {
       break;
     }
     if((nameptr->state == STATE_UNUSED)
@@ -1307,6 +1460,7 @@ resolv_query(const char *name)
   memset(nameptr, 0, sizeof(*nameptr));
 
   strncpy(nameptr->name, name, sizeof(nameptr->name));
+  nameptr->hash = hash;
   nameptr->state = STATE_NEW;
   nameptr->seqno = seqno;
   ++seqno;
@@ -1347,8 +1501,6 @@ resolv_lookup(const char *name, uip_ipaddr_t ** ipaddr)
 {
   resolv_status_t ret = RESOLV_STATUS_UNCACHED;
 
-  static uint8_t i;
-
   struct namemap *nameptr;
 
   /* Remove trailing dots, if present. */
@@ -1370,41 +1522,50 @@ resolv_lookup(const char *name, uip_ipaddr_t ** ipaddr)
   }
 #endif /* UIP_CONF_LOOPBACK_INTERFACE */
 
-  /* Walk through the list to see if the name is in there. */
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-
-    if(strcasecmp(name, nameptr->name) == 0) {
-      switch (nameptr->state) {
-      case STATE_DONE:
-        ret = RESOLV_STATUS_CACHED;
-#if RESOLV_SUPPORTS_RECORD_EXPIRATION
-        if(clock_seconds() > nameptr->expiration) {
-          ret = RESOLV_STATUS_EXPIRED;
-        }
-#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
-        break;
-      case STATE_NEW:
-      case STATE_ASKING:
+  /* See if the name is in the table. */
+  nameptr = find_name(name, name_hash(name));
+  if(nameptr != NULL) {
+    switch (nameptr->state) {
+    case STATE_NEW:
+    case STATE_ASKING:
+      if(!nameptr->is_prefetch) {
         ret = RESOLV_STATUS_RESOLVING;
         break;
-      /* Almost certainly a not-found error from server */
-      case STATE_ERROR:
-        ret = RESOLV_STATUS_NOT_FOUND;
+      }
+      /* The record is being refreshed in the background, and the one
+       * we have can be used until it expires. */
+      /* FALLTHROUGH */
+    case STATE_DONE:
+      ret = RESOLV_STATUS_CACHED;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-        if(clock_seconds() > nameptr->expiration) {
-          ret = RESOLV_STATUS_UNCACHED;
-        }
-#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
-        break;
+      if(clock_seconds() > nameptr->expiration) {
+        ret = RESOLV_STATUS_EXPIRED;
       }
-
-      if(ipaddr) {
-        *ipaddr = &nameptr->ipaddr;
+#if RESOLV_CONF_PREFETCH_TIME
+      else if(nameptr->state == STATE_DONE &&
+              nameptr->expiration - clock_seconds() <
+              RESOLV_CONF_PREFETCH_TIME) {
+        PRINTF("resolver: Refreshing \"%s\".\n", nameptr->name);
+        nameptr->state = STATE_NEW;
+        nameptr->is_prefetch = 1;
+        process_post(&resolv_process, PROCESS_EVENT_TIMER, 0);
       }
-
-      /* Break out of for loop. */
+#endif /* RESOLV_CONF_PREFETCH_TIME */
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
       break;
+    /* Almost certainly a not-found error from server */
+    case STATE_ERROR:
+      ret = RESOLV_STATUS_NOT_FOUND;
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      if(clock_seconds() > nameptr->expiration) {
+        ret = RESOLV_STATUS_UNCACHED;
+      }
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+      break;
+    }
+
+    if(ipaddr) {
+      *ipaddr = &nameptr->ipaddr;
     }
   }
 
@@ -55,6 +55,54 @@ call_event(struct tcp_socket *s, tcp_socket_event_t event)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP_SEND_WINDOW > 1
+static void
+senddata(struct tcp_socket *s)
+{
+  int len = MIN(s->output_data_max_seg, uip_mss());
+
+  if(uip_rexmit()) {
+    /* Only the oldest unacknowledged segment is retransmitted. */
+    len = MIN(s->output_data_send_nxt, len);
+    if(len > 0) {
+      uip_send(s->output_data_ptr, len);
+    }
+    return;
+  }
+
+  len = MIN(uip_sendwnd(), len);
+  len = MIN(s->output_data_len - s->output_data_send_nxt, len);
+  if(len > 0) {
+    uip_send(&s->output_data_ptr[s->output_data_send_nxt], len);
+    s->output_data_send_nxt += len;
+    if(s->output_data_send_nxt < s->output_data_len &&
+       uip_sendwnd() > len) {
+      /* There is more data and room for it: ask for another
+         segment right away instead of waiting for the ACK. */
+      tcpip_poll_tcp(s->c);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+acked(struct tcp_socket *s)
+{
+  uint16_t len = uip_ackedlen();
+
+  if(len > s->output_data_send_nxt) {
+    len = s->output_data_send_nxt;
+  }
+  if(len > 0) {
+    memmove(&s->output_data_ptr[0], &s->output_data_ptr[len],
+            s->output_data_len - len);
+    s->output_data_len -= len;
+    s->output_data_send_nxt -= len;
+    s->output_senddata_len = s->output_data_len;
+
+    call_event(s, TCP_SOCKET_DATA_SENT);
+  }
+}
+#else /* UIP_TCP_SEND_WINDOW > 1 */
 static void
 senddata(struct tcp_socket *s)
 {
@@ -96,6 +144,7 @@ acked(struct tcp_socket *s)
     call_event(s, TCP_SOCKET_DATA_SENT);
   }
 }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 /*---------------------------------------------------------------------------*/
 static void
 newdata(struct tcp_socket *s)
@@ -148,6 +197,9 @@ appcall(void *state)
     return;
   }
   if(uip_connected()) {
+#if UIP_TCP_SEND_WINDOW > 1
+    uip_sendwindow(UIP_TCP_SEND_WINDOW);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     /* Check if this connection originated in a local listen
        socket. We do this by checking the state pointer - if NULL,
        this is an incoming listen connection. If so, we need to
@@ -356,6 +408,13 @@ tcp_socket_send(struct tcp_socket *s,
     s->output_senddata_len = s->output_data_len;
   }
 
+#if UIP_TCP_SEND_WINDOW > 1
+  if(s->c != NULL && len > 0) {
+    /* Let the window fill without waiting for the periodic poll. */
+    tcpip_poll_tcp(s->c);
+  }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
   return len;
 }
 /*---------------------------------------------------------------------------*/
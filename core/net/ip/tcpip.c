@@ -70,6 +70,7 @@ extern struct uip_fallback_interface UIP_FALLBACK_INTERFACE;
 
 #if UIP_CONF_IPV6_RPL
 #include "rpl/rpl.h"
+#include "rpl/rpl-shaper.h"
 #endif
 
 process_event_t tcpip_event;
@@ -152,6 +153,30 @@ tcpip_set_outputfunc(uint8_t (*f)(void))
 unsigned char tcpip_is_forwarding; /* Forwarding right now? */
 #endif /* UIP_CONF_IP_FORWARD */
 
+#if TCPIP_NEXTHOP_CACHE_SIZE
+#if !UIP_DS6_NOTIFICATIONS
+#error "The next-hop cache needs UIP_CONF_UIP_DS6_NOTIFICATIONS"
+#endif
+
+/* A destination and the neighbor that packets to it were last sent
+   to. The neighbor address is kept to detect entries that nbr-table
+   has handed to another neighbor. The route, if any, is kept so that
+   hits still refresh its position in the route list. */
+struct nexthop_cache_entry {
+  uip_ipaddr_t destipaddr;
+  uip_ipaddr_t nexthop;
+  uip_ds6_nbr_t *nbr;
+  uip_ds6_route_t *route;
+};
+
+static struct nexthop_cache_entry nexthop_cache[TCPIP_NEXTHOP_CACHE_SIZE];
+static struct tcpip_nexthop_cache_stats nexthop_stats;
+static struct uip_ds6_notification nexthop_notification;
+
+#define NEXTHOP_CACHE_INDEX(addr) (((addr)->u8[14] ^ (addr)->u8[15]) % \
+                                   TCPIP_NEXTHOP_CACHE_SIZE)
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
+
 PROCESS(tcpip_process, "TCP/IP stack");
 
 /*---------------------------------------------------------------------------*/
@@ -401,7 +426,7 @@ eventhandler(process_event_t ev, process_data_t data)
         for(cptr = &uip_udp_conns[0];
             cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
           if(cptr->appstate.p == p) {
-            cptr->lport = 0;
+            uip_udp_remove(cptr);
           }
         }
       }
@@ -520,11 +545,70 @@ tcpip_input(void)
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
+#if TCPIP_NEXTHOP_CACHE_SIZE
+static void
+nexthop_cache_flush(int event, uip_ipaddr_t *route, uip_ipaddr_t *nexthop,
+                    int num_routes)
+{
+  int i;
+
+  for(i = 0; i < TCPIP_NEXTHOP_CACHE_SIZE; i++) {
+    /* A removed neighbor only invalidates the entries that use it;
+       any other change may redirect every destination. */
+    if(event != UIP_DS6_NOTIFICATION_NBR_RM ||
+       (nexthop_cache[i].nbr != NULL &&
+        &nexthop_cache[i].nbr->ipaddr == nexthop)) {
+      nexthop_cache[i].nbr = NULL;
+    }
+  }
+  nexthop_stats.flushes++;
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_nbr_t *
+nexthop_cache_lookup(const uip_ipaddr_t *destipaddr)
+{
+  struct nexthop_cache_entry *e;
+
+  e = &nexthop_cache[NEXTHOP_CACHE_INDEX(destipaddr)];
+  if(e->nbr != NULL &&
+     uip_ipaddr_cmp(&e->destipaddr, destipaddr) &&
+     uip_ipaddr_cmp(&e->nbr->ipaddr, &e->nexthop)) {
+    nexthop_stats.hits++;
+    if(e->route != NULL) {
+      uip_ds6_route_touch(e->route);
+    }
+    return e->nbr;
+  }
+  nexthop_stats.misses++;
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+nexthop_cache_add(const uip_ipaddr_t *destipaddr, uip_ds6_nbr_t *nbr,
+                  uip_ds6_route_t *route)
+{
+  struct nexthop_cache_entry *e;
+
+  e = &nexthop_cache[NEXTHOP_CACHE_INDEX(destipaddr)];
+  uip_ipaddr_copy(&e->destipaddr, destipaddr);
+  uip_ipaddr_copy(&e->nexthop, &nbr->ipaddr);
+  e->nbr = nbr;
+  e->route = route;
+}
+/*---------------------------------------------------------------------------*/
+const struct tcpip_nexthop_cache_stats *
+tcpip_nexthop_cache_stats(void)
+{
+  return &nexthop_stats;
+}
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
+/*---------------------------------------------------------------------------*/
 #if NETSTACK_CONF_WITH_IPV6
 void
 tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
+  uip_ds6_route_t *route = NULL;
   uip_ipaddr_t *nexthop;
 
   if(uip_len == 0) {
@@ -547,13 +631,20 @@ tcpip_ipv6_output(void)
     /* Next hop determination */
     nbr = NULL;
 
+#if TCPIP_NEXTHOP_CACHE_SIZE
+    /* Packets to a destination we have recently sent to go to the
+       same neighbor, unless the routing state has changed since. */
+    nbr = nexthop_cache_lookup(&UIP_IP_BUF->destipaddr);
+    if(nbr != NULL) {
+      nexthop = &nbr->ipaddr;
+    } else
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
     /* We first check if the destination address is on our immediate
        link. If so, we simply use the destination address as our
        nexthop address. */
     if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
       nexthop = &UIP_IP_BUF->destipaddr;
     } else {
-      uip_ds6_route_t *route;
       /* Check if we have a route to the destination address. */
       route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
 
@@ -641,7 +732,19 @@ tcpip_ipv6_output(void)
       return;
     }
 #endif /* UIP_CONF_IPV6_RPL */
+#if TCPIP_NEXTHOP_CACHE_SIZE
+    if(nbr == NULL) {
+      nbr = uip_ds6_nbr_lookup(nexthop);
+      /* The default router is chosen anew for every packet, so only
+         on-link destinations and routed ones are cached. */
+      if(nbr != NULL &&
+         (route != NULL || nexthop == &UIP_IP_BUF->destipaddr)) {
+        nexthop_cache_add(&UIP_IP_BUF->destipaddr, nbr, route);
+      }
+    }
+#else /* TCPIP_NEXTHOP_CACHE_SIZE */
     nbr = uip_ds6_nbr_lookup(nexthop);
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
     if(nbr == NULL) {
 #if UIP_ND6_SEND_NA
       if((nbr = uip_ds6_nbr_add(nexthop, NULL, 0, NBR_INCOMPLETE)) == NULL) {
@@ -700,6 +803,13 @@ tcpip_ipv6_output(void)
       }
 #endif /* UIP_ND6_SEND_NA */
 
+#if UIP_CONF_IPV6_RPL && RPL_SHAPER
+      /* The root paces traffic into each subtree of the DAG. A packet
+         taken by the shaper must not hold back the queued one. */
+      if(rpl_shaper_output(uip_ds6_nbr_get_ll(nbr))) {
+        uip_clear_buf();
+      } else
+#endif /* UIP_CONF_IPV6_RPL && RPL_SHAPER */
       tcpip_output(uip_ds6_nbr_get_ll(nbr));
 
 #if UIP_CONF_IPV6_QUEUE_PKT
@@ -810,6 +920,9 @@ PROCESS_THREAD(tcpip_process, ev, data)
   etimer_set(&periodic, CLOCK_SECOND / 2);
 
   uip_init();
+#if TCPIP_NEXTHOP_CACHE_SIZE
+  uip_ds6_notification_add(&nexthop_notification, nexthop_cache_flush);
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
 #ifdef UIP_FALLBACK_INTERFACE
   UIP_FALLBACK_INTERFACE.init();
 #endif
@@ -355,6 +355,36 @@ void tcpip_set_outputfunc(uint8_t (* f)(void));
 void tcpip_ipv6_output(void);
 #endif
 
+/**
+ * \brief The number of destinations for which tcpip_ipv6_output()
+ * remembers the next-hop neighbor, 0 to resolve every packet.
+ *
+ * The cache is direct-mapped on the destination address. It is
+ * flushed through the uip-ds6 notification interface whenever a
+ * route, default router, neighbor or on-link prefix changes.
+ */
+#if NETSTACK_CONF_WITH_IPV6 && defined TCPIP_CONF_NEXTHOP_CACHE_SIZE
+#define TCPIP_NEXTHOP_CACHE_SIZE TCPIP_CONF_NEXTHOP_CACHE_SIZE
+#else
+#define TCPIP_NEXTHOP_CACHE_SIZE 0
+#endif
+
+#if TCPIP_NEXTHOP_CACHE_SIZE
+/**
+ * \brief Next-hop cache counters
+ */
+struct tcpip_nexthop_cache_stats {
+  unsigned long hits;     /**< Packets sent without resolving the next hop. */
+  unsigned long misses;   /**< Packets for which the next hop was resolved. */
+  unsigned long flushes;  /**< Times the cache was invalidated. */
+};
+
+/**
+ * \brief Get the next-hop cache counters
+ */
+const struct tcpip_nexthop_cache_stats *tcpip_nexthop_cache_stats(void);
+#endif /* TCPIP_NEXTHOP_CACHE_SIZE */
+
 /**
  * \brief Is forwarding generally enabled?
  */
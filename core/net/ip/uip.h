@@ -835,6 +835,63 @@ CCIF void uip_send(const void *data, int len);
  */
 #define uip_mss()             (uip_conn->mss)
 
+#if UIP_TCP_SEND_WINDOW > 1
+/**
+ * Let the current connection have up to n segments in flight.
+ *
+ * This function may be called from within the application once the
+ * connection is established. The application must then keep all
+ * unacknowledged data, send new data at most uip_sendwnd() bytes at a
+ * time, discard uip_ackedlen() bytes whenever uip_acked() is true, and
+ * resend from the oldest unacknowledged byte when uip_rexmit() is
+ * true.
+ *
+ * \hideinitializer
+ */
+#define uip_sendwindow(n) (uip_conn->snd_window = (n) > UIP_TCP_SEND_WINDOW ? \
+                           UIP_TCP_SEND_WINDOW : (n))
+
+/**
+ * \internal
+ *
+ * The number of bytes a windowed connection may still send.
+ *
+ * \hideinitializer
+ */
+#define uip_conn_sendwnd(conn) ((conn)->snd_window > 1 &&             \
+                                (conn)->snd_wnd > (conn)->len ?        \
+                                (conn)->snd_wnd - (conn)->len : 0)
+#else /* UIP_TCP_SEND_WINDOW > 1 */
+#define uip_conn_sendwnd(conn) 0
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
+/**
+ * The number of bytes of new data that can be sent on the current
+ * connection right now.
+ *
+ * For connections without a send window this is the MSS if there is
+ * no outstanding data, and zero otherwise.
+ *
+ * \hideinitializer
+ */
+#if UIP_TCP_SEND_WINDOW > 1
+#define uip_sendwnd()         (uip_conn->snd_window > 1 ?               \
+                               uip_conn_sendwnd(uip_conn) :            \
+                               (uip_outstanding(uip_conn) ? 0 : uip_mss()))
+#else /* UIP_TCP_SEND_WINDOW > 1 */
+#define uip_sendwnd()         (uip_outstanding(uip_conn) ? 0 : uip_mss())
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
+/**
+ * The number of bytes acknowledged by the incoming segment.
+ *
+ * Only valid when uip_acked() is true. Without a send window this is
+ * everything that was sent.
+ *
+ * \hideinitializer
+ */
+#define uip_ackedlen()        (uip_acklen)
+
 /**
  * Set up a new UDP connection.
  *
@@ -871,7 +928,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH
+#define uip_udp_remove(conn) uip_udp_rebind(conn, 0)
+#else /* UIP_CONN_HASH */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_CONN_HASH */
 
 /**
  * Bind a UDP connection to a local port.
@@ -883,7 +944,28 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH
+#define uip_udp_bind(conn, port) uip_udp_rebind(conn, port)
+#else /* UIP_CONN_HASH */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_CONN_HASH */
+
+#if UIP_CONN_HASH
+/**
+ * \internal
+ *
+ * Change the local port of a UDP connection and move it to the
+ * matching hash bucket. Use uip_udp_bind() and uip_udp_remove()
+ * instead of calling this function directly.
+ *
+ * \param conn A pointer to the uip_udp_conn structure for the
+ * connection.
+ *
+ * \param lport The new local port number, in network byte order, or
+ * zero to release the connection.
+ */
+void uip_udp_rebind(struct uip_udp_conn *conn, uint16_t lport);
+#endif /* UIP_CONN_HASH */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1367,6 +1449,12 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
                               segment sent. */
+#if UIP_TCP_SEND_WINDOW > 1
+  uint8_t snd_window;    /**< The number of segments the application
+                              allows in flight, set by uip_sendwindow(). */
+  uint8_t dupacks;       /**< The number of duplicate ACKs received. */
+  uint16_t snd_wnd;      /**< The usable send window in bytes. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1395,6 +1483,11 @@ CCIF extern struct uip_conn uip_conns[UIP_CONNS];
  * 4-byte array used for the 32-bit sequence number calculations.
  */
 extern uint8_t uip_acc32[4];
+
+/**
+ * Number of bytes acknowledged by the last incoming TCP segment.
+ */
+extern uint16_t uip_acklen;
 /** @} */
 
 /**
@@ -1465,6 +1558,10 @@ struct uip_stats {
                                IP length, low byte. */
     uip_stats_t fragerr;  /**< Number of packets dropped because they
                                were IP fragments. */
+    uip_stats_t reassdrop;    /**< Number of fragments dropped because
+                                   all reassembly contexts were busy. */
+    uip_stats_t reasstimeout; /**< Number of datagrams whose reassembly
+                                   timed out. */
     uip_stats_t chkerr;   /**< Number of packets dropped due to IP
                                checksum errors. */
     uip_stats_t protoerr; /**< Number of packets dropped because they
@@ -302,6 +302,17 @@ void uip_log(char *msg);
 #define UIP_CONF_IPV6_REASSEMBLY      0
 #endif
 
+/** How many fragmented IPv6 datagrams can be reassembled at the same
+    time (default: 1). Each one needs a buffer of UIP_BUFSIZE bytes, so
+    this is the memory budget for reassembly. When all are in use,
+    fragments of new datagrams are dropped until a reassembly completes
+    or times out. */
+#ifdef UIP_CONF_IPV6_REASS_CONTEXTS
+#define UIP_REASS_CONTEXTS UIP_CONF_IPV6_REASS_CONTEXTS
+#else /* UIP_CONF_IPV6_REASS_CONTEXTS */
+#define UIP_REASS_CONTEXTS 1
+#endif /* UIP_CONF_IPV6_REASS_CONTEXTS */
+
 #ifndef UIP_CONF_NETIF_MAX_ADDRESSES
 /** Default number of IPv6 addresses associated to the node's interface */
 #define UIP_CONF_NETIF_MAX_ADDRESSES  3
@@ -435,6 +446,26 @@ void uip_log(char *msg);
 #define UIP_LISTENPORTS (UIP_CONF_MAX_LISTENPORTS)
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of hash buckets used to demultiplex incoming packets to
+ * UDP and TCP connections.
+ *
+ * By default, incoming packets are matched by walking the whole
+ * connection tables. Hosts that configure hundreds of connections,
+ * such as border routers running proxies, can set this to make the
+ * cost per packet independent of the number of connections. UDP
+ * connections are hashed on their local port and TCP connections on
+ * their address and port pair. Each bucket and each connection
+ * costs 2 bytes of memory. Only the IPv6 stack supports this.
+ *
+ * \hideinitializer
+ */
+#if defined UIP_CONF_CONN_HASH && NETSTACK_CONF_WITH_IPV6
+#define UIP_CONN_HASH (UIP_CONF_CONN_HASH)
+#else /* UIP_CONF_CONN_HASH */
+#define UIP_CONN_HASH 0
+#endif /* UIP_CONF_CONN_HASH */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -485,6 +516,27 @@ void uip_log(char *msg);
 #define UIP_TCP_MSS     (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 #endif /* UIP_CONF_TCP_MSS */
 
+/**
+ * The number of TCP segments a connection may have in flight.
+ *
+ * uIP normally sends a single segment and waits for it to be
+ * acknowledged. With a larger value, connections that call
+ * uip_sendwindow() may have up to this many segments outstanding. The
+ * application still keeps the unacknowledged data: partial
+ * acknowledgements are reported through uip_ackedlen(), and on a
+ * retransmission the application is asked for the oldest segment
+ * only. Three duplicate ACKs trigger the retransmission without
+ * waiting for the timer. This does not change the receive window;
+ * set UIP_CONF_RECEIVE_WINDOW to let peers send several segments.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEND_WINDOW
+#define UIP_TCP_SEND_WINDOW (UIP_CONF_TCP_SEND_WINDOW)
+#else /* UIP_CONF_TCP_SEND_WINDOW */
+#define UIP_TCP_SEND_WINDOW 1
+#endif /* UIP_CONF_TCP_SEND_WINDOW */
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -500,6 +552,10 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+#if UIP_RECEIVE_WINDOW > 0xffff
+#error UIP_CONF_RECEIVE_WINDOW does not fit in the 16-bit TCP window field
+#endif /* UIP_RECEIVE_WINDOW > 0xffff */
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
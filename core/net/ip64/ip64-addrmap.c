@@ -32,96 +32,228 @@
 #include "ip64-addrmap.h"
 
 #include "lib/memb.h"
-#include "lib/list.h"
 
 #include "ip64-conf.h"
 
 #include "lib/random.h"
 
+#include <stddef.h>
 #include <string.h>
 
+#define DEBUG 0
+#include "net/ip/uip-debug.h"
+
 #ifdef IP64_ADDRMAP_CONF_ENTRIES
 #define NUM_ENTRIES IP64_ADDRMAP_CONF_ENTRIES
 #else /* IP64_ADDRMAP_CONF_ENTRIES */
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+/* Number of buckets in each of the two hash tables that index the
+   address mappings: one on the IPv6/IPv4 address/port/protocol tuple
+   for packets going out to the IPv4 network, and one on the mapped
+   port for packets coming back. Must be a power of two. */
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE 16
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
+/* The address mappings are expired through a timer wheel with
+   WHEEL_SLOTS slots, each covering WHEEL_SLOT_TIME clock ticks. An
+   entry sits in the slot during which its timer is expected to
+   expire, so that finding the expired entries only means looking at
+   the slots that have passed since the last time we checked. */
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 16
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOT_TIME
+#define WHEEL_SLOT_TIME IP64_ADDRMAP_CONF_WHEEL_SLOT_TIME
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOT_TIME */
+#define WHEEL_SLOT_TIME (CLOCK_SECOND * 32)
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOT_TIME */
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
-LIST(entrylist);
+
+/* All entries, doubly linked so that an entry can be removed without
+   walking the list. */
+static struct ip64_addrmap_entry *entrylist;
+
+static struct ip64_addrmap_entry *flow_hash[HASH_SIZE];
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static uint8_t wheel_slot;
+static clock_time_t wheel_time;
 
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
 
-#define printf(...)
-
 /*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_list(void)
 {
-  return list_head(entrylist);
+  return entrylist;
 }
 /*---------------------------------------------------------------------------*/
 void
 ip64_addrmap_init(void)
 {
   memb_init(&entrymemb);
-  list_init(entrylist);
+  entrylist = NULL;
+  memset(flow_hash, 0, sizeof(flow_hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_slot = 0;
+  wheel_time = clock_time();
   mapped_port = FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+static unsigned
+flow_hash_index(const uip_ip6addr_t *ip6addr, uint16_t ip6port,
+                const uip_ip4addr_t *ip4addr, uint16_t ip4port,
+                uint8_t protocol)
+{
+  uint16_t h;
+
+  /* The interface identifier and the ports are what differs between
+     the flows from the IPv6 network. */
+  h = ip6addr->u16[6] ^ ip6addr->u16[7] ^
+    ip4addr->u16[0] ^ ip4addr->u16[1] ^
+    ip6port ^ (ip4port << 3) ^ protocol;
+  h ^= h >> 8;
+  return (h ^ (h >> 4)) & (HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+port_hash_index(uint16_t port)
+{
+  return (port ^ (port >> 8)) & (HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+chain_remove(struct ip64_addrmap_entry **chain, struct ip64_addrmap_entry *e,
+             size_t offset)
+{
+  struct ip64_addrmap_entry **pp;
+
+  /* The chains are linked through different fields of the entry;
+     offset tells which one. */
+  for(pp = chain; *pp != NULL;
+      pp = (struct ip64_addrmap_entry **)((char *)*pp + offset)) {
+    if(*pp == e) {
+      *pp = *(struct ip64_addrmap_entry **)((char *)e + offset);
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct ip64_addrmap_entry *e)
+{
+  clock_time_t expires;
+  unsigned slots;
+
+  /* Count the slots from the one that is checked next. Entries that
+     expire beyond the end of the wheel go into its last slot and are
+     put back further on once that slot has been reached. */
+  expires = clock_time() - wheel_time + timer_remaining(&e->timer);
+  slots = expires / WHEEL_SLOT_TIME;
+  if(slots >= WHEEL_SLOTS) {
+    slots = WHEEL_SLOTS - 1;
+  }
+  slots = (wheel_slot + slots) % WHEEL_SLOTS;
+  e->wheel_next = wheel[slots];
+  wheel[slots] = e;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(struct ip64_addrmap_entry *e)
+{
+  PRINTF("ip64-addrmap: removing mapped port %u\n", e->mapped_port);
+  chain_remove(&flow_hash[flow_hash_index(&e->ip6addr, e->ip6port,
+                                          &e->ip4addr, e->ip4port,
+                                          e->protocol)],
+               e, offsetof(struct ip64_addrmap_entry, flow_next));
+  chain_remove(&port_hash[port_hash_index(e->mapped_port)],
+               e, offsetof(struct ip64_addrmap_entry, port_next));
+  if(e->prev != NULL) {
+    e->prev->next = e->next;
+  } else {
+    entrylist = e->next;
+  }
+  if(e->next != NULL) {
+    e->next->prev = e->prev;
+  }
+  memb_free(&entrymemb, e);
+}
+/*---------------------------------------------------------------------------*/
 static void
 check_age(void)
 {
-  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry *m, *next;
+  clock_time_t now;
+  int slots;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
-    if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
-    } else {
-      m = list_item_next(m);
+  /* Only the slots that have been passed since the last check can
+     hold expired entries. Entries that are found there but have had
+     their lifetime extended in the meantime are moved to the slot
+     that matches their new expiration time. */
+  now = clock_time();
+  for(slots = 0;
+      slots < WHEEL_SLOTS && now - wheel_time >= WHEEL_SLOT_TIME;
+      slots++) {
+    m = wheel[wheel_slot];
+    wheel[wheel_slot] = NULL;
+    wheel_slot = (wheel_slot + 1) % WHEEL_SLOTS;
+    wheel_time += WHEEL_SLOT_TIME;
+    for(; m != NULL; m = next) {
+      next = m->wheel_next;
+      if(timer_expired(&m->timer)) {
+        remove_entry(m);
+      } else {
+        wheel_add(m);
+      }
     }
   }
+  if(now - wheel_time >= WHEEL_SLOT_TIME) {
+    /* We have not been called for a full turn of the wheel, so every
+       slot has been looked at once. */
+    wheel_time = now;
+  }
 }
 /*---------------------------------------------------------------------------*/
 static int
 recycle(void)
 {
   /* Find the oldest recyclable mapping and remove it. */
-  struct ip64_addrmap_entry *m, *oldest;
-
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-
-  oldest = NULL;
-  for(m = list_head(entrylist);
-      m != NULL;
-      m = list_item_next(m)) {
-    if(m->flags & FLAGS_RECYCLABLE) {
-      if(oldest == NULL) {
-        oldest = m;
-      } else {
-        if(timer_remaining(&m->timer) <
-           timer_remaining(&oldest->timer)) {
-          oldest = m;
+  struct ip64_addrmap_entry **mp, *m;
+  int i, pass;
+
+  /* Entries that have expired before their slot has been reached are
+     reclaimed first. The wheel keeps the entries roughly sorted by
+     expiration time, so the first recyclable entry found from the
+     current slot and onwards is one of the oldest ones. */
+  for(pass = 0; pass < 2; pass++) {
+    for(i = 0; i < WHEEL_SLOTS; i++) {
+      for(mp = &wheel[(wheel_slot + i) % WHEEL_SLOTS];
+          *mp != NULL;
+          mp = &(*mp)->wheel_next) {
+        m = *mp;
+        if(pass == 0 ? timer_expired(&m->timer) :
+           (m->flags & FLAGS_RECYCLABLE) != 0) {
+          *mp = m->wheel_next;
+          remove_entry(m);
+          return 1;
         }
       }
     }
   }
 
-  /* If we found an oldest recyclable entry, remove it and return
-     non-zero. */
-  if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
-    return 1;
-  }
-
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -134,21 +266,21 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
 {
   struct ip64_addrmap_entry *m;
 
-  printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
-	 uip_htons(ip6port));
+  PRINTF("lookup ip4port %d ip6port %d\n", ip4port, ip6port);
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
-	   m->protocol, protocol,
-	   m->ip4port, ip4port,
-	   m->ip6port, ip6port,
-	   uip_ip4addr_cmp(&m->ip4addr, ip4addr),
-	   uip_ip6addr_cmp(&m->ip6addr, ip6addr));
+  for(m = flow_hash[flow_hash_index(ip6addr, ip6port,
+                                    ip4addr, ip4port, protocol)];
+      m != NULL; m = m->flow_next) {
     if(m->protocol == protocol &&
        m->ip4port == ip4port &&
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
        uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+      if(timer_expired(&m->timer)) {
+        /* Expired, but its slot of the timer wheel has not been
+           reached yet. A new mapping will be put in front of it. */
+        return NULL;
+      }
       m->ip6to4++;
       return m;
     }
@@ -162,12 +294,16 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
-    printf("mapped port %d %d, protocol %d %d\n",
+  for(m = port_hash[port_hash_index(mapped_port)];
+      m != NULL; m = m->port_next) {
+    PRINTF("mapped port %d %d, protocol %d %d\n",
 	   m->mapped_port, mapped_port,
 	   m->protocol, protocol);
     if(m->mapped_port == mapped_port &&
        m->protocol == protocol) {
+      if(timer_expired(&m->timer)) {
+        return NULL;
+      }
       m->ip4to6++;
       return m;
     }
@@ -182,6 +318,19 @@ increase_mapped_port(void)
     FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+static int
+mapped_port_in_use(uint16_t port)
+{
+  struct ip64_addrmap_entry *n;
+
+  for(n = port_hash[port_hash_index(port)]; n != NULL; n = n->port_next) {
+    if(n->mapped_port == port) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint16_t ip6port,
@@ -190,6 +339,7 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  unsigned h;
 
   check_age();
   m = memb_alloc(&entrymemb);
@@ -214,22 +364,26 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     /* Pick a new, unused local port. First make sure that the
        mapped_port number does not belong to any active connection. If
        so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    while(mapped_port_in_use(mapped_port)) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
-    list_add(entrylist, m);
+    h = flow_hash_index(ip6addr, ip6port, ip4addr, ip4port, protocol);
+    m->flow_next = flow_hash[h];
+    flow_hash[h] = m;
+    h = port_hash_index(m->mapped_port);
+    m->port_next = port_hash[h];
+    port_hash[h] = m;
+    wheel_add(m);
+
+    m->prev = NULL;
+    m->next = entrylist;
+    if(entrylist != NULL) {
+      entrylist->prev = m;
+    }
+    entrylist = m;
     return m;
   }
   return NULL;
@@ -240,6 +394,8 @@ ip64_addrmap_set_lifetime(struct ip64_addrmap_entry *e,
                           clock_time_t time)
 {
   if(e != NULL) {
+    /* The entry stays in its slot of the timer wheel; check_age()
+       moves it when the slot is reached. */
     timer_set(&e->timer, time);
   }
 }
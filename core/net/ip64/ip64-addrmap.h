@@ -37,7 +37,8 @@
 #include "net/ip/uip.h"
 
 struct ip64_addrmap_entry {
-  struct ip64_addrmap_entry *next;
+  struct ip64_addrmap_entry *next, *prev;
+  struct ip64_addrmap_entry *flow_next, *port_next, *wheel_next;
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
@@ -131,11 +131,14 @@ output(void)
   if(uip_ipaddr_cmp(&last_sender, &UIP_IP_BUF->srcipaddr)) {
     PRINTF("ip64-interface: output, not sending bounced message\n");
   } else {
+    /* Translate in place and move the IPv4 packet to the start of
+       the buffer, which saves copying it through ip64_packet_buffer. */
     len = ip64_6to4(&uip_buf[UIP_LLH_LEN], uip_len,
-		    ip64_packet_buffer);
+		    &uip_buf[UIP_LLH_LEN + IP64_6TO4_OFFSET]);
     PRINTF("ip64-interface: output len %d\n", len);
     if(len > 0) {
-      memcpy(&uip_buf[UIP_LLH_LEN], ip64_packet_buffer, len);
+      memmove(&uip_buf[UIP_LLH_LEN], &uip_buf[UIP_LLH_LEN + IP64_6TO4_OFFSET],
+              len);
       uip_len = len;
       slip_send();
       return len;
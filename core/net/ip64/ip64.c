@@ -187,6 +187,7 @@ ip64_init(void)
   ip64_hostaddr_configured = 0;
 
   PRINTF("ip64_init\n");
+  ip64_addrmap_init();
   IP64_ETH_DRIVER.init();
 #if IP64_DHCP
   ip64_ipv4_dhcp_init();
@@ -300,6 +301,27 @@ chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
+chksum_update(uint16_t chksum_field, uint16_t oldsum, uint16_t newsum)
+{
+  uint16_t sum, t;
+
+  /* Update a checksum field, in network byte order, when data that
+     sums to oldsum has been replaced with data that sums to newsum
+     (RFC 1624, eqn. 3): HC' = ~(~HC + ~m + m'). */
+  sum = ~uip_ntohs(chksum_field);
+  t = ~oldsum;
+  sum += t;
+  if(sum < t) {
+    sum++;		/* carry */
+  }
+  sum += newsum;
+  if(sum < newsum) {
+    sum++;		/* carry */
+  }
+  return uip_htons(~sum);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
 ipv4_checksum(struct ipv4_hdr *hdr)
 {
   uint16_t sum;
@@ -370,9 +392,17 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv6len, ipv4len;
   struct ip64_addrmap_entry *m;
-
-  v6hdr = (struct ipv6_hdr *)ipv6packet;
+  struct ipv6_hdr v6copy;
+  uint8_t oldtransport[4];
+  uint16_t oldsum, newsum;
+  uint8_t rewritten;
+
+  /* The IPv4 header may be written on top of the IPv6 header when the
+     packet is translated in place, so we work on a copy of it. */
+  memcpy(&v6copy, ipv6packet, IPV6_HDRLEN);
+  v6hdr = &v6copy;
   v4hdr = (struct ipv4_hdr *)resultpacket;
+  rewritten = 0;
 
   if((v6hdr->len[0] << 8) + v6hdr->len[1] <= ipv6packet_len) {
     ipv6len = (v6hdr->len[0] << 8) + v6hdr->len[1] + IPV6_HDRLEN;
@@ -382,16 +412,24 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   }
 
   /* We copy the data from the IPv6 packet into the IPv4 packet. We do
-     not modify the data in any way. */
-  memcpy(&resultpacket[IPV4_HDRLEN],
-	 &ipv6packet[IPV6_HDRLEN],
-	 ipv6len - IPV6_HDRLEN);
+     not modify the data in any way. When translating in place, the
+     data already is where it should be. */
+  if(&resultpacket[IPV4_HDRLEN] != &ipv6packet[IPV6_HDRLEN]) {
+    memcpy(&resultpacket[IPV4_HDRLEN],
+           &ipv6packet[IPV6_HDRLEN],
+           ipv6len - IPV6_HDRLEN);
+  }
 
   udphdr = (struct udp_hdr *)&resultpacket[IPV4_HDRLEN];
   tcphdr = (struct tcp_hdr *)&resultpacket[IPV4_HDRLEN];
   icmpv4hdr = (struct icmpv4_hdr *)&resultpacket[IPV4_HDRLEN];
   icmpv6hdr = (struct icmpv6_hdr *)&ipv6packet[IPV6_HDRLEN];
 
+  /* Remember the part of the transport layer header that we may
+     change, the port numbers or the ICMP type and code, so that we can
+     update the checksum afterwards. */
+  memcpy(oldtransport, &resultpacket[IPV4_HDRLEN], sizeof(oldtransport));
+
   /* Translate the IPv6 header into an IPv4 header. */
 
   /* First the basics: the IPv4 version, header length, type of
@@ -424,15 +462,6 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   case IP_PROTO_TCP:
     PRINTF("ip64_6to4: TCP header\n");
     v4hdr->proto = IP_PROTO_TCP;
-
-    /* Compute and check the TCP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_TCP) != 0xffff) {
-      PRINTF("Bad TCP checksum, dropping packet\n");
-    }
-
     break;
 
   case IP_PROTO_UDP:
@@ -442,17 +471,11 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
     /* Check if this is a DNS request. If so, we should rewrite it
        with the DNS64 module. */
     if(udphdr->destport == UIP_HTONS(DNS_PORT)) {
-      ip64_dns64_6to4((uint8_t *)v6hdr + IPV6_HDRLEN + sizeof(struct udp_hdr),
+      ip64_dns64_6to4(ipv6packet + IPV6_HDRLEN + sizeof(struct udp_hdr),
                       ipv6len - IPV6_HDRLEN - sizeof(struct udp_hdr),
                       (uint8_t *)udphdr + sizeof(struct udp_hdr),
                       BUFSIZE - IPV4_HDRLEN - sizeof(struct udp_hdr));
-    }
-    /* Compute and check the UDP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_UDP) != 0xffff) {
-      PRINTF("Bad UDP checksum, dropping packet\n");
+      rewritten = 1;
     }
     break;
 
@@ -614,27 +637,49 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 
 
 
+  /* Unless the DNS64 module has rewritten the data, only the pseudo
+     header and the first word or two of the transport layer header
+     have changed. The checksum is updated from the difference, which
+     also means that a packet that arrived with a bad checksum still
+     has a bad checksum when it leaves. The length and protocol fields
+     of the IPv4 and IPv6 pseudo headers are the same, but ICMPv4 does
+     not use a pseudo header at all. */
+  if(v4hdr->proto == IP_PROTO_ICMPV4) {
+    oldsum = chksum(ipv6len - IPV6_HDRLEN + IP_PROTO_ICMPV6,
+                    (uint8_t *)&v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t));
+    oldsum = chksum(oldsum, oldtransport, 2);
+    newsum = chksum(0, (uint8_t *)icmpv4hdr, 2);
+  } else {
+    oldsum = chksum(0, (uint8_t *)&v6hdr->srcipaddr,
+                    2 * sizeof(uip_ip6addr_t));
+    oldsum = chksum(oldsum, oldtransport, 4);
+    newsum = chksum(0, (uint8_t *)&v4hdr->srcipaddr,
+                    2 * sizeof(uip_ip4addr_t));
+    newsum = chksum(newsum, (uint8_t *)udphdr, 4);
+  }
+
   /* The checksum is in different places in the different protocol
      headers, so we need to be sure that we update the correct
      field. */
   switch(v4hdr->proto) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum = chksum_update(tcphdr->tcpchksum, oldsum, newsum);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_UDP));
+    if(rewritten) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum = chksum_update(udphdr->udpchksum, oldsum, newsum);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
     break;
   case IP_PROTO_ICMPV4:
-    icmpv4hdr->icmpchksum = 0;
-    icmpv4hdr->icmpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						      IP_PROTO_ICMPV4));
+    icmpv4hdr->icmpchksum = chksum_update(icmpv4hdr->icmpchksum,
+                                          oldsum, newsum);
     break;
 
   default:
@@ -659,9 +704,12 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
   struct icmpv6_hdr *icmpv6hdr;
   uint16_t ipv4len, ipv6len, ipv6_packet_len;
   struct ip64_addrmap_entry *m;
+  uint16_t oldsum, newsum;
+  uint8_t rewritten;
 
   v6hdr = (struct ipv6_hdr *)resultpacket;
   v4hdr = (struct ipv4_hdr *)ipv4packet;
+  rewritten = 0;
 
   if((v4hdr->len[0] << 8) + v4hdr->len[1] <= ipv4packet_len) {
     ipv4len = (v4hdr->len[0] << 8) + v4hdr->len[1];
@@ -741,7 +789,12 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
       v6hdr->len[0] = ipv6_packet_len >> 8;
       v6hdr->len[1] = ipv6_packet_len & 0xff;
       ipv6len = ipv6_packet_len + IPV6_HDRLEN;
-
+      rewritten = 1;
+    }
+    /* A zero UDP checksum means that the sender did not compute one,
+       but IPv6 requires it. */
+    if(udphdr->udpchksum == 0) {
+      rewritten = 1;
     }
     break;
 
@@ -849,31 +902,48 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
     }
   }
 
+  /* As in ip64_6to4(), the checksum is updated from the parts of the
+     pseudo header and the transport layer header that have changed,
+     unless the data has been rewritten. The transport layer header of
+     the IPv4 packet is left untouched. */
+  if(v6hdr->nxthdr == IP_PROTO_ICMPV6) {
+    oldsum = chksum(0, (uint8_t *)icmpv4hdr, 2);
+    newsum = chksum(ipv6_packet_len + IP_PROTO_ICMPV6,
+                    (uint8_t *)&v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t));
+    newsum = chksum(newsum, (uint8_t *)icmpv6hdr, 2);
+  } else {
+    oldsum = chksum(0, (uint8_t *)&v4hdr->srcipaddr,
+                    2 * sizeof(uip_ip4addr_t));
+    oldsum = chksum(oldsum, &ipv4packet[IPV4_HDRLEN], 4);
+    newsum = chksum(0, (uint8_t *)&v6hdr->srcipaddr,
+                    2 * sizeof(uip_ip6addr_t));
+    newsum = chksum(newsum, (uint8_t *)udphdr, 4);
+  }
+
   /* The checksum is in different places in the different protocol
      headers, so we need to be sure that we update the correct
      field. */
   switch(v6hdr->nxthdr) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum = chksum_update(tcphdr->tcpchksum, oldsum, newsum);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_UDP));
+    if(rewritten) {
+      udphdr->udpchksum = 0;
+      udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
+                                                    ipv6len,
+                                                    IP_PROTO_UDP));
+    } else {
+      udphdr->udpchksum = chksum_update(udphdr->udpchksum, oldsum, newsum);
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
     break;
 
   case IP_PROTO_ICMPV6:
-    icmpv6hdr->icmpchksum = 0;
-    icmpv6hdr->icmpchksum = ~(ipv6_transport_checksum(resultpacket,
-                                                ipv6len,
-                                                IP_PROTO_ICMPV6));
+    icmpv6hdr->icmpchksum = chksum_update(icmpv6hdr->icmpchksum,
+                                          oldsum, newsum);
     break;
   default:
     PRINTF("ip64_4to6: transport protocol %d not implemented\n", v4hdr->proto);
@@ -35,6 +35,12 @@
 #include "net/ip/uip.h"
 
 void ip64_init(void);
+
+/* ip64_6to4() translates a packet in place if resultpacket points
+   IP64_6TO4_OFFSET bytes into ipv6packet: the IPv4 header then ends
+   where the IPv6 header ended, and the payload is not moved. */
+#define IP64_6TO4_OFFSET (40 - 20)
+
 int ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6len,
               uint8_t *resultpacket);
 int ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4len,
@@ -77,6 +83,14 @@ extern uint16_t ip64_packet_buffer_maxlen;
 #define IP64_UIP_FALLBACK_INTERFACE IP64_CONF_UIP_FALLBACK_INTERFACE
 #endif /* IP64_CONF_UIP_FALLBACK_INTERFACE */
 
+/* The maximum number of packets that a driver hands to IP64_INPUT
+   each time it is polled. */
+#ifdef IP64_CONF_INPUT_BATCH
+#define IP64_INPUT_BATCH IP64_CONF_INPUT_BATCH
+#else /* IP64_CONF_INPUT_BATCH */
+#define IP64_INPUT_BATCH 4
+#endif /* IP64_CONF_INPUT_BATCH */
+
 #ifdef IP64_CONF_DHCP
 #define IP64_DHCP IP64_CONF_DHCP
 #else /* IP64_CONF_DHCP */
@@ -171,6 +171,7 @@ static uint16_t lastport;       /* Keeps track of the last port used for
 
 /* Temporary variables. */
 uint8_t uip_acc32[4];
+uint16_t uip_acklen;
 static uint8_t c, opt;
 static uint16_t tmp16;
 
@@ -444,6 +445,11 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->initialmss = conn->mss = UIP_TCP_MSS;
 
   conn->len = 1;   /* TCP length of the SYN is one. */
+#if UIP_TCP_SEND_WINDOW > 1
+  conn->snd_window = 0;
+  conn->dupacks = 0;
+  conn->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   conn->nrtx = 0;
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
@@ -671,6 +677,9 @@ void
 uip_process(uint8_t flag)
 {
   register struct uip_conn *uip_connr = uip_conn;
+#if UIP_TCP_SEND_WINDOW > 1
+  uint16_t seqoff = 0; /* Offset from snd_nxt of the segment to send. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
@@ -684,7 +693,8 @@ uip_process(uint8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       (!uip_outstanding(uip_connr) ||
+        uip_conn_sendwnd(uip_connr) > 0)) {
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -794,6 +804,15 @@ uip_process(uint8_t flag)
 	    goto tcp_send_finack;
 
 	  }
+#if UIP_TCP_SEND_WINDOW > 1
+	} else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+		  uip_conn_sendwnd(uip_connr) > 0) {
+	  /* A windowed connection may send more while data is
+	     in flight. */
+	  uip_flags = UIP_POLL;
+	  UIP_APPCALL();
+	  goto appsend;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 	}
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
 	/* If there was no need for a retransmission, we poll the
@@ -1370,6 +1389,11 @@ uip_process(uint8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_connr->snd_window = 0;
+  uip_connr->dupacks = 0;
+  uip_connr->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[0] = BUF->seqno[0];
@@ -1479,7 +1503,49 @@ uip_process(uint8_t flag)
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
-    uip_add32(uip_connr->snd_nxt, uip_connr->len);
+#if UIP_TCP_SEND_WINDOW > 1
+    if(uip_connr->snd_window > 1) {
+      /* On a windowed connection the ACK may cover any part of the
+	 data in flight. Duplicate ACKs indicate a lost segment, which
+	 is retransmitted after three of them (fast retransmit). */
+      uint32_t acked =
+	(((uint32_t)BUF->ackno[0] << 24) | ((uint32_t)BUF->ackno[1] << 16) |
+	 ((uint32_t)BUF->ackno[2] << 8) | BUF->ackno[3]) -
+	(((uint32_t)uip_connr->snd_nxt[0] << 24) |
+	 ((uint32_t)uip_connr->snd_nxt[1] << 16) |
+	 ((uint32_t)uip_connr->snd_nxt[2] << 8) | uip_connr->snd_nxt[3]);
+
+      if(acked == 0 && uip_len == 0 &&
+	 (BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+	 (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+	 uip_connr->dupacks < 3 && ++uip_connr->dupacks == 3) {
+	/* Ask the application for the oldest segment in flight and
+	   send it right away. The counter stays at 3 until new data
+	   is acknowledged, so a loss is retransmitted only once. */
+	UIP_STAT(++uip_stat.tcp.rexmit);
+	uip_slen = 0;
+	uip_flags = UIP_REXMIT;
+	UIP_APPCALL();
+	uip_appdata = uip_sappdata;
+	if(uip_slen > uip_connr->len) {
+	  uip_slen = uip_connr->len;
+	}
+	if(uip_slen > uip_connr->mss) {
+	  uip_slen = uip_connr->mss;
+	}
+	if(uip_slen == 0) {
+	  goto drop;
+	}
+	uip_len = uip_slen + UIP_TCPIP_HLEN;
+	BUF->flags = TCP_ACK | TCP_PSH;
+	goto tcp_send_noopts;
+      }
+      uip_acklen = acked > 0 && acked <= uip_connr->len ?
+	(uint16_t)acked : uip_connr->len;
+    } else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+    uip_acklen = uip_connr->len;
+    uip_add32(uip_connr->snd_nxt, uip_acklen);
 
     if(BUF->ackno[0] == uip_acc32[0] &&
        BUF->ackno[1] == uip_acc32[1] &&
@@ -1512,7 +1578,10 @@ uip_process(uint8_t flag)
       uip_connr->timer = uip_connr->rto;
 
       /* Reset length of outstanding data. */
-      uip_connr->len = 0;
+      uip_connr->len -= uip_acklen;
+#if UIP_TCP_SEND_WINDOW > 1
+      uip_connr->dupacks = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     }
 
   }
@@ -1686,6 +1755,17 @@ uip_process(uint8_t flag)
       tmp16 = uip_connr->initialmss;
     }
     uip_connr->mss = tmp16;
+#if UIP_TCP_SEND_WINDOW > 1
+    /* A windowed connection may fill what the peer advertises, up to
+       the number of segments it has asked for. */
+    if(((uint16_t)BUF->wnd[0] << 8) + (uint16_t)BUF->wnd[1] != 0) {
+      tmp16 = ((uint16_t)BUF->wnd[0] << 8) + (uint16_t)BUF->wnd[1];
+    }
+    if((uint32_t)tmp16 > (uint32_t)uip_connr->snd_window * uip_connr->initialmss) {
+      tmp16 = uip_connr->snd_window * uip_connr->initialmss;
+    }
+    uip_connr->snd_wnd = tmp16;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
     /* If this packet constitutes an ACK for outstanding data (flagged
        by the UIP_ACKDATA flag, we should call the application since it
@@ -1727,6 +1807,21 @@ uip_process(uint8_t flag)
 
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
+#if UIP_TCP_SEND_WINDOW > 1
+	if(uip_connr->snd_window > 1) {
+	  /* New data goes behind the data in flight, as far as the
+	     window allows. */
+	  tmp16 = uip_conn_sendwnd(uip_connr);
+	  if(uip_slen > uip_connr->mss) {
+	    uip_slen = uip_connr->mss;
+	  }
+	  if(uip_slen > tmp16) {
+	    uip_slen = tmp16;
+	  }
+	  seqoff = uip_connr->len;
+	  uip_connr->len += uip_slen;
+	} else {
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
 	/* If the connection has acknowledged data, the contents of
 	   the ->len variable should be discarded. */
@@ -1756,15 +1851,35 @@ uip_process(uint8_t flag)
 	     retransmit) out more than it previously sent out. */
 	  uip_slen = uip_connr->len;
 	}
+#if UIP_TCP_SEND_WINDOW > 1
+	}
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       }
       uip_connr->nrtx = 0;
     apprexmit:
       uip_appdata = uip_sappdata;
+#if UIP_TCP_SEND_WINDOW > 1
+      /* Only the oldest segment in flight is retransmitted. */
+      if(uip_connr->snd_window > 1 && (uip_flags & UIP_REXMIT)) {
+	if(uip_slen > uip_connr->len) {
+	  uip_slen = uip_connr->len;
+	}
+	if(uip_slen > uip_connr->mss) {
+	  uip_slen = uip_connr->mss;
+	}
+      }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
       /* If the application has data to be sent, or if the incoming
          packet had new data in it, we must send out a packet. */
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
+#if UIP_TCP_SEND_WINDOW > 1
+	/* A windowed connection sends just this segment. */
+	if(uip_connr->snd_window > 1) {
+	  uip_len = uip_slen + UIP_TCPIP_HLEN;
+	} else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
@@ -1776,6 +1891,11 @@ uip_process(uint8_t flag)
       if(uip_flags & UIP_NEWDATA) {
 	uip_len = UIP_TCPIP_HLEN;
 	BUF->flags = TCP_ACK;
+#if UIP_TCP_SEND_WINDOW > 1
+	if(uip_connr->snd_window > 1) {
+	  seqoff = uip_connr->len;
+	}
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 	goto tcp_send_noopts;
       }
     }
@@ -1851,6 +1971,11 @@ uip_process(uint8_t flag)
      to set the appropriate TCP sequence numbers in the TCP header. */
  tcp_send_ack:
   BUF->flags = TCP_ACK;
+#if UIP_TCP_SEND_WINDOW > 1
+  if(uip_connr->snd_window > 1) {
+    seqoff = uip_connr->len;
+  }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
  tcp_send_nodata:
   uip_len = UIP_IPTCPH_LEN;
@@ -1868,10 +1993,18 @@ uip_process(uint8_t flag)
   BUF->ackno[2] = uip_connr->rcv_nxt[2];
   BUF->ackno[3] = uip_connr->rcv_nxt[3];
 
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_add32(uip_connr->snd_nxt, seqoff);
+  BUF->seqno[0] = uip_acc32[0];
+  BUF->seqno[1] = uip_acc32[1];
+  BUF->seqno[2] = uip_acc32[2];
+  BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   BUF->seqno[0] = uip_connr->snd_nxt[0];
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   BUF->srcport  = uip_connr->lport;
   BUF->destport = uip_connr->rport;
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup bmf-multicast
+ * @{
+ */
+/**
+ * \file
+ *    This file implements 'Bloom-filter Multicast Forwarding' (BMF)
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/ipv6/multicast/uip-mcast6-route.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
+#include "net/ipv6/multicast/bmf.h"
+#include "net/rpl/rpl.h"
+#include "net/netstack.h"
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/* BMF can only be built alongside the per-child filters it relies on */
+#if UIP_MCAST6_ROUTE_FILTERS
+
+/*---------------------------------------------------------------------------*/
+/* Macros */
+/*---------------------------------------------------------------------------*/
+/* CCI */
+#define BMF_FWD_DELAY()  NETSTACK_RDC.channel_check_interval()
+/* Number of slots in the next 500ms */
+#define BMF_INTERVAL_COUNT  ((CLOCK_SECOND >> 2) / fwd_delay)
+/*---------------------------------------------------------------------------*/
+/* Maintain Stats */
+#if UIP_MCAST6_STATS
+static struct bmf_stats stats;
+
+#define BMF_STATS_ADD(x) stats.x++
+#define BMF_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
+#else /* UIP_MCAST6_STATS */
+#define BMF_STATS_ADD(x)
+#define BMF_STATS_INIT()
+#endif
+/*---------------------------------------------------------------------------*/
+/* Internal Data */
+/*---------------------------------------------------------------------------*/
+static struct ctimer mcast_periodic;
+static uint8_t mcast_len;
+static uip_buf_t mcast_buf;
+static uint8_t fwd_delay;
+static uint8_t fwd_spread;
+
+/* The children the buffered datagram goes to. If none, it is broadcast */
+static uip_lladdr_t mcast_dest[BMF_MAX_UNICAST];
+static uint8_t mcast_dest_count;
+/*---------------------------------------------------------------------------*/
+/* uIPv6 Pointers */
+/*---------------------------------------------------------------------------*/
+#define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+/*---------------------------------------------------------------------------*/
+/*
+ * Look up the children with listeners for the destination of the datagram in
+ * uip_buf and store the ones to unicast to in dest. *dest_count is left 0 if
+ * the datagram is to be broadcast. Returns the number of children found
+ */
+static uint8_t
+select_children(uip_lladdr_t *dest, uint8_t *dest_count)
+{
+  uip_mcast6_filter_t *f;
+  uint8_t count;
+
+  count = 0;
+  for(f = uip_mcast6_filter_list_head(); f != NULL; f = list_item_next(f)) {
+    if(uip_mcast6_filter_match(f, &UIP_IP_BUF->destipaddr)) {
+      if(count < BMF_MAX_UNICAST) {
+        memcpy(&dest[count], &f->lladdr, sizeof(uip_lladdr_t));
+      }
+      count++;
+    }
+  }
+
+  *dest_count = count > BMF_MAX_UNICAST ? 0 : count;
+
+  PRINTF("BMF: %u children listen, %s\n", count,
+         *dest_count ? "unicast" : "broadcast");
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_to_children(const uip_lladdr_t *dest, uint8_t dest_count)
+{
+  uint8_t i;
+
+  if(dest_count == 0) {
+    BMF_STATS_ADD(fwd_broadcast);
+    tcpip_output(NULL);
+    return;
+  }
+
+  for(i = 0; i < dest_count; i++) {
+    BMF_STATS_ADD(fwd_unicast);
+    tcpip_output(&dest[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+mcast_fwd(void *p)
+{
+  memcpy(uip_buf, &mcast_buf, mcast_len);
+  uip_len = mcast_len;
+  UIP_IP_BUF->ttl--;
+  send_to_children(mcast_dest, mcast_dest_count);
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+in()
+{
+  rpl_dag_t *d;                 /* Our DODAG */
+  uip_ipaddr_t *parent_ipaddr;  /* Our pref. parent's IPv6 address */
+  const uip_lladdr_t *parent_lladdr;  /* Our pref. parent's LL address */
+  uip_lladdr_t dest[BMF_MAX_UNICAST]; /* Children to unicast to */
+  uint8_t dest_count;
+
+  /*
+   * Fetch a pointer to the LL address of our preferred parent
+   *
+   * As in SMRF, we should read the instance ID from the RPL HBHO and use
+   * the correct parent accordingly
+   */
+  d = rpl_get_any_dag();
+  if(!d) {
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+  /* Retrieve our preferred parent's LL address */
+  parent_ipaddr = rpl_get_parent_ipaddr(d->preferred_parent);
+  parent_lladdr = uip_ds6_nbr_lladdr_from_ipaddr(parent_ipaddr);
+
+  if(parent_lladdr == NULL) {
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+  /*
+   * We accept a datagram if it arrived from our preferred parent, discard
+   * otherwise. Our parent may have sent it to us alone, or to all children
+   */
+  if(memcmp(parent_lladdr, packetbuf_addr(PACKETBUF_ADDR_SENDER),
+            UIP_LLADDR_LEN)) {
+    PRINTF("BMF: Routable in but BMF ignored it\n");
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+  if(UIP_IP_BUF->ttl <= 1) {
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+  UIP_MCAST6_STATS_ADD(mcast_in_all);
+  UIP_MCAST6_STATS_ADD(mcast_in_unique);
+
+  /* Forward only if the filter of one of our children matches the group */
+  if(select_children(dest, &dest_count) == 0) {
+    PRINTF("BMF: No listeners below us\n");
+    BMF_STATS_ADD(fwd_suppressed);
+  } else {
+    /* If we enter here, we will definitely forward */
+    UIP_MCAST6_STATS_ADD(mcast_fwd);
+
+    /*
+     * Add a delay (D) of at least BMF_FWD_DELAY() to compensate for how
+     * contikimac handles broadcasts. We can't start our TX before the sender
+     * has finished its own.
+     */
+    fwd_delay = BMF_FWD_DELAY();
+
+    /* Finalise D: D = min(BMF_FWD_DELAY(), BMF_MIN_FWD_DELAY) */
+#if BMF_MIN_FWD_DELAY
+    if(fwd_delay < BMF_MIN_FWD_DELAY) {
+      fwd_delay = BMF_MIN_FWD_DELAY;
+    }
+#endif
+
+    if(fwd_delay == 0) {
+      /* No delay required, send it, do it now, why wait? */
+      UIP_IP_BUF->ttl--;
+      send_to_children(dest, dest_count);
+      UIP_IP_BUF->ttl++;        /* Restore before potential upstack delivery */
+    } else {
+      /* Randomise final delay in [D , D*Spread], step D */
+      fwd_spread = BMF_INTERVAL_COUNT;
+      if(fwd_spread > BMF_MAX_SPREAD) {
+        fwd_spread = BMF_MAX_SPREAD;
+      }
+      if(fwd_spread) {
+        fwd_delay = fwd_delay * (1 + ((random_rand() >> 11) % fwd_spread));
+      }
+
+      memcpy(&mcast_buf, uip_buf, uip_len);
+      mcast_len = uip_len;
+      memcpy(mcast_dest, dest, dest_count * sizeof(uip_lladdr_t));
+      mcast_dest_count = dest_count;
+      ctimer_set(&mcast_periodic, fwd_delay, mcast_fwd, NULL);
+    }
+    PRINTF("BMF: %u bytes: fwd in %u [%u]\n",
+           uip_len, fwd_delay, fwd_spread);
+  }
+
+  /* Done with this packet unless we are a member of the mcast group */
+  if(!uip_ds6_is_my_maddr(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("BMF: Not a group member. No further processing\n");
+    return UIP_MCAST6_DROP;
+  } else {
+    PRINTF("BMF: Ours. Deliver to upper layers\n");
+    UIP_MCAST6_STATS_ADD(mcast_in_ours);
+    return UIP_MCAST6_ACCEPT;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init()
+{
+  BMF_STATS_INIT();
+  UIP_MCAST6_STATS_INIT(&stats);
+
+  uip_mcast6_route_init();
+}
+/*---------------------------------------------------------------------------*/
+static void
+out()
+{
+  uip_lladdr_t dest[BMF_MAX_UNICAST];
+  uint8_t dest_count;
+
+  /*
+   * We are the seed. Only our children's filters tell us who can receive
+   * this datagram, so there is no point sending it if none matches
+   */
+  if(select_children(dest, &dest_count) == 0) {
+    PRINTF("BMF: Multicast Out, no listeners below us\n");
+    BMF_STATS_ADD(fwd_suppressed);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    uip_clear_buf();
+    return;
+  }
+
+  UIP_MCAST6_STATS_ADD(mcast_out);
+
+  if(dest_count == 0) {
+    /* Let the core broadcast it */
+    BMF_STATS_ADD(fwd_broadcast);
+    return;
+  }
+
+  /* Send it to each child ourselves and stop the core from sending it too */
+  send_to_children(dest, dest_count);
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief The BMF engine driver
+ */
+const struct uip_mcast6_driver bmf_driver = {
+  "BMF",
+  init,
+  out,
+  in,
+};
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_MCAST6_ROUTE_FILTERS */
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup uip6-multicast
+ * @{
+ */
+/**
+ * \defgroup bmf-multicast 'Bloom-filter Multicast Forwarding' (BMF)
+ *
+ * BMF forwards datagrams down the DODAG like SMRF does, but only to the
+ * children whose subtree has listeners for the destination group. RPL keeps
+ * a Bloom filter of the groups each child has advertised with DAOs, and a
+ * datagram is unicast to each matching child, or broadcast once when more
+ * than BMF_MAX_UNICAST children match.
+ *
+ * BMF will only work in RPL networks in MOP 3 "Storing with Multicast"
+ * @{
+ */
+/**
+ * \file
+ *    Header file for the BMF forwarding engine
+ */
+
+#ifndef BMF_H_
+#define BMF_H_
+
+#include "contiki-conf.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
+
+#include <stdint.h>
+/*---------------------------------------------------------------------------*/
+/* Configuration */
+/*---------------------------------------------------------------------------*/
+/* Fmin */
+#ifdef BMF_CONF_MIN_FWD_DELAY
+#define BMF_MIN_FWD_DELAY BMF_CONF_MIN_FWD_DELAY
+#else
+#define BMF_MIN_FWD_DELAY 4
+#endif
+
+/* Max Spread */
+#ifdef BMF_CONF_MAX_SPREAD
+#define BMF_MAX_SPREAD BMF_CONF_MAX_SPREAD
+#else
+#define BMF_MAX_SPREAD 4
+#endif
+
+/*
+ * Largest number of children a datagram is unicast to. If more children
+ * have listeners, the datagram is broadcast instead
+ */
+#ifdef BMF_CONF_MAX_UNICAST
+#define BMF_MAX_UNICAST BMF_CONF_MAX_UNICAST
+#else
+#define BMF_MAX_UNICAST 2
+#endif
+/*---------------------------------------------------------------------------*/
+/* Stats datatype */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Multicast stats extension for the BMF engine
+ */
+struct bmf_stats {
+  /** Number of link-layer unicasts of forwarded datagrams */
+  UIP_MCAST6_STATS_DATATYPE fwd_unicast;
+
+  /** Number of link-layer broadcasts of forwarded datagrams */
+  UIP_MCAST6_STATS_DATATYPE fwd_broadcast;
+
+  /** Number of datagrams not forwarded because no child had listeners */
+  UIP_MCAST6_STATS_DATATYPE fwd_suppressed;
+};
+/*---------------------------------------------------------------------------*/
+#endif /* BMF_H_ */
+/*---------------------------------------------------------------------------*/
+/** @} */
+/** @} */
@@ -194,8 +194,13 @@ struct trickle_param {
 #define SEQ_VAL_ADD(s, n) (((s) + (n)) % 0x8000)
 /*---------------------------------------------------------------------------*/
 /* Sliding Windows */
+struct mcast_packet;
+
 struct sliding_window {
   seed_id_t seed_id;
+  struct sliding_window *next;  /* Next in hash bucket, or in the free list */
+  struct mcast_packet *head;    /* Buffered message with the lowest seq. val */
+  struct mcast_packet *tail;    /* Buffered message with the highest seq. val */
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
   int16_t min_listed;           /* lolipop */
@@ -225,7 +230,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -270,6 +274,7 @@ struct mcast_packet {
   /* Short seeds are stored inside the message */
   seed_id_t seed_id;
 #endif
+  struct mcast_packet *next;    /* Next in the window's queue, or free list */
   uint32_t active;              /* Starts at 0 and increments */
   uint32_t dwell;               /* Starts at 0 and increments */
   uint16_t buff_len;
@@ -351,11 +356,6 @@ struct mcast_packet {
  */
 #define MCAST_PACKET_LISTED_CLR(p) ((p)->flags &= ~MCAST_PACKET_L_BIT)
 
-/**
- * \brief Free a multicast packet buffer
- * p: pointer to a struct mcast_packet
- */
-#define MCAST_PACKET_FREE(p) ((p)->flags = 0)
 /*---------------------------------------------------------------------------*/
 /* Sequence Lists in Multicast Trickle ICMP messages */
 struct sequence_list_header {
@@ -443,6 +443,21 @@ static struct roll_tm_stats stats;
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
 static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
+
+/* Windows in use are chained in buckets by Seed ID, the others are free */
+static struct sliding_window *window_hash[ROLL_TM_WIN_HASH];
+static struct sliding_window *free_windows;
+static struct mcast_packet *free_msgs;
+
+/*
+ * The sequence lists of our last ICMP message. They only change when a
+ * message is buffered or freed, or when one stops being active, so they are
+ * kept here and only rebuilt when one of those has happened
+ */
+static uint8_t icmp_payload[ROLL_TM_WINS * sizeof(struct sequence_list_header)
+                            + ROLL_TM_BUFF_NUM * 2];
+static uint16_t icmp_payload_len;
+static uint8_t icmp_payload_stale;
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
 /*---------------------------------------------------------------------------*/
@@ -470,8 +485,9 @@ extern uint16_t uip_slen;
 /*---------------------------------------------------------------------------*/
 static void icmp_input(void);
 static void icmp_output(void);
-static void window_update_bounds(void);
 static void reset_trickle_timer(uint8_t);
+static void window_free(struct sliding_window *);
+static void buffer_free(struct mcast_packet *, struct mcast_packet *);
 static void handle_timer(void *);
 /*---------------------------------------------------------------------------*/
 /* ROLL TM ICMPv6 handler declaration */
@@ -538,6 +554,9 @@ handle_timer(void *ptr)
   struct trickle_param *param;
   clock_time_t diff_last;       /* Time diff from last pass */
   clock_time_t diff_start;      /* Time diff from interval start */
+  struct mcast_packet *prev;
+  struct mcast_packet *next;
+  uint8_t was_active;
   uint8_t m;
 
   param = (struct trickle_param *)ptr;
@@ -573,10 +592,15 @@ handle_timer(void *ptr)
      (unsigned long)diff_last, (unsigned long)diff_start);
 
   /* Handle all buffered messages */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)
-       && (SLIDING_WINDOW_GET_M(locmpptr->sw) == m)) {
+  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
+      iterswptr--) {
+    if(!SLIDING_WINDOW_IS_USED(iterswptr) ||
+       SLIDING_WINDOW_GET_M(iterswptr) != m) {
+      continue;
+    }
+    prev = NULL;
+    for(locmpptr = iterswptr->head; locmpptr != NULL; locmpptr = next) {
+      next = locmpptr->next;
 
       /*
        * if()
@@ -591,6 +615,7 @@ handle_timer(void *ptr)
        * if active == dwell == 0 but i_current != 0, this is an oops
        * (new packet that didn't reset us). We don't handle it
        */
+      was_active = locmpptr->active < TRICKLE_ACTIVE(param);
       if(locmpptr->active == 0) {
         locmpptr->active += diff_start;
         locmpptr->dwell += diff_start;
@@ -598,30 +623,31 @@ handle_timer(void *ptr)
         locmpptr->active += diff_last;
         locmpptr->dwell += diff_last;
       }
+      if(was_active && locmpptr->active >= TRICKLE_ACTIVE(param)) {
+        /* No longer listed in our ICMP messages */
+        icmp_payload_stale = 1;
+      }
 
       VERBOSE_PRINTF("ROLL TM: M=%u Packet %u active %lu of %lu\n",
                      m, locmpptr->seq_val, locmpptr->active,
                      TRICKLE_ACTIVE(param));
 
       if(locmpptr->dwell > TRICKLE_DWELL(param)) {
-        locmpptr->sw->count--;
+        buffer_free(locmpptr, prev);
         PRINTF("ROLL TM: M=%u Free Packet %u (%lu > %lu), Window now at %u\n",
                m, locmpptr->seq_val, locmpptr->dwell,
-               TRICKLE_DWELL(param), locmpptr->sw->count);
-        if(locmpptr->sw->count == 0) {
-          PRINTF("ROLL TM: M=%u Free Window ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
-          PRINTF("\n");
-          window_free(locmpptr->sw);
-        }
-        MCAST_PACKET_FREE(locmpptr);
-      } else if(MCAST_PACKET_TTL(locmpptr) > 0) {
+               TRICKLE_DWELL(param), iterswptr->count);
+        continue;
+      }
+      prev = locmpptr;
+
+      if(MCAST_PACKET_TTL(locmpptr) > 0) {
         /* Handle multicast transmissions */
         if(locmpptr->active < TRICKLE_ACTIVE(param) &&
            ((SUPPRESSION_ENABLED(param) && MCAST_PACKET_MUST_SEND(locmpptr)) ||
            SUPPRESSION_DISABLED(param))) {
           PRINTF("ROLL TM: M=%u Periodic - Sending packet from Seed ", m);
-          PRINT_SEED(&locmpptr->sw->seed_id);
+          PRINT_SEED(&iterswptr->seed_id);
           PRINTF(" seq %u\n", locmpptr->seq_val);
           uip_len = locmpptr->buff_len;
           memcpy(UIP_IP_BUF, &locmpptr->buff, uip_len);
@@ -633,6 +659,13 @@ handle_timer(void *ptr)
         }
       }
     }
+
+    if(iterswptr->count == 0) {
+      PRINTF("ROLL TM: M=%u Free Window ", m);
+      PRINT_SEED(&iterswptr->seed_id);
+      PRINTF("\n");
+      window_free(iterswptr);
+    }
   }
 
   /* Suppression Enabled - Send an ICMP */
@@ -646,8 +679,6 @@ handle_timer(void *ptr)
   param->inconsistency = 0;
   param->c = 0;
 
-  window_update_bounds();
-
   /* Temporarily store 'now' in t_next */
   param->t_next = clock_time();
   if(param->t_next >= param->t_end) {
@@ -682,27 +713,64 @@ reset_trickle_timer(uint8_t index)
   ctimer_set(&t[index].ct, t[index].t_next, handle_timer, (void *)&t[index]);
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+window_hash_index(seed_id_t *s, uint8_t m)
+{
+  /* The low order bytes of a Seed ID are the ones that tell seeds apart */
+  return (((uint8_t *)s)[sizeof(seed_id_t) - 1] ^
+          ((uint8_t *)s)[sizeof(seed_id_t) - 2] ^ m) % ROLL_TM_WIN_HASH;
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
-window_allocate()
+window_allocate(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    if(!SLIDING_WINDOW_IS_USED(iterswptr)) {
-      iterswptr->count = 0;
-      iterswptr->lower_bound = -1;
-      iterswptr->upper_bound = -1;
-      iterswptr->min_listed = -1;
-      return iterswptr;
-    }
+  struct sliding_window **bucket;
+
+  if(free_windows == NULL) {
+    return NULL;
   }
-  return NULL;
+  iterswptr = free_windows;
+  free_windows = iterswptr->next;
+
+  memset(iterswptr, 0, sizeof(struct sliding_window));
+  iterswptr->lower_bound = -1;
+  iterswptr->upper_bound = -1;
+  iterswptr->min_listed = -1;
+  seed_id_cpy(&iterswptr->seed_id, s);
+  if(m) {
+    SLIDING_WINDOW_M_SET(iterswptr);
+  }
+  SLIDING_WINDOW_IS_USED_SET(iterswptr);
+
+  bucket = &window_hash[window_hash_index(s, m)];
+  iterswptr->next = *bucket;
+  *bucket = iterswptr;
+  return iterswptr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+  struct sliding_window **prev;
+
+  prev = &window_hash[window_hash_index(&w->seed_id, SLIDING_WINDOW_GET_M(w))];
+  while(*prev != NULL && *prev != w) {
+    prev = &(*prev)->next;
+  }
+  if(*prev == w) {
+    *prev = w->next;
+  }
+
+  w->flags = 0;
+  w->next = free_windows;
+  free_windows = w;
 }
 /*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  for(iterswptr = window_hash[window_hash_index(s, m)]; iterswptr != NULL;
+      iterswptr = iterswptr->next) {
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
     VERBOSE_PRINT_SEED(&iterswptr->seed_id);
     VERBOSE_PRINTF("\n");
@@ -714,31 +782,79 @@ window_lookup(seed_id_t *s, uint8_t m)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Each window keeps its buffered messages queued in sequence value order, so
+ * its lower bound is always the sequence value at the head of the queue. The
+ * upper bound is the highest value ever seen and is only moved forward when a
+ * message is buffered
+ */
 static void
-window_update_bounds()
+buffer_insert(struct sliding_window *w, struct mcast_packet *p)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    iterswptr->lower_bound = -1;
+  struct mcast_packet *prev;
+  struct mcast_packet *next;
+
+  p->sw = w;
+  if(w->tail == NULL) {
+    w->head = w->tail = p;
+  } else if(SEQ_VAL_IS_GT(p->seq_val, w->tail->seq_val)) {
+    /* The common case, a message newer than all we have */
+    w->tail->next = p;
+    w->tail = p;
+  } else {
+    prev = NULL;
+    for(next = w->head; next != NULL &&
+        SEQ_VAL_IS_LT(next->seq_val, p->seq_val); next = next->next) {
+      prev = next;
+    }
+    p->next = next;
+    if(prev == NULL) {
+      w->head = p;
+    } else {
+      prev->next = p;
+    }
+    if(next == NULL) {
+      w->tail = p;
+    }
   }
+  w->lower_bound = w->head->seq_val;
+  w->count++;
+  MCAST_PACKET_USED_SET(p);
 
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      iterswptr = locmpptr->sw;
-      VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
-                     iterswptr->lower_bound, iterswptr->upper_bound,
-                     locmpptr->seq_val);
-      if(iterswptr->lower_bound < 0
-         || SEQ_VAL_IS_LT(locmpptr->seq_val, iterswptr->lower_bound)) {
-        iterswptr->lower_bound = locmpptr->seq_val;
-      }
-      if(iterswptr->upper_bound < 0 ||
-         SEQ_VAL_IS_GT(locmpptr->seq_val, iterswptr->upper_bound)) {
-        iterswptr->upper_bound = locmpptr->seq_val;
-      }
-    }
+  icmp_payload_stale = 1;
+#if UIP_MCAST6_STATS
+  UIP_MCAST6_STATS_ADD(mcast_buff_used);
+  if(UIP_MCAST6_STATS_GET(mcast_buff_used) >
+     UIP_MCAST6_STATS_GET(mcast_buff_max)) {
+    UIP_MCAST6_STATS_SET(mcast_buff_max,
+                         UIP_MCAST6_STATS_GET(mcast_buff_used));
   }
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Remove p from its window's queue, where it follows prev (NULL: the head) */
+static void
+buffer_free(struct mcast_packet *p, struct mcast_packet *prev)
+{
+  struct sliding_window *w = p->sw;
+
+  if(prev == NULL) {
+    w->head = p->next;
+  } else {
+    prev->next = p->next;
+  }
+  if(w->tail == p) {
+    w->tail = prev;
+  }
+  w->lower_bound = w->head != NULL ? w->head->seq_val : -1;
+  w->count--;
+
+  p->flags = 0;
+  p->next = free_msgs;
+  free_msgs = p;
+
+  icmp_payload_stale = 1;
+  UIP_MCAST6_STATS_SUB(mcast_buff_used);
 }
 /*---------------------------------------------------------------------------*/
 static struct mcast_packet *
@@ -754,7 +870,7 @@ buffer_reclaim()
     }
   }
 
-  if(largest->count == 1) {
+  if(largest->count <= 1) {
     /* Can't reclaim last entry for a window and this is the largest window */
     return NULL;
   }
@@ -763,55 +879,38 @@ buffer_reclaim()
   PRINT_SEED(&largest->seed_id);
   PRINTF(" M=%u, count was %u\n",
          SLIDING_WINDOW_GET_M(largest), largest->count);
-  /* Find the packet at the lowest bound for the largest window */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
-      rv = locmpptr;
-      PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
-      MCAST_PACKET_FREE(rv);
-      largest->count--;
-      window_update_bounds();
-      VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
-                     largest->lower_bound, largest->upper_bound);
-      return rv;
-    }
-  }
 
-  /* oops */
-  return NULL;
+  /* The packet at the lowest bound is at the head of the queue */
+  rv = largest->head;
+  PRINTF("ROLL TM: Reclaim seq. val %u\n", rv->seq_val);
+  buffer_free(rv, NULL);
+  UIP_MCAST6_STATS_ADD(mcast_buff_reclaimed);
+  VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
+                 largest->lower_bound, largest->upper_bound);
+
+  /* Take it back out of the free list */
+  free_msgs = rv->next;
+  return rv;
 }
 /*---------------------------------------------------------------------------*/
 static struct mcast_packet *
 buffer_allocate()
 {
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(!MCAST_PACKET_IS_USED(locmpptr)) {
-      return locmpptr;
-    }
+  locmpptr = free_msgs;
+  if(locmpptr != NULL) {
+    free_msgs = locmpptr->next;
   }
-  return NULL;
+  return locmpptr;
 }
 /*---------------------------------------------------------------------------*/
 static void
-icmp_output()
+icmp_payload_build()
 {
   struct sequence_list_header *sl;
   uint8_t *buffer;
-  uint16_t payload_len;
-
-  PRINTF("ROLL TM: ICMPv6 Out\n");
-
-  UIP_IP_BUF->vtc = 0x60;
-  UIP_IP_BUF->tcflow = 0;
-  UIP_IP_BUF->flow = 0;
-  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
-  UIP_IP_BUF->ttl = ROLL_TM_IP_HOP_LIMIT;
 
   sl = (struct sequence_list_header *)UIP_ICMP_PAYLOAD;
-  payload_len = 0;
+  icmp_payload_len = 0;
 
   VERBOSE_PRINTF("ROLL TM: ICMPv6 Out - Hdr @ %p, payload @ %p\n", UIP_ICMP_BUF, sl);
 
@@ -832,30 +931,54 @@ icmp_output()
 
       buffer = (uint8_t *)sl + sizeof(struct sequence_list_header);
 
-      for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-          locmpptr >= buffered_msgs; locmpptr--) {
-        if(MCAST_PACKET_IS_USED(locmpptr) &&
-           locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
-          if(locmpptr->sw == iterswptr) {
-            sl->seq_len++;
-            PRINTF(", %u", locmpptr->seq_val);
-            *buffer = (uint8_t)(locmpptr->seq_val >> 8);
-            buffer++;
-            *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
-            buffer++;
-          }
+      for(locmpptr = iterswptr->head; locmpptr != NULL;
+          locmpptr = locmpptr->next) {
+        if(locmpptr->active <
+           TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
+          sl->seq_len++;
+          PRINTF(", %u", locmpptr->seq_val);
+          *buffer = (uint8_t)(locmpptr->seq_val >> 8);
+          buffer++;
+          *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
+          buffer++;
         }
       }
       PRINTF(", Len=%u\n", sl->seq_len);
 
       /* Scrap the entire window if it has no content */
       if(sl->seq_len > 0) {
-        payload_len += sizeof(struct sequence_list_header) + sl->seq_len * 2;
+        icmp_payload_len += sizeof(struct sequence_list_header) +
+          sl->seq_len * 2;
         sl = (struct sequence_list_header *)buffer;
       }
     }
   }
 
+  memcpy(icmp_payload, UIP_ICMP_PAYLOAD, icmp_payload_len);
+  icmp_payload_stale = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+icmp_output()
+{
+  uint16_t payload_len;
+
+  PRINTF("ROLL TM: ICMPv6 Out\n");
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = ROLL_TM_IP_HOP_LIMIT;
+
+  /* Only walk our buffers if the sequence lists have changed */
+  if(icmp_payload_stale) {
+    icmp_payload_build();
+  } else {
+    memcpy(UIP_ICMP_PAYLOAD, icmp_payload, icmp_payload_len);
+  }
+  payload_len = icmp_payload_len;
+
   if(payload_len == 0) {
     VERBOSE_PRINTF("ROLL TM: ICMPv6 Out - nothing to send\n");
     return;
@@ -978,12 +1101,9 @@ accept(uint8_t in)
       UIP_MCAST6_STATS_ADD(mcast_dropped);
       return UIP_MCAST6_DROP;
     }
-    for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-        locmpptr >= buffered_msgs; locmpptr--) {
-      if(MCAST_PACKET_IS_USED(locmpptr) &&
-         locmpptr->sw == locswptr &&
-         SLIDING_WINDOW_GET_M(locmpptr->sw) == m &&
-         SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
+    for(locmpptr = locswptr->head; locmpptr != NULL;
+        locmpptr = locmpptr->next) {
+      if(SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
         /* Seen before , drop */
         PRINTF("ROLL TM: Seen before\n");
         UIP_MCAST6_STATS_ADD(mcast_dropped);
@@ -997,7 +1117,7 @@ accept(uint8_t in)
   /* We have not seen this message before */
   /* Allocate a window if we have to */
   if(!locswptr) {
-    locswptr = window_allocate();
+    locswptr = window_allocate(seed_ptr, m);
     PRINTF("ROLL TM: New seed\n");
   }
   if(!locswptr) {
@@ -1020,9 +1140,10 @@ accept(uint8_t in)
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    UIP_MCAST6_STATS_ADD(mcast_buff_failed);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1031,38 +1152,22 @@ accept(uint8_t in)
 #endif
 
   /* We have a window and we have a buffer. Accept this message */
-  /* Set the seed ID and correct M for this window */
-  SLIDING_WINDOW_M_CLR(locswptr);
-  if(m) {
-    SLIDING_WINDOW_M_SET(locswptr);
-  }
-  SLIDING_WINDOW_IS_USED_SET(locswptr);
-  seed_id_cpy(&locswptr->seed_id, seed_ptr);
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
   PRINTF(" M=%u, count=%u\n",
          SLIDING_WINDOW_GET_M(locswptr), locswptr->count);
 
-  /* If this window was previously empty, set its lower bound to this packet */
-  if(locswptr->count == 0) {
-    locswptr->lower_bound = seq_val;
-    VERBOSE_PRINTF("ROLL TM: New Lower Bound %u\n", locswptr->lower_bound);
-  }
-
   /* If this is a new Seq Num, update the window upper bound */
   if(locswptr->count == 0 || SEQ_VAL_IS_GT(seq_val, locswptr->upper_bound)) {
     locswptr->upper_bound = seq_val;
     VERBOSE_PRINTF("ROLL TM: New Upper Bound %u\n", locswptr->upper_bound);
   }
 
-  locswptr->count++;
-
   memset(locmpptr, 0, sizeof(struct mcast_packet));
   memcpy(&locmpptr->buff, UIP_IP_BUF, uip_len);
-  locmpptr->sw = locswptr;
   locmpptr->buff_len = uip_len;
   locmpptr->seq_val = seq_val;
-  MCAST_PACKET_USED_SET(locmpptr);
+  buffer_insert(locswptr, locmpptr);
 
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
@@ -1222,23 +1327,21 @@ icmp_input()
 
           inconsistency = 1;
           /* Check if the advertised sequence is in our buffer */
-          for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-              locmpptr >= buffered_msgs; locmpptr--) {
-            if(MCAST_PACKET_IS_USED(locmpptr) && locmpptr->sw == locswptr) {
-              if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
-
-                inconsistency = 0;
-                MCAST_PACKET_LISTED_SET(locmpptr);
-                PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
-
-                /* Update lowest seq. num listed for this window
-                 * We need this to check for "we have new" */
-                if(locswptr->min_listed == -1 ||
-                   SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
-                  locswptr->min_listed = val;
-                }
-                break;
+          for(locmpptr = locswptr->head; locmpptr != NULL;
+              locmpptr = locmpptr->next) {
+            if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
+
+              inconsistency = 0;
+              MCAST_PACKET_LISTED_SET(locmpptr);
+              PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
+
+              /* Update lowest seq. num listed for this window
+               * We need this to check for "we have new" */
+              if(locswptr->min_listed == -1 ||
+                 SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
+                locswptr->min_listed = val;
               }
+              break;
             }
           }
           if(inconsistency) {
@@ -1265,17 +1368,20 @@ icmp_input()
 
   /* Check for "We have new */
   PRINTF("ROLL TM: ICMPv6 In, Check our buffer\n");
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      locswptr = locmpptr->sw;
+  for(locswptr = &windows[ROLL_TM_WINS - 1]; locswptr >= windows;
+      locswptr--) {
+    if(!SLIDING_WINDOW_IS_USED(locswptr)) {
+      continue;
+    }
+    /* Point to the sliding window's trickle param */
+    loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
+    for(locmpptr = locswptr->head; locmpptr != NULL;
+        locmpptr = locmpptr->next) {
       PRINTF("ROLL TM: ICMPv6 In, ");
       PRINTF("Check %u, Seed L: %u, This L: %u Min L: %d\n",
              locmpptr->seq_val, SLIDING_WINDOW_IS_LISTED(locswptr),
              MCAST_PACKET_IS_LISTED(locmpptr), locswptr->min_listed);
 
-      /* Point to the sliding window's trickle param */
-      loctpptr = &t[SLIDING_WINDOW_GET_M(locswptr)];
       if(!SLIDING_WINDOW_IS_LISTED(locswptr)) {
         /* If a buffered packet's Seed ID was not listed */
         PRINTF("ROLL TM: Inconsistency - Seed ID ");
@@ -1415,6 +1521,7 @@ init()
 
   memset(windows, 0, sizeof(windows));
   memset(buffered_msgs, 0, sizeof(buffered_msgs));
+  memset(window_hash, 0, sizeof(window_hash));
   memset(t, 0, sizeof(t));
 
   ROLL_TM_STATS_INIT();
@@ -1423,12 +1530,23 @@ init()
   /* Register the ICMPv6 input handler */
   uip_icmp6_register_input_handler(&roll_tm_icmp_handler);
 
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  free_windows = NULL;
+  for(iterswptr = windows; iterswptr < &windows[ROLL_TM_WINS]; iterswptr++) {
     iterswptr->lower_bound = -1;
     iterswptr->upper_bound = -1;
     iterswptr->min_listed = -1;
+    iterswptr->next = free_windows;
+    free_windows = iterswptr;
+  }
+
+  free_msgs = NULL;
+  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
+      locmpptr >= buffered_msgs; locmpptr--) {
+    locmpptr->next = free_msgs;
+    free_msgs = locmpptr;
   }
+  icmp_payload_len = 0;
+  icmp_payload_stale = 0;
 
   TIMER_CONFIGURE(0);
   reset_trickle_timer(0);
@@ -175,11 +175,24 @@
 #define ROLL_TM_WINS 2
 #endif
 /*---------------------------------------------------------------------------*/
+/**
+ * Number of hash buckets used to find the sliding window of a Seed ID.
+ * Lookups happen for every multicast datagram and for every sequence list in
+ * an ICMP message, so this should grow along with ROLL_TM_WINS
+ */
+#ifdef ROLL_TM_CONF_WIN_HASH
+#define ROLL_TM_WIN_HASH ROLL_TM_CONF_WIN_HASH
+#else
+#define ROLL_TM_WIN_HASH ROLL_TM_WINS
+#endif
+/*---------------------------------------------------------------------------*/
 /**
  * Maximum Number of Buffered Multicast Messages
  * This buffer is shared across all Seed IDs, therefore a new very active Seed
  * may eventually occupy all slots. It would make little sense (if any) to
  * define support for fewer buffered messages than seeds*2
+ * When all slots are taken, the message with the lowest sequence value of the
+ * Seed with the most buffered messages is evicted
  */
 #ifdef ROLL_TM_CONF_BUFF_NUM
 #define ROLL_TM_BUFF_NUM ROLL_TM_CONF_BUFF_NUM
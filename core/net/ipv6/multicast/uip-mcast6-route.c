@@ -61,6 +61,11 @@ LIST(mcast_route_list);
 MEMB(mcast_route_memb, uip_mcast6_route_t, UIP_MCAST6_ROUTE_ROUTES);
 
 static uip_mcast6_route_t *locmcastrt;
+
+#if UIP_MCAST6_ROUTE_FILTERS
+LIST(mcast_filter_list);
+MEMB(mcast_filter_memb, uip_mcast6_filter_t, UIP_MCAST6_ROUTE_FILTER_CHILDREN);
+#endif
 /*---------------------------------------------------------------------------*/
 uip_mcast6_route_t *
 uip_mcast6_route_lookup(uip_ipaddr_t *group)
@@ -125,11 +130,116 @@ uip_mcast6_route_count(void)
   return list_length(mcast_route_list);
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_MCAST6_ROUTE_FILTERS
+/*
+ * The filter bits of a group are derived from the two halves of its FNV-1a
+ * hash, as bit_i = h1 + i * h2 (Kirsch and Mitzenmacher)
+ */
+#define FILTER_BIT(h, i) \
+  (((uint16_t)(h) + (i) * (uint16_t)((h) >> 16)) % UIP_MCAST6_ROUTE_FILTER_BITS)
+
+static uint32_t
+filter_hash(const uip_ipaddr_t *group)
+{
+  uint32_t h = 2166136261UL;
+  uint8_t i;
+
+  for(i = 0; i < sizeof(uip_ipaddr_t); i++) {
+    h = (h ^ group->u8[i]) * 16777619UL;
+  }
+  return h;
+}
+/*---------------------------------------------------------------------------*/
+uip_mcast6_filter_t *
+uip_mcast6_filter_add(const uip_lladdr_t *child, const uip_ipaddr_t *group)
+{
+  uip_mcast6_filter_t *f;
+  uint32_t h;
+  uint16_t bit;
+  uint8_t i;
+
+  for(f = list_head(mcast_filter_list); f != NULL; f = list_item_next(f)) {
+    if(memcmp(&f->lladdr, child, sizeof(uip_lladdr_t)) == 0) {
+      break;
+    }
+  }
+
+  if(f == NULL) {
+    f = memb_alloc(&mcast_filter_memb);
+    if(f == NULL) {
+      return NULL;
+    }
+    memset(f, 0, sizeof(uip_mcast6_filter_t));
+    memcpy(&f->lladdr, child, sizeof(uip_lladdr_t));
+    list_add(mcast_filter_list, f);
+  }
+
+  h = filter_hash(group);
+  for(i = 0; i < UIP_MCAST6_ROUTE_FILTER_HASHES; i++) {
+    bit = FILTER_BIT(h, i);
+    f->bits[0][bit >> 3] |= 1 << (bit & 7);
+  }
+
+  return f;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_mcast6_filter_match(const uip_mcast6_filter_t *filter,
+                        const uip_ipaddr_t *group)
+{
+  uint32_t h;
+  uint16_t bit;
+  uint8_t i;
+
+  h = filter_hash(group);
+  for(i = 0; i < UIP_MCAST6_ROUTE_FILTER_HASHES; i++) {
+    bit = FILTER_BIT(h, i);
+    if(((filter->bits[0][bit >> 3] | filter->bits[1][bit >> 3]) &
+        (1 << (bit & 7))) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_mcast6_filter_age(uip_mcast6_filter_t *filter)
+{
+  uint8_t i;
+  uint8_t used;
+
+  used = 0;
+  for(i = 0; i < sizeof(filter->bits[0]); i++) {
+    filter->bits[1][i] = filter->bits[0][i];
+    filter->bits[0][i] = 0;
+    used |= filter->bits[1][i];
+  }
+  return used != 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_mcast6_filter_rm(uip_mcast6_filter_t *filter)
+{
+  list_remove(mcast_filter_list, filter);
+  memb_free(&mcast_filter_memb, filter);
+}
+/*---------------------------------------------------------------------------*/
+uip_mcast6_filter_t *
+uip_mcast6_filter_list_head(void)
+{
+  return list_head(mcast_filter_list);
+}
+#endif /* UIP_MCAST6_ROUTE_FILTERS */
+/*---------------------------------------------------------------------------*/
 void
 uip_mcast6_route_init()
 {
   memb_init(&mcast_route_memb);
   list_init(mcast_route_list);
+#if UIP_MCAST6_ROUTE_FILTERS
+  memb_init(&mcast_filter_memb);
+  list_init(mcast_filter_list);
+#endif
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
@@ -44,9 +44,46 @@
 
 #include "contiki.h"
 #include "net/ip/uip.h"
+#include "net/ipv6/multicast/uip-mcast6-engines.h"
 
 #include <stdint.h>
 /*---------------------------------------------------------------------------*/
+/*
+ * Per-child subscription filters. Next to the group routes, keep a Bloom
+ * filter of the groups each child has subscribed to, so that an engine can
+ * tell which subtrees have listeners for a group. Engines that need them turn
+ * them on by default
+ */
+#ifdef UIP_MCAST6_ROUTE_CONF_FILTERS
+#define UIP_MCAST6_ROUTE_FILTERS UIP_MCAST6_ROUTE_CONF_FILTERS
+#elif defined(UIP_MCAST6_CONF_ENGINE) && \
+  UIP_MCAST6_CONF_ENGINE == UIP_MCAST6_ENGINE_BMF
+#define UIP_MCAST6_ROUTE_FILTERS 1
+#else
+#define UIP_MCAST6_ROUTE_FILTERS 0
+#endif
+
+/* Maximum number of children we keep a filter for */
+#ifdef UIP_MCAST6_ROUTE_CONF_FILTER_CHILDREN
+#define UIP_MCAST6_ROUTE_FILTER_CHILDREN UIP_MCAST6_ROUTE_CONF_FILTER_CHILDREN
+#else
+#define UIP_MCAST6_ROUTE_FILTER_CHILDREN 4
+#endif
+
+/* Size of each filter in bits. Must be a multiple of 8 */
+#ifdef UIP_MCAST6_ROUTE_CONF_FILTER_BITS
+#define UIP_MCAST6_ROUTE_FILTER_BITS UIP_MCAST6_ROUTE_CONF_FILTER_BITS
+#else
+#define UIP_MCAST6_ROUTE_FILTER_BITS 64
+#endif
+
+/* Number of bits set in a filter for each group */
+#ifdef UIP_MCAST6_ROUTE_CONF_FILTER_HASHES
+#define UIP_MCAST6_ROUTE_FILTER_HASHES UIP_MCAST6_ROUTE_CONF_FILTER_HASHES
+#else
+#define UIP_MCAST6_ROUTE_FILTER_HASHES 2
+#endif
+/*---------------------------------------------------------------------------*/
 /** \brief An entry in the multicast routing table */
 typedef struct uip_mcast6_route {
   struct uip_mcast6_route *next; /**< Routes are arranged in a linked list */
@@ -55,6 +92,25 @@ typedef struct uip_mcast6_route {
   void *dag; /**< Pointer to an rpl_dag_t struct */
 } uip_mcast6_route_t;
 /*---------------------------------------------------------------------------*/
+#if UIP_MCAST6_ROUTE_FILTERS
+/**
+ * \brief The groups subscribed to by one of our children
+ *
+ * Groups can not be removed from a Bloom filter, so each filter is kept in
+ * two generations. Subscriptions go to the current generation, lookups match
+ * either, and every period the previous generation is dropped. A group that
+ * is no longer renewed thus disappears after at most two periods
+ */
+typedef struct uip_mcast6_filter {
+  struct uip_mcast6_filter *next; /**< Filters are arranged in a linked list */
+  uip_lladdr_t lladdr; /**< The child's link-layer address */
+  uint32_t lifetime; /**< Seconds until the generations are aged */
+  uint32_t period; /**< Lifetime of a generation in seconds */
+  void *dag; /**< Pointer to an rpl_dag_t struct */
+  uint8_t bits[2][UIP_MCAST6_ROUTE_FILTER_BITS / 8]; /**< The Bloom filters */
+} uip_mcast6_filter_t;
+#endif /* UIP_MCAST6_ROUTE_FILTERS */
+/*---------------------------------------------------------------------------*/
 /** \name Multicast Routing Table Manipulation */
 /** @{ */
 
@@ -106,5 +162,54 @@ uip_mcast6_route_t *uip_mcast6_route_list_head(void);
 void uip_mcast6_route_init(void);
 /** @} */
 
+#if UIP_MCAST6_ROUTE_FILTERS
+/** \name Per-child Subscription Filters */
+/** @{ */
+
+/**
+ * \brief Record that a child has subscribed to a group
+ * \param child The child's link-layer address
+ * \param group A pointer to the multicast group
+ * \return A pointer to the child's filter, or NULL if there was no room for it
+ *
+ * The group is added to the current generation of the child's filter.
+ * Callers should set the filter's period, and its lifetime if it is 0
+ */
+uip_mcast6_filter_t *uip_mcast6_filter_add(const uip_lladdr_t *child,
+                                           const uip_ipaddr_t *group);
+
+/**
+ * \brief Check whether a child may have subscribed to a group
+ * \param filter A pointer to the child's filter
+ * \param group A pointer to the multicast group
+ * \return 1 if the group may be in the filter, 0 if it definitely is not
+ */
+int uip_mcast6_filter_match(const uip_mcast6_filter_t *filter,
+                            const uip_ipaddr_t *group);
+
+/**
+ * \brief Start a new generation of a child's filter
+ * \param filter A pointer to the child's filter
+ * \return 1 if the filter still holds groups, 0 if it is empty
+ *
+ * The previous generation is dropped and the current one becomes the
+ * previous. The caller should remove the filter if it is empty
+ */
+int uip_mcast6_filter_age(uip_mcast6_filter_t *filter);
+
+/**
+ * \brief Remove a child's filter
+ * \param filter A pointer to the filter to be removed
+ */
+void uip_mcast6_filter_rm(uip_mcast6_filter_t *filter);
+
+/**
+ * \brief Retrieve a pointer to the start of the filter list
+ * \return A pointer to the first filter, or NULL if there are none
+ */
+uip_mcast6_filter_t *uip_mcast6_filter_list_head(void);
+/** @} */
+#endif /* UIP_MCAST6_ROUTE_FILTERS */
+
 #endif /* UIP_MCAST6_ROUTE_H_ */
 /** @} */
@@ -87,6 +87,18 @@ typedef struct uip_mcast6_stats {
   /** Count of multicast datagrams correclty formed but dropped by us */
   UIP_MCAST6_STATS_DATATYPE mcast_dropped;
 
+  /** Number of datagrams currently held in the engine's buffers */
+  UIP_MCAST6_STATS_DATATYPE mcast_buff_used;
+
+  /** Highest number of datagrams held in the engine's buffers at once */
+  UIP_MCAST6_STATS_DATATYPE mcast_buff_max;
+
+  /** Count of buffered datagrams evicted to make room for new ones */
+  UIP_MCAST6_STATS_DATATYPE mcast_buff_reclaimed;
+
+  /** Count of datagrams dropped because no buffer could be found */
+  UIP_MCAST6_STATS_DATATYPE mcast_buff_failed;
+
   /** Opaque pointer to an engine's additional stats */
   void *engine_stats;
 } uip_mcast6_stats_t;
@@ -98,11 +110,15 @@ typedef struct uip_mcast6_stats {
 extern uip_mcast6_stats_t uip_mcast6_stats;
 
 #define UIP_MCAST6_STATS_ADD(x) uip_mcast6_stats.x++
+#define UIP_MCAST6_STATS_SUB(x) uip_mcast6_stats.x--
 #define UIP_MCAST6_STATS_GET(x) uip_mcast6_stats.x
+#define UIP_MCAST6_STATS_SET(x, v) uip_mcast6_stats.x = (v)
 #define UIP_MCAST6_STATS_INIT(s) uip_mcast6_stats_init(s)
 #else /* UIP_MCAST6_STATS */
 #define UIP_MCAST6_STATS_ADD(x)
+#define UIP_MCAST6_STATS_SUB(x)
 #define UIP_MCAST6_STATS_GET(x) 0
+#define UIP_MCAST6_STATS_SET(x, v)
 #define UIP_MCAST6_STATS_INIT(s)
 #endif /* UIP_MCAST6_STATS */
 /*---------------------------------------------------------------------------*/
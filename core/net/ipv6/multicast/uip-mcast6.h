@@ -36,10 +36,14 @@
 /**
  * \defgroup uip6-multicast IPv6 Multicast Forwarding
  *
- *   We currently support 2 engines:
+ *   We currently support 3 engines:
  *   - 'Stateless Multicast RPL Forwarding' (SMRF)
  *     RPL does group management as per the RPL docs, SMRF handles datagram
  *     forwarding
+ *   - 'Bloom-filter Multicast Forwarding' (BMF)
+ *     Like SMRF, but RPL also keeps a Bloom filter of the groups each child
+ *     has subscribed to, and datagrams are only forwarded to the children
+ *     whose filter matches
  *   - 'Multicast Forwarding with Trickle' according to the algorithm described
  *     in the internet draft:
  *     http://tools.ietf.org/html/draft-ietf-roll-trickle-mcast
@@ -64,6 +68,7 @@
 #include "net/ipv6/multicast/uip-mcast6-route.h"
 #include "net/ipv6/multicast/smrf.h"
 #include "net/ipv6/multicast/roll-tm.h"
+#include "net/ipv6/multicast/bmf.h"
 
 #include <string.h>
 /*---------------------------------------------------------------------------*/
@@ -158,6 +163,10 @@ struct uip_mcast6_driver {
 #define RPL_CONF_MULTICAST     1
 
 #define UIP_MCAST6             smrf_driver
+#elif UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_BMF
+#define RPL_CONF_MULTICAST     1
+
+#define UIP_MCAST6             bmf_driver
 #else
 #error "Multicast Enabled with an Unknown Engine."
 #error "Check the value of UIP_MCAST6_CONF_ENGINE in conf files."
@@ -172,6 +181,9 @@ extern const struct uip_mcast6_driver UIP_MCAST6;
 #error "The selected Multicast mode requires UIP_CONF_IPV6_RPL != 0"
 #error "Check the value of UIP_CONF_IPV6_RPL in conf files."
 #endif
+#if UIP_MCAST6_ENGINE == UIP_MCAST6_ENGINE_BMF && !UIP_MCAST6_ROUTE_FILTERS
+#error "The BMF engine requires UIP_MCAST6_ROUTE_CONF_FILTERS != 0"
+#endif
 /*---------------------------------------------------------------------------*/
 #endif /* UIP_MCAST6_H_ */
 /*---------------------------------------------------------------------------*/
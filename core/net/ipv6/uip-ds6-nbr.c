@@ -70,6 +70,39 @@ void LINK_NEIGHBOR_CALLBACK(const linkaddr_t *addr, int status, int numtx);
 
 NBR_TABLE_GLOBAL(uip_ds6_nbr_t, ds6_neighbors);
 
+#if UIP_DS6_NBR_HASH
+/* Neighbors chained by a hash of their IPv6 address. An entry is in
+   its chain for as long as it is in ds6_neighbors. */
+static uip_ds6_nbr_t *nbr_hash[UIP_DS6_NBR_HASH];
+
+#define NBR_HASH(ipaddr) ((((ipaddr)->u8[14] << 8) | (ipaddr)->u8[15]) % \
+                          UIP_DS6_NBR_HASH)
+/*---------------------------------------------------------------------------*/
+static void
+nbr_hash_add(uip_ds6_nbr_t *nbr)
+{
+  uip_ds6_nbr_t **p;
+
+  /* Append, so that the oldest entry for an address is found first,
+     as in the neighbor table itself. */
+  for(p = &nbr_hash[NBR_HASH(&nbr->ipaddr)]; *p != NULL; p = &(*p)->hash_next);
+  nbr->hash_next = NULL;
+  *p = nbr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+nbr_hash_remove(uip_ds6_nbr_t *nbr)
+{
+  uip_ds6_nbr_t **p;
+
+  for(p = &nbr_hash[NBR_HASH(&nbr->ipaddr)]; *p != NULL; p = &(*p)->hash_next) {
+    if(*p == nbr) {
+      *p = nbr->hash_next;
+      return;
+    }
+  }
+}
+#endif /* UIP_DS6_NBR_HASH */
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_neighbors_init(void)
@@ -81,9 +114,24 @@ uip_ds6_nbr_t *
 uip_ds6_nbr_add(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr,
                 uint8_t isrouter, uint8_t state)
 {
-  uip_ds6_nbr_t *nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr);
+  uip_ds6_nbr_t *nbr;
+
+#if UIP_DS6_NBR_HASH
+  /* Adding a link-layer address that is already in the table reuses
+     its entry, which is cleared before we get it back. */
+  nbr = nbr_table_get_from_lladdr(ds6_neighbors, lladdr != NULL ?
+                                  (linkaddr_t *)lladdr : &linkaddr_null);
+  if(nbr != NULL) {
+    nbr_hash_remove(nbr);
+  }
+#endif /* UIP_DS6_NBR_HASH */
+
+  nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr);
   if(nbr) {
     uip_ipaddr_copy(&nbr->ipaddr, ipaddr);
+#if UIP_DS6_NBR_HASH
+    nbr_hash_add(nbr);
+#endif /* UIP_DS6_NBR_HASH */
     nbr->isrouter = isrouter;
     nbr->state = state;
   #if UIP_CONF_IPV6_QUEUE_PKT
@@ -119,6 +167,13 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
     uip_packetqueue_free(&nbr->packethandle);
 #endif /* UIP_CONF_IPV6_QUEUE_PKT */
     NEIGHBOR_STATE_CHANGED(nbr);
+#if UIP_DS6_NOTIFICATIONS
+    uip_ds6_notification_call(UIP_DS6_NOTIFICATION_NBR_RM,
+                              &nbr->ipaddr, &nbr->ipaddr);
+#endif /* UIP_DS6_NOTIFICATIONS */
+#if UIP_DS6_NBR_HASH
+    nbr_hash_remove(nbr);
+#endif /* UIP_DS6_NBR_HASH */
     nbr_table_remove(ds6_neighbors, nbr);
   }
   return;
@@ -156,6 +211,16 @@ uip_ds6_nbr_num(void)
 uip_ds6_nbr_t *
 uip_ds6_nbr_lookup(const uip_ipaddr_t *ipaddr)
 {
+#if UIP_DS6_NBR_HASH
+  uip_ds6_nbr_t *nbr;
+  if(ipaddr != NULL) {
+    for(nbr = nbr_hash[NBR_HASH(ipaddr)]; nbr != NULL; nbr = nbr->hash_next) {
+      if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+        return nbr;
+      }
+    }
+  }
+#else /* UIP_DS6_NBR_HASH */
   uip_ds6_nbr_t *nbr = nbr_table_head(ds6_neighbors);
   if(ipaddr != NULL) {
     while(nbr != NULL) {
@@ -165,6 +230,7 @@ uip_ds6_nbr_lookup(const uip_ipaddr_t *ipaddr)
       nbr = nbr_table_next(ds6_neighbors, nbr);
     }
   }
+#endif /* UIP_DS6_NBR_HASH */
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
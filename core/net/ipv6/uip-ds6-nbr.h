@@ -64,6 +64,14 @@
 #define  NBR_DELAY 3
 #define  NBR_PROBE 4
 
+/** \brief Number of hash buckets indexing the nbr cache by IPv6
+    address, 0 to search the whole cache on every lookup */
+#ifdef UIP_CONF_DS6_NBR_HASH
+#define UIP_DS6_NBR_HASH UIP_CONF_DS6_NBR_HASH
+#else
+#define UIP_DS6_NBR_HASH 0
+#endif
+
 NBR_TABLE_DECLARE(ds6_neighbors);
 
 /** \brief An entry in the nbr cache */
@@ -74,11 +82,13 @@ typedef struct uip_ds6_nbr {
   uint8_t nscount;
   uint8_t isrouter;
   uint8_t state;
-  uint16_t link_metric;
 #if UIP_CONF_IPV6_QUEUE_PKT
   struct uip_packetqueue_handle packethandle;
 #define UIP_DS6_NBR_PACKET_LIFETIME CLOCK_SECOND * 4
 #endif                          /*UIP_CONF_QUEUE_PKT */
+#if UIP_DS6_NBR_HASH
+  struct uip_ds6_nbr *hash_next;
+#endif /* UIP_DS6_NBR_HASH */
 } uip_ds6_nbr_t;
 
 void uip_ds6_neighbors_init(void);
@@ -141,6 +141,13 @@ uip_ds6_notification_rm(struct uip_ds6_notification *n)
 {
   list_remove(notificationlist, n);
 }
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_notification_call(int event, uip_ipaddr_t *route,
+                          uip_ipaddr_t *nexthop)
+{
+  call_route_callback(event, route, nexthop);
+}
 #endif
 /*---------------------------------------------------------------------------*/
 void
@@ -159,7 +166,7 @@ uip_ds6_route_init(void)
 #endif
 }
 /*---------------------------------------------------------------------------*/
-static uip_lladdr_t *
+uip_lladdr_t *
 uip_ds6_route_nexthop_lladdr(uip_ds6_route_t *route)
 {
   if(route != NULL) {
@@ -240,19 +247,27 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     PRINTF("uip-ds6-route: No route found\n");
   }
 
-  if(found_route != NULL && found_route != list_head(routelist)) {
-    /* If we found a route, we put it at the start of the routeslist
-       list. The list is ordered by how recently we looked them up:
-       the least recently used route will be at the end of the
-       list - for fast lookups (assuming multiple packets to the same node). */
-
-    list_remove(routelist, found_route);
-    list_push(routelist, found_route);
+  if(found_route != NULL) {
+    uip_ds6_route_touch(found_route);
   }
 
   return found_route;
 }
 /*---------------------------------------------------------------------------*/
+void
+uip_ds6_route_touch(uip_ds6_route_t *route)
+{
+  if(route != list_head(routelist)) {
+    /* We put the route at the start of the routeslist list. The list
+       is ordered by how recently we looked them up: the least
+       recently used route will be at the end of the list - for fast
+       lookups (assuming multiple packets to the same node). */
+
+    list_remove(routelist, route);
+    list_push(routelist, route);
+  }
+}
+/*---------------------------------------------------------------------------*/
 uip_ds6_route_t *
 uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 		  uip_ipaddr_t *nexthop)
@@ -55,11 +55,16 @@ void uip_ds6_route_init(void);
 /* Event constants for the uip-ds6 route notification interface. The
    notification interface allows for a user program to be notified via
    a callback when a route has been added or removed and when the
-   system has added or removed a default route. */
-#define UIP_DS6_NOTIFICATION_DEFRT_ADD 0
-#define UIP_DS6_NOTIFICATION_DEFRT_RM  1
-#define UIP_DS6_NOTIFICATION_ROUTE_ADD 2
-#define UIP_DS6_NOTIFICATION_ROUTE_RM  3
+   system has added or removed a default route. Removed neighbors and
+   added or removed on-link prefixes are reported as well, since they
+   also change how a destination is reached. */
+#define UIP_DS6_NOTIFICATION_DEFRT_ADD  0
+#define UIP_DS6_NOTIFICATION_DEFRT_RM   1
+#define UIP_DS6_NOTIFICATION_ROUTE_ADD  2
+#define UIP_DS6_NOTIFICATION_ROUTE_RM   3
+#define UIP_DS6_NOTIFICATION_NBR_RM     4
+#define UIP_DS6_NOTIFICATION_PREFIX_ADD 5
+#define UIP_DS6_NOTIFICATION_PREFIX_RM  6
 
 typedef void (* uip_ds6_notification_callback)(int event,
 					       uip_ipaddr_t *route,
@@ -74,6 +79,10 @@ void uip_ds6_notification_add(struct uip_ds6_notification *n,
 			      uip_ds6_notification_callback c);
 
 void uip_ds6_notification_rm(struct uip_ds6_notification *n);
+
+/* Report an event to all registered callbacks. */
+void uip_ds6_notification_call(int event, uip_ipaddr_t *route,
+                               uip_ipaddr_t *nexthop);
 /*--------------------------------------------------*/
 #endif
 
@@ -98,6 +107,7 @@ typedef struct rpl_route_entry {
   void *dag;
   uint8_t learned_from;
   uint8_t nopath_received;
+  uint8_t path_sequence;
 } rpl_route_entry_t;
 #endif /* UIP_DS6_ROUTE_STATE_TYPE */
 
@@ -157,8 +167,10 @@ uip_ds6_route_t *uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
                                    uip_ipaddr_t *next_hop);
 void uip_ds6_route_rm(uip_ds6_route_t *route);
 void uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop);
+void uip_ds6_route_touch(uip_ds6_route_t *route);
 
 uip_ipaddr_t *uip_ds6_route_nexthop(uip_ds6_route_t *);
+uip_lladdr_t *uip_ds6_route_nexthop_lladdr(uip_ds6_route_t *);
 int uip_ds6_route_num_routes(void);
 uip_ds6_route_t *uip_ds6_route_head(void);
 uip_ds6_route_t *uip_ds6_route_next(uip_ds6_route_t *);
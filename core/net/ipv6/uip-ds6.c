@@ -248,6 +248,10 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
     PRINT6ADDR(&locprefix->ipaddr);
     PRINTF("length %u, flags %x, Valid lifetime %lx, Preffered lifetime %lx\n",
        ipaddrlen, flags, vtime, ptime);
+#if UIP_DS6_NOTIFICATIONS
+    uip_ds6_notification_call(UIP_DS6_NOTIFICATION_PREFIX_ADD,
+                              &locprefix->ipaddr, NULL);
+#endif /* UIP_DS6_NOTIFICATIONS */
     return locprefix;
   } else {
     PRINTF("No more space in Prefix list\n");
@@ -277,6 +281,10 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
     PRINTF("Adding prefix ");
     PRINT6ADDR(&locprefix->ipaddr);
     PRINTF("length %u, vlifetime %lu\n", ipaddrlen, interval);
+#if UIP_DS6_NOTIFICATIONS
+    uip_ds6_notification_call(UIP_DS6_NOTIFICATION_PREFIX_ADD,
+                              &locprefix->ipaddr, NULL);
+#endif /* UIP_DS6_NOTIFICATIONS */
     return locprefix;
   }
   return NULL;
@@ -289,6 +297,10 @@ uip_ds6_prefix_rm(uip_ds6_prefix_t *prefix)
 {
   if(prefix != NULL) {
     prefix->isused = 0;
+#if UIP_DS6_NOTIFICATIONS
+    uip_ds6_notification_call(UIP_DS6_NOTIFICATION_PREFIX_RM,
+                              &prefix->ipaddr, NULL);
+#endif /* UIP_DS6_NOTIFICATIONS */
   }
   return;
 }
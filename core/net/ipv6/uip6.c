@@ -152,7 +152,6 @@ uint8_t uip_ext_opt_offset = 0;
  * \name Buffer defines
  * @{
  */
-#define FBUF                             ((struct uip_tcpip_hdr *)&uip_reassbuf[0])
 #define UIP_IP_BUF                          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define UIP_ICMP_BUF                      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
 #define UIP_UDP_BUF                        ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
@@ -209,8 +208,12 @@ struct uip_conn *uip_conn;
 
 /* Temporary variables. */
 #if (UIP_TCP || UIP_UDP)
+#if UIP_CONN_HASH || UIP_CONNS > 255 || UIP_UDP_CONNS > 255
+static uint16_t c;
+#else
 static uint8_t c;
 #endif
+#endif
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
 /* Keeps track of the last port used for a new connection. */
@@ -256,6 +259,7 @@ static uint8_t iss[4];
 
 /* Temporary variables. */
 uint8_t uip_acc32[4];
+uint16_t uip_acklen;
 static uint8_t opt;
 static uint16_t tmp16;
 #endif /* UIP_TCP */
@@ -273,6 +277,34 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 /** @} */
 
+#if UIP_CONN_HASH
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Connection hash tables
+ * @{
+ */
+/*---------------------------------------------------------------------------*/
+/* The hash tables chain connections by their index in the connection
+   arrays. CONN_HASH_END terminates a chain. */
+#define CONN_HASH_END 0xffff
+
+#if UIP_UDP
+/* UDP connections are hashed on their local port. Unused connections
+   (local port zero) are kept on a separate free chain. */
+static uint16_t udp_hash[UIP_CONN_HASH];
+static uint16_t udp_free;
+static uint16_t udp_next[UIP_UDP_CONNS];
+#endif /* UIP_UDP */
+
+#if UIP_TCP
+/* TCP connections are hashed on their remote address and port pair.
+   Closed connections stay in their chain until they are reused. */
+static uint16_t tcp_hash[UIP_CONN_HASH];
+static uint16_t tcp_next[UIP_CONNS];
+#endif /* UIP_TCP */
+/** @} */
+#endif /* UIP_CONN_HASH */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \name ICMPv6 variables
@@ -428,6 +460,75 @@ uip_udpchksum(void)
 }
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
+#if UIP_CONN_HASH
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP
+static uint16_t *
+udp_chain(uint16_t lport)
+{
+  if(lport == 0) {
+    return &udp_free;
+  }
+  return &udp_hash[uip_ntohs(lport) % UIP_CONN_HASH];
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_rebind(struct uip_udp_conn *conn, uint16_t lport)
+{
+  uint16_t index = conn - uip_udp_conns;
+  uint16_t *p;
+
+  /* Unlink the connection from the chain of its current port. */
+  for(p = udp_chain(conn->lport); *p != CONN_HASH_END; p = &udp_next[*p]) {
+    if(*p == index) {
+      *p = udp_next[index];
+      break;
+    }
+  }
+
+  conn->lport = lport;
+  p = udp_chain(lport);
+  udp_next[index] = *p;
+  *p = index;
+}
+#endif /* UIP_UDP */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+static uint16_t *
+tcp_chain(const uip_ipaddr_t *ripaddr, uint16_t lport, uint16_t rport)
+{
+  return &tcp_hash[(uip_ntohs(lport) ^ uip_ntohs(rport) ^
+                    ((ripaddr->u8[14] << 8) | ripaddr->u8[15])) %
+                   UIP_CONN_HASH];
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_unhash(struct uip_conn *conn)
+{
+  uint16_t index = conn - uip_conns;
+  uint16_t *p;
+
+  for(p = tcp_chain(&conn->ripaddr, conn->lport, conn->rport);
+      *p != CONN_HASH_END; p = &tcp_next[*p]) {
+    if(*p == index) {
+      *p = tcp_next[index];
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_hash_conn(struct uip_conn *conn)
+{
+  uint16_t index = conn - uip_conns;
+  uint16_t *p;
+
+  p = tcp_chain(&conn->ripaddr, conn->lport, conn->rport);
+  tcp_next[index] = *p;
+  *p = index;
+}
+#endif /* UIP_TCP */
+#endif /* UIP_CONN_HASH */
 /*---------------------------------------------------------------------------*/
 void
 uip_init(void)
@@ -444,6 +545,11 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_CONN_HASH
+  for(c = 0; c < UIP_CONN_HASH; ++c) {
+    tcp_hash[c] = CONN_HASH_END;
+  }
+#endif /* UIP_CONN_HASH */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -451,9 +557,22 @@ uip_init(void)
 #endif /* UIP_ACTIVE_OPEN || UIP_UDP */
 
 #if UIP_UDP
+#if UIP_CONN_HASH
+  for(c = 0; c < UIP_CONN_HASH; ++c) {
+    udp_hash[c] = CONN_HASH_END;
+  }
+  /* Put all connections on the free chain, lowest index first. */
+  udp_free = CONN_HASH_END;
+  for(c = UIP_UDP_CONNS; c > 0; --c) {
+    uip_udp_conns[c - 1].lport = 0;
+    udp_next[c - 1] = udp_free;
+    udp_free = c - 1;
+  }
+#else /* UIP_CONN_HASH */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#endif /* UIP_CONN_HASH */
 #endif /* UIP_UDP */
 
 #if UIP_CONF_IPV6_MULTICAST
@@ -519,14 +638,25 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->initialmss = conn->mss = UIP_TCP_MSS;
 
   conn->len = 1;   /* TCP length of the SYN is one. */
+#if UIP_TCP_SEND_WINDOW > 1
+  conn->snd_window = 0;
+  conn->dupacks = 0;
+  conn->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   conn->nrtx = 0;
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
+#if UIP_CONN_HASH
+  tcp_unhash(conn);
+#endif /* UIP_CONN_HASH */
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH
+  tcp_hash_conn(conn);
+#endif /* UIP_CONN_HASH */
 
   return conn;
 }
@@ -570,6 +700,21 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     lastport = 4096;
   }
 
+#if UIP_CONN_HASH
+  for(c = *udp_chain(uip_htons(lastport)); c != CONN_HASH_END;
+      c = udp_next[c]) {
+    if(uip_udp_conns[c].lport == uip_htons(lastport)) {
+      goto again;
+    }
+  }
+
+  if(udp_free == CONN_HASH_END) {
+    return 0;
+  }
+  conn = &uip_udp_conns[udp_free];
+
+  uip_udp_rebind(conn, UIP_HTONS(lastport));
+#else /* UIP_CONN_HASH */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == uip_htons(lastport)) {
       goto again;
@@ -589,6 +734,7 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
   }
 
   conn->lport = UIP_HTONS(lastport);
+#endif /* UIP_CONN_HASH */
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -629,20 +775,12 @@ uip_listen(uint16_t port)
 #if UIP_CONF_IPV6_REASSEMBLY
 #define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
 
-static uint8_t uip_reassbuf[UIP_REASS_BUFSIZE];
-
-static uint8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
 /*the first byte of an IP fragment is aligned on an 8-byte boundary */
-
 static const uint8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
                                     0x0f, 0x07, 0x03, 0x01};
-static uint16_t uip_reasslen;
-static uint8_t uip_reassflags;
 
 #define UIP_REASS_FLAG_LASTFRAG 0x01
 #define UIP_REASS_FLAG_FIRSTFRAG 0x02
-#define UIP_REASS_FLAG_ERROR_MSG 0x04
-
 
 /*
  * See RFC 2460 for a description of fragmentation in IPv6
@@ -653,157 +791,239 @@ static uint8_t uip_reassflags;
  *  +------------------+--------+--------------+
  */
 
+/* A datagram being reassembled. The source and destination addresses
+   that identify it are those in the IP header at the start of buf. */
+struct uip_reass_context {
+  uint8_t buf[UIP_REASS_BUFSIZE];
+  uint8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8)];
+  struct timer timer;
+  uint32_t id;  /* Identification of the fragments, from their
+                   fragment header */
+  uint16_t len;
+  uint8_t flags;
+  uint8_t active;
+};
+
+#define FBUF(ctx) ((struct uip_tcpip_hdr *)&(ctx)->buf[0])
+
+static struct uip_reass_context reass_contexts[UIP_REASS_CONTEXTS];
+
+/* Set when uip_reass() has put an ICMP error message in uip_buf. */
+static uint8_t reass_error;
 
 struct etimer uip_reass_timer; /* timer for reassembly */
-uint8_t uip_reass_on; /* equal to 1 if we are currently reassembling a packet */
 
-static uint32_t uip_id; /* For every packet that is to be fragmented, the source
-                        node generates an Identification value that is present
-                        in all the fragments */
 #define IP_MF   0x0001
 
+/*---------------------------------------------------------------------------*/
+/* Make uip_reass_timer fire when the first reassembly context expires. */
+static void
+reass_timer_update(void)
+{
+  struct uip_reass_context *ctx;
+  clock_time_t next, remaining;
+  uint8_t found;
+
+  found = 0;
+  next = 0;
+  for(ctx = reass_contexts;
+      ctx < reass_contexts + UIP_REASS_CONTEXTS; ctx++) {
+    if(ctx->active) {
+      remaining = timer_expired(&ctx->timer) ? 0 : timer_remaining(&ctx->timer);
+      if(!found || remaining < next) {
+        next = remaining;
+        found = 1;
+      }
+    }
+  }
+
+  if(found) {
+    etimer_set(&uip_reass_timer, next > 0 ? next : 1);
+  } else {
+    etimer_stop(&uip_reass_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reass_free(struct uip_reass_context *ctx)
+{
+  ctx->active = 0;
+  reass_timer_update();
+}
+/*---------------------------------------------------------------------------*/
+/* Find the context of the datagram the fragment in uip_buf belongs to,
+   or start a new one. A context is only reused once its reassembly
+   timer has expired, so that a datagram in progress is never given up
+   for a new one. Returns NULL when all contexts are busy. */
+static struct uip_reass_context *
+reass_context(void)
+{
+  struct uip_reass_context *ctx, *unused, *expired;
+
+  unused = NULL;
+  expired = NULL;
+  for(ctx = reass_contexts;
+      ctx < reass_contexts + UIP_REASS_CONTEXTS; ctx++) {
+    if(!ctx->active) {
+      if(unused == NULL) {
+        unused = ctx;
+      }
+    } else if(ctx->id == UIP_FRAG_BUF->id &&
+              uip_ipaddr_cmp(&FBUF(ctx)->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
+              uip_ipaddr_cmp(&FBUF(ctx)->destipaddr, &UIP_IP_BUF->destipaddr)) {
+      return ctx;
+    } else if(expired == NULL && timer_expired(&ctx->timer)) {
+      expired = ctx;
+    }
+  }
+
+  if(unused != NULL) {
+    ctx = unused;
+  } else if(expired != NULL) {
+    UIP_STAT(++uip_stat.ip.reasstimeout);
+    ctx = expired;
+  } else {
+    PRINTF("No free reassembly context, dropping fragment\n");
+    UIP_STAT(++uip_stat.ip.reassdrop);
+    return NULL;
+  }
+
+  PRINTF("Starting reassembly\n");
+  /* We first write the unfragmentable part of IP header into the
+     reassembly buffer. The reset the other reassembly variables. */
+  memcpy(FBUF(ctx), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+  /* temporary in case we do not receive the fragment with offset 0 first */
+  timer_set(&ctx->timer, UIP_REASS_MAXAGE * CLOCK_SECOND);
+  ctx->active = 1;
+  ctx->flags = 0;
+  ctx->id = UIP_FRAG_BUF->id;
+  /* Clear the bitmap. */
+  memset(ctx->bitmap, 0, sizeof(ctx->bitmap));
+  reass_timer_update();
+
+  return ctx;
+}
+/*---------------------------------------------------------------------------*/
 static uint16_t
 uip_reass(void)
 {
+  struct uip_reass_context *ctx;
   uint16_t offset=0;
   uint16_t len;
   uint16_t i;
 
-  /* If ip_reasstmr is zero, no packet is present in the buffer */
-  /* We first write the unfragmentable part of IP header into the reassembly
-     buffer. The reset the other reassembly variables. */
-  if(uip_reass_on == 0) {
-    PRINTF("Starting reassembly\n");
-    memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-    /* temporary in case we do not receive the fragment with offset 0 first */
-    etimer_set(&uip_reass_timer, UIP_REASS_MAXAGE*CLOCK_SECOND);
-    uip_reass_on = 1;
-    uip_reassflags = 0;
-    uip_id = UIP_FRAG_BUF->id;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
+  reass_error = 0;
+  ctx = reass_context();
+  if(ctx == NULL) {
+    return 0;
   }
-  /*
-   * Check if the incoming fragment matches the one currently present
-   * in the reasembly buffer. If so, we proceed with copying the fragment
-   * into the buffer.
-   */
-  if(uip_ipaddr_cmp(&FBUF->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
-     uip_ipaddr_cmp(&FBUF->destipaddr, &UIP_IP_BUF->destipaddr) &&
-     UIP_FRAG_BUF->id == uip_id) {
-    len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
-    offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
-    /* in byte, originaly in multiple of 8 bytes*/
-    PRINTF("len %d\n", len);
-    PRINTF("offset %d\n", offset);
-    if(offset == 0){
-      uip_reassflags |= UIP_REASS_FLAG_FIRSTFRAG;
-      /*
-       * The Next Header field of the last header of the Unfragmentable
-       * Part is obtained from the Next Header field of the first
-       * fragment's Fragment header.
-       */
-      *uip_next_hdr = UIP_FRAG_BUF->next;
-      memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-      PRINTF("src ");
-      PRINT6ADDR(&FBUF->srcipaddr);
-      PRINTF("dest ");
-      PRINT6ADDR(&FBUF->destipaddr);
-      PRINTF("next %d\n", UIP_IP_BUF->proto);
 
-    }
+  len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
+  offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
+  /* in byte, originaly in multiple of 8 bytes*/
+  PRINTF("len %d\n", len);
+  PRINTF("offset %d\n", offset);
+  if(offset == 0){
+    ctx->flags |= UIP_REASS_FLAG_FIRSTFRAG;
+    /*
+     * The Next Header field of the last header of the Unfragmentable
+     * Part is obtained from the Next Header field of the first
+     * fragment's Fragment header.
+     */
+    *uip_next_hdr = UIP_FRAG_BUF->next;
+    memcpy(FBUF(ctx), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+    PRINTF("src ");
+    PRINT6ADDR(&FBUF(ctx)->srcipaddr);
+    PRINTF("dest ");
+    PRINT6ADDR(&FBUF(ctx)->destipaddr);
+    PRINTF("next %d\n", UIP_IP_BUF->proto);
 
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-      return 0;
-    }
+  }
 
-    /* If this fragment has the More Fragments flag set to zero, it is the
-       last fragment*/
-    if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      /*calculate the size of the entire packet*/
-      uip_reasslen = offset + len;
-      PRINTF("LAST FRAGMENT reasslen %d\n", uip_reasslen);
-    } else {
-      /* If len is not a multiple of 8 octets and the M flag of that fragment
-         is 1, then that fragment must be discarded and an ICMP Parameter
-         Problem, Code 0, message should be sent to the source of the fragment,
-         pointing to the Payload Length field of the fragment packet. */
-      if(len % 8 != 0){
-        uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
-        uip_reassflags |= UIP_REASS_FLAG_ERROR_MSG;
-        /* not clear if we should interrupt reassembly, but it seems so from
-           the conformance tests */
-        uip_reass_on = 0;
-        etimer_stop(&uip_reass_timer);
-        return uip_len;
-      }
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE ||
+     offset + len > UIP_REASS_BUFSIZE) {
+    reass_free(ctx);
+    return 0;
+  }
+
+  /* If this fragment has the More Fragments flag set to zero, it is the
+     last fragment*/
+  if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
+    ctx->flags |= UIP_REASS_FLAG_LASTFRAG;
+    /*calculate the size of the entire packet*/
+    ctx->len = offset + len;
+    PRINTF("LAST FRAGMENT reasslen %d\n", ctx->len);
+  } else {
+    /* If len is not a multiple of 8 octets and the M flag of that fragment
+       is 1, then that fragment must be discarded and an ICMP Parameter
+       Problem, Code 0, message should be sent to the source of the fragment,
+       pointing to the Payload Length field of the fragment packet. */
+    if(len % 8 != 0){
+      uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
+      reass_error = 1;
+      /* not clear if we should interrupt reassembly, but it seems so from
+         the conformance tests */
+      reass_free(ctx);
+      return uip_len;
     }
+  }
 
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy((uint8_t *)FBUF + UIP_IPH_LEN + uip_ext_len + offset,
-           (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy((uint8_t *)FBUF(ctx) + UIP_IPH_LEN + uip_ext_len + offset,
+         (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
 
-    /* Update the bitmap. */
-    if(offset >> 6 == (offset + len) >> 6) {
-      uip_reassbitmap[offset >> 6] |=
-        bitmap_bits[(offset >> 3) & 7] &
-        ~bitmap_bits[((offset + len) >> 3)  & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-         bytes in the endpoints and fill the stuff inbetween with
-         0xff. */
-      uip_reassbitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
+  /* Update the bitmap. */
+  if(offset >> 6 == (offset + len) >> 6) {
+    ctx->bitmap[offset >> 6] |=
+      bitmap_bits[(offset >> 3) & 7] &
+      ~bitmap_bits[((offset + len) >> 3)  & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    ctx->bitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
 
-      for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
-        uip_reassbitmap[i] = 0xff;
-      }
-      uip_reassbitmap[(offset + len) >> 6] |=
-        ~bitmap_bits[((offset + len) >> 3) & 7];
+    for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
+      ctx->bitmap[i] = 0xff;
     }
+    ctx->bitmap[(offset + len) >> 6] |=
+      ~bitmap_bits[((offset + len) >> 3) & 7];
+  }
 
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
 
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-         the bitmap. */
-      for(i = 0; i < (uip_reasslen >> 6); ++i) {
-        if(uip_reassbitmap[i] != 0xff) {
-          return 0;
-        }
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-         right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen >> 6] !=
-         (uint8_t)~bitmap_bits[(uip_reasslen >> 3) & 7]) {
+  if(ctx->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to and including all but the last byte in
+       the bitmap. */
+    for(i = 0; i < (ctx->len >> 6); ++i) {
+      if(ctx->bitmap[i] != 0xff) {
         return 0;
       }
+    }
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(ctx->bitmap[ctx->len >> 6] !=
+       (uint8_t)~bitmap_bits[(ctx->len >> 3) & 7]) {
+      return 0;
+    }
 
-     /* If we have come this far, we have a full packet in the
-         buffer, so we copy it to uip_buf. We also reset the timer. */
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-
-      uip_reasslen += UIP_IPH_LEN + uip_ext_len;
-      memcpy(UIP_IP_BUF, FBUF, uip_reasslen);
-      UIP_IP_BUF->len[0] = ((uip_reasslen - UIP_IPH_LEN) >> 8);
-      UIP_IP_BUF->len[1] = ((uip_reasslen - UIP_IPH_LEN) & 0xff);
-      PRINTF("REASSEMBLED PAQUET %d (%d)\n", uip_reasslen,
-             (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
+    /* If we have come this far, we have a full packet in the
+       buffer, so we copy it to uip_buf. We also free the context. */
+    reass_free(ctx);
 
-      return uip_reasslen;
+    len = ctx->len + UIP_IPH_LEN + uip_ext_len;
+    memcpy(UIP_IP_BUF, FBUF(ctx), len);
+    UIP_IP_BUF->len[0] = ((len - UIP_IPH_LEN) >> 8);
+    UIP_IP_BUF->len[1] = ((len - UIP_IPH_LEN) & 0xff);
+    PRINTF("REASSEMBLED PAQUET %d (%d)\n", len,
+           (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
 
-    }
-  } else {
-    PRINTF("Already reassembling another paquet\n");
+    return len;
   }
   return 0;
 }
@@ -811,30 +1031,41 @@ uip_reass(void)
 void
 uip_reass_over(void)
 {
-   /* to late, we abandon the reassembly of the packet */
-
-  uip_reass_on = 0;
-  etimer_stop(&uip_reass_timer);
-
-  if(uip_reassflags & UIP_REASS_FLAG_FIRSTFRAG){
-    PRINTF("FRAG INTERRUPTED TOO LATE\n");
-    /* If the first fragment has been received, an ICMP Time Exceeded
-       -- Fragment Reassembly Time Exceeded message should be sent to the
-       source of that fragment. */
-    /** \note
-     * We don't have a complete packet to put in the error message.
-     * We could include the first fragment but since its not mandated by
-     * any RFC, we decided not to include it as it reduces the size of
-     * the packet.
-     */
-    uip_clear_buf();
-    memcpy(UIP_IP_BUF, FBUF, UIP_IPH_LEN); /* copy the header for src
-                                              and dest address*/
-    uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
+  struct uip_reass_context *ctx;
 
-    UIP_STAT(++uip_stat.ip.sent);
-    uip_flags = 0;
+  /* to late, we abandon the reassembly of the expired packets */
+  for(ctx = reass_contexts;
+      ctx < reass_contexts + UIP_REASS_CONTEXTS; ctx++) {
+    if(!ctx->active || !timer_expired(&ctx->timer)) {
+      continue;
+    }
+    ctx->active = 0;
+    UIP_STAT(++uip_stat.ip.reasstimeout);
+
+    if(ctx->flags & UIP_REASS_FLAG_FIRSTFRAG){
+      PRINTF("FRAG INTERRUPTED TOO LATE\n");
+      /* If the first fragment has been received, an ICMP Time Exceeded
+         -- Fragment Reassembly Time Exceeded message should be sent to the
+         source of that fragment. */
+      /** \note
+       * We don't have a complete packet to put in the error message.
+       * We could include the first fragment but since its not mandated by
+       * any RFC, we decided not to include it as it reduces the size of
+       * the packet.
+       */
+      uip_clear_buf();
+      memcpy(UIP_IP_BUF, FBUF(ctx), UIP_IPH_LEN); /* copy the header for src
+                                                     and dest address*/
+      uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
+
+      UIP_STAT(++uip_stat.ip.sent);
+      uip_flags = 0;
+      /* uip_buf holds the error message now. Other expired packets are
+         handled when the timer fires again. */
+      break;
+    }
   }
+  reass_timer_update();
 }
 
 #endif /* UIP_CONF_IPV6_REASSEMBLY */
@@ -942,6 +1173,9 @@ uip_process(uint8_t flag)
 {
 #if UIP_TCP
   register struct uip_conn *uip_connr = uip_conn;
+#if UIP_TCP_SEND_WINDOW > 1
+  uint16_t seqoff = 0; /* Offset from snd_nxt of the segment to send. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #endif /* UIP_TCP */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
@@ -955,7 +1189,8 @@ uip_process(uint8_t flag)
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       (!uip_outstanding(uip_connr) ||
+        uip_conn_sendwnd(uip_connr) > 0)) {
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
@@ -1067,6 +1302,15 @@ uip_process(uint8_t flag)
               /* In all these states we should retransmit a FINACK. */
               goto tcp_send_finack;
           }
+#if UIP_TCP_SEND_WINDOW > 1
+        } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+                  uip_conn_sendwnd(uip_connr) > 0) {
+          /* A windowed connection may send more while data is
+             in flight. */
+          uip_flags = UIP_POLL;
+          UIP_APPCALL();
+          goto appsend;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         }
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
         /*
@@ -1383,7 +1627,7 @@ uip_process(uint8_t flag)
         if(uip_len == 0) {
           goto drop;
         }
-        if(uip_reassflags & UIP_REASS_FLAG_ERROR_MSG){
+        if(reass_error){
           /* we are not done with reassembly, this is an error message */
           goto send;
         }
@@ -1506,6 +1750,31 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_CONN_HASH
+  /* Only connections bound to the destination port can match. Among
+     those, pick the one the linear search below would have found
+     first. */
+  {
+    struct uip_udp_conn *match = NULL;
+
+    for(c = *udp_chain(UIP_UDP_BUF->destport); c != CONN_HASH_END;
+        c = udp_next[c]) {
+      uip_udp_conn = &uip_udp_conns[c];
+      if(UIP_UDP_BUF->destport == uip_udp_conn->lport &&
+         (uip_udp_conn->rport == 0 ||
+          UIP_UDP_BUF->srcport == uip_udp_conn->rport) &&
+         (uip_is_addr_unspecified(&uip_udp_conn->ripaddr) ||
+          uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &uip_udp_conn->ripaddr)) &&
+         (match == NULL || uip_udp_conn < match)) {
+        match = uip_udp_conn;
+      }
+    }
+    if(match != NULL) {
+      uip_udp_conn = match;
+      goto udp_found;
+    }
+  }
+#else /* UIP_CONN_HASH */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
@@ -1525,6 +1794,7 @@ uip_process(uint8_t flag)
       goto udp_found;
     }
   }
+#endif /* UIP_CONN_HASH */
   PRINTF("udp: no matching connection found\n");
   UIP_STAT(++uip_stat.udp.drop);
 
@@ -1615,8 +1885,15 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH
+  for(c = *tcp_chain(&UIP_IP_BUF->srcipaddr, UIP_TCP_BUF->destport,
+                     UIP_TCP_BUF->srcport);
+      c != CONN_HASH_END; c = tcp_next[c]) {
+    uip_connr = &uip_conns[c];
+#else /* UIP_CONN_HASH */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_CONN_HASH */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1736,9 +2013,15 @@ uip_process(uint8_t flag)
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_CONN_HASH
+  tcp_unhash(uip_connr);
+#endif /* UIP_CONN_HASH */
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
+#if UIP_CONN_HASH
+  tcp_hash_conn(uip_connr);
+#endif /* UIP_CONN_HASH */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
@@ -1746,6 +2029,11 @@ uip_process(uint8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_connr->snd_window = 0;
+  uip_connr->dupacks = 0;
+  uip_connr->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[0] = UIP_TCP_BUF->seqno[0];
@@ -1864,7 +2152,49 @@ uip_process(uint8_t flag)
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
-    uip_add32(uip_connr->snd_nxt, uip_connr->len);
+#if UIP_TCP_SEND_WINDOW > 1
+    if(uip_connr->snd_window > 1) {
+      /* On a windowed connection the ACK may cover any part of the
+         data in flight. Duplicate ACKs indicate a lost segment, which
+         is retransmitted after three of them (fast retransmit). */
+      uint32_t acked =
+        (((uint32_t)UIP_TCP_BUF->ackno[0] << 24) | ((uint32_t)UIP_TCP_BUF->ackno[1] << 16) |
+         ((uint32_t)UIP_TCP_BUF->ackno[2] << 8) | UIP_TCP_BUF->ackno[3]) -
+        (((uint32_t)uip_connr->snd_nxt[0] << 24) |
+         ((uint32_t)uip_connr->snd_nxt[1] << 16) |
+         ((uint32_t)uip_connr->snd_nxt[2] << 8) | uip_connr->snd_nxt[3]);
+
+      if(acked == 0 && uip_len == 0 &&
+         (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+         (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+         uip_connr->dupacks < 3 && ++uip_connr->dupacks == 3) {
+        /* Ask the application for the oldest segment in flight and
+           send it right away. The counter stays at 3 until new data
+           is acknowledged, so a loss is retransmitted only once. */
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        uip_slen = 0;
+        uip_flags = UIP_REXMIT;
+        UIP_APPCALL();
+        uip_appdata = uip_sappdata;
+        if(uip_slen > uip_connr->len) {
+          uip_slen = uip_connr->len;
+        }
+        if(uip_slen > uip_connr->mss) {
+          uip_slen = uip_connr->mss;
+        }
+        if(uip_slen == 0) {
+          goto drop;
+        }
+        uip_len = uip_slen + UIP_TCPIP_HLEN;
+        UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+        goto tcp_send_noopts;
+      }
+      uip_acklen = acked > 0 && acked <= uip_connr->len ?
+        (uint16_t)acked : uip_connr->len;
+    } else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+    uip_acklen = uip_connr->len;
+    uip_add32(uip_connr->snd_nxt, uip_acklen);
 
     if(UIP_TCP_BUF->ackno[0] == uip_acc32[0] &&
        UIP_TCP_BUF->ackno[1] == uip_acc32[1] &&
@@ -1897,7 +2227,10 @@ uip_process(uint8_t flag)
       uip_connr->timer = uip_connr->rto;
 
       /* Reset length of outstanding data. */
-      uip_connr->len = 0;
+      uip_connr->len -= uip_acklen;
+#if UIP_TCP_SEND_WINDOW > 1
+      uip_connr->dupacks = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     }
 
   }
@@ -2071,6 +2404,17 @@ uip_process(uint8_t flag)
         tmp16 = uip_connr->initialmss;
       }
       uip_connr->mss = tmp16;
+#if UIP_TCP_SEND_WINDOW > 1
+      /* A windowed connection may fill what the peer advertises, up to
+         the number of segments it has asked for. */
+      if(((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1] != 0) {
+        tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+      }
+      if((uint32_t)tmp16 > (uint32_t)uip_connr->snd_window * uip_connr->initialmss) {
+        tmp16 = uip_connr->snd_window * uip_connr->initialmss;
+      }
+      uip_connr->snd_wnd = tmp16;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
       /* If this packet constitutes an ACK for outstanding data (flagged
          by the UIP_ACKDATA flag, we should call the application since it
@@ -2112,6 +2456,21 @@ uip_process(uint8_t flag)
 
         /* If uip_slen > 0, the application has data to be sent. */
         if(uip_slen > 0) {
+#if UIP_TCP_SEND_WINDOW > 1
+          if(uip_connr->snd_window > 1) {
+            /* New data goes behind the data in flight, as far as the
+               window allows. */
+            tmp16 = uip_conn_sendwnd(uip_connr);
+            if(uip_slen > uip_connr->mss) {
+              uip_slen = uip_connr->mss;
+            }
+            if(uip_slen > tmp16) {
+              uip_slen = tmp16;
+            }
+            seqoff = uip_connr->len;
+            uip_connr->len += uip_slen;
+          } else {
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
           /* If the connection has acknowledged data, the contents of
              the ->len variable should be discarded. */
@@ -2141,15 +2500,35 @@ uip_process(uint8_t flag)
                retransmit) out more than it previously sent out. */
             uip_slen = uip_connr->len;
           }
+#if UIP_TCP_SEND_WINDOW > 1
+          }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         }
         uip_connr->nrtx = 0;
       apprexmit:
         uip_appdata = uip_sappdata;
+#if UIP_TCP_SEND_WINDOW > 1
+        /* Only the oldest segment in flight is retransmitted. */
+        if(uip_connr->snd_window > 1 && (uip_flags & UIP_REXMIT)) {
+          if(uip_slen > uip_connr->len) {
+            uip_slen = uip_connr->len;
+          }
+          if(uip_slen > uip_connr->mss) {
+            uip_slen = uip_connr->mss;
+          }
+        }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
         /* If the application has data to be sent, or if the incoming
            packet had new data in it, we must send out a packet. */
         if(uip_slen > 0 && uip_connr->len > 0) {
           /* Add the length of the IP and TCP headers. */
+#if UIP_TCP_SEND_WINDOW > 1
+          /* A windowed connection sends just this segment. */
+          if(uip_connr->snd_window > 1) {
+            uip_len = uip_slen + UIP_TCPIP_HLEN;
+          } else
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
           uip_len = uip_connr->len + UIP_TCPIP_HLEN;
           /* We always set the ACK flag in response packets. */
           UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
@@ -2161,6 +2540,11 @@ uip_process(uint8_t flag)
         if(uip_flags & UIP_NEWDATA) {
           uip_len = UIP_TCPIP_HLEN;
           UIP_TCP_BUF->flags = TCP_ACK;
+#if UIP_TCP_SEND_WINDOW > 1
+          if(uip_connr->snd_window > 1) {
+            seqoff = uip_connr->len;
+          }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
           goto tcp_send_noopts;
         }
       }
@@ -2236,6 +2620,11 @@ uip_process(uint8_t flag)
      to set the appropriate TCP sequence numbers in the TCP header. */
  tcp_send_ack:
   UIP_TCP_BUF->flags = TCP_ACK;
+#if UIP_TCP_SEND_WINDOW > 1
+  if(uip_connr->snd_window > 1) {
+    seqoff = uip_connr->len;
+  }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
  tcp_send_nodata:
   uip_len = UIP_IPTCPH_LEN;
@@ -2255,10 +2644,18 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
 
+#if UIP_TCP_SEND_WINDOW > 1
+  uip_add32(uip_connr->snd_nxt, seqoff);
+  UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+  UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+  UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+  UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Per-neighbor link statistics
+ */
+
+#include "contiki.h"
+#include "net/link-stats.h"
+#include "net/mac/mac.h"
+#include "net/nbr-table.h"
+#include "net/packetbuf.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* Upper bound of the freshness counter */
+#define FRESHNESS_MAX 16
+
+#define EWMA(old, new) \
+  (((int32_t)(old) * LINK_STATS_ALPHA + \
+    (int32_t)(new) * (100 - LINK_STATS_ALPHA)) / 100)
+
+NBR_TABLE(struct link_stats, link_stats);
+
+static struct ctimer periodic_timer;
+/*---------------------------------------------------------------------------*/
+const struct link_stats *
+link_stats_from_lladdr(const linkaddr_t *lladdr)
+{
+  return nbr_table_get_from_lladdr(link_stats, lladdr);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_stats_is_fresh(const struct link_stats *stats)
+{
+  return stats != NULL
+    && stats->freshness >= LINK_STATS_FRESHNESS_TARGET
+    && clock_time() - stats->last_tx_time < LINK_STATS_FRESHNESS_EXPIRATION;
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
+{
+  struct link_stats *stats;
+  uint16_t packet_etx;
+
+  if(linkaddr_cmp(lladdr, &linkaddr_null)) {
+    /* Broadcasts tell us nothing about any particular link */
+    return;
+  }
+
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    stats = nbr_table_add_lladdr(link_stats, lladdr);
+    if(stats == NULL) {
+      return;
+    }
+  }
+
+  stats->last_tx_time = clock_time();
+  stats->tx_count += numtx;
+
+  /* Do not penalize the ETX when collisions or transmission errors occur. */
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    return;
+  }
+
+  if(status == MAC_TX_OK) {
+    stats->ack_count++;
+    packet_etx = numtx * LINK_STATS_ETX_DIVISOR;
+  } else {
+    packet_etx = LINK_STATS_ETX_NOACK * LINK_STATS_ETX_DIVISOR;
+  }
+
+  if(stats->etx == 0) {
+    /* Our first estimate, take it as is */
+    stats->etx = packet_etx;
+  } else {
+    stats->etx = EWMA(stats->etx, packet_etx);
+  }
+
+  if(stats->freshness < FRESHNESS_MAX) {
+    stats->freshness++;
+  }
+
+  PRINTF("link-stats: %u.%u ETX %u (packet ETX %u)\n",
+         lladdr->u8[0], lladdr->u8[1],
+         stats->etx / LINK_STATS_ETX_DIVISOR,
+         packet_etx / LINK_STATS_ETX_DIVISOR);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_input_callback(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+  int16_t packet_rssi;
+
+  /* Only keep track of the neighbors we send to, so that overheard
+     packets do not push other neighbors out of the table */
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    return;
+  }
+
+  packet_rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  if(stats->rssi == 0) {
+    stats->rssi = packet_rssi;
+  } else {
+    stats->rssi = EWMA(stats->rssi, packet_rssi);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+periodic(void *ptr)
+{
+  struct link_stats *stats;
+
+  /* Age the freshness of all neighbors */
+  for(stats = nbr_table_head(link_stats); stats != NULL;
+      stats = nbr_table_next(link_stats, stats)) {
+    stats->freshness >>= 1;
+  }
+
+  ctimer_reset(&periodic_timer);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_init(void)
+{
+  nbr_table_register(link_stats, NULL);
+  ctimer_set(&periodic_timer, LINK_STATS_FRESHNESS_HALF_LIFE, periodic, NULL);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Per-neighbor link statistics, shared by the layers that need
+ *         them. The statistics are updated once for every packet sent or
+ *         received, and are kept in a neighbor table.
+ */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/* ETX fixed point divisor */
+#ifdef LINK_STATS_CONF_ETX_DIVISOR
+#define LINK_STATS_ETX_DIVISOR LINK_STATS_CONF_ETX_DIVISOR
+#else
+#define LINK_STATS_ETX_DIVISOR 256
+#endif
+
+/* ETX of a packet that was never acknowledged */
+#ifdef LINK_STATS_CONF_ETX_NOACK
+#define LINK_STATS_ETX_NOACK LINK_STATS_CONF_ETX_NOACK
+#else
+#define LINK_STATS_ETX_NOACK 10
+#endif
+
+/* Weight of the previous ETX and RSSI in their moving averages, in % */
+#ifdef LINK_STATS_CONF_ALPHA
+#define LINK_STATS_ALPHA LINK_STATS_CONF_ALPHA
+#else
+#define LINK_STATS_ALPHA 90
+#endif
+
+/* The freshness of every neighbor is halved this often */
+#ifdef LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#define LINK_STATS_FRESHNESS_HALF_LIFE LINK_STATS_CONF_FRESHNESS_HALF_LIFE
+#else
+#define LINK_STATS_FRESHNESS_HALF_LIFE (20 * 60 * (clock_time_t)CLOCK_SECOND)
+#endif
+
+/* The number of recent transmissions after which statistics are fresh */
+#ifdef LINK_STATS_CONF_FRESHNESS_TARGET
+#define LINK_STATS_FRESHNESS_TARGET LINK_STATS_CONF_FRESHNESS_TARGET
+#else
+#define LINK_STATS_FRESHNESS_TARGET 4
+#endif
+
+/* Statistics are stale if we have not sent anything for this long */
+#ifdef LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#define LINK_STATS_FRESHNESS_EXPIRATION LINK_STATS_CONF_FRESHNESS_EXPIRATION
+#else
+#define LINK_STATS_FRESHNESS_EXPIRATION (10 * 60 * (clock_time_t)CLOCK_SECOND)
+#endif
+
+/* All statistics of a neighbor */
+struct link_stats {
+  clock_time_t last_tx_time;  /* Time of the last transmission */
+  uint16_t etx;               /* ETX, fixed point, 0 until the first ack/noack */
+  int16_t rssi;               /* RSSI average, 0 until the first reception */
+  uint16_t tx_count;          /* Transmissions, including retransmissions */
+  uint16_t ack_count;         /* Acknowledged packets */
+  uint8_t freshness;          /* Number of recent transmissions */
+};
+
+/* Returns the neighbor's statistics, or NULL if we have none */
+const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+
+/* Are the statistics fresh enough to be trusted? */
+int link_stats_is_fresh(const struct link_stats *stats);
+
+/* Update the statistics of the receiver of the packet we just sent */
+void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx);
+
+/* Update the statistics of the sender of the packet we just received */
+void link_stats_input_callback(const linkaddr_t *lladdr);
+
+/* Initialize the statistics table */
+void link_stats_init(void);
+
+#endif /* LINK_STATS_H_ */
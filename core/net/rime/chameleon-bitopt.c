@@ -53,6 +53,26 @@
 #define CHAMELEON_WITH_MAC_LINK_ADDRESSES 0
 #endif /* !CHAMELEON_CONF_WITH_MAC_LINK_ADDRESSES */
 
+/* The layout of the attributes of a channel is compiled into a short
+   program of pack/unpack operations when the channel attributes are
+   set, so that the per-packet code does not have to walk the
+   attribute list bit by bit. This is the number of channel layouts
+   that are kept compiled at the same time. Channels whose layout is
+   not compiled use the generic bit-by-bit code. Set to 0 to always
+   use the generic code. */
+#ifdef CHAMELEON_BITOPT_CONF_PROGRAMS
+#define CHAMELEON_BITOPT_PROGRAMS CHAMELEON_BITOPT_CONF_PROGRAMS
+#else /* CHAMELEON_BITOPT_CONF_PROGRAMS */
+#define CHAMELEON_BITOPT_PROGRAMS 4
+#endif /* CHAMELEON_BITOPT_CONF_PROGRAMS */
+
+/* The maximum number of attributes of a compiled channel layout. */
+#ifdef CHAMELEON_BITOPT_CONF_PROGRAM_LEN
+#define CHAMELEON_BITOPT_PROGRAM_LEN CHAMELEON_BITOPT_CONF_PROGRAM_LEN
+#else /* CHAMELEON_BITOPT_CONF_PROGRAM_LEN */
+#define CHAMELEON_BITOPT_PROGRAM_LEN 10
+#endif /* CHAMELEON_BITOPT_CONF_PROGRAM_LEN */
+
 struct bitopt_hdr {
   uint8_t channel[2];
 };
@@ -68,6 +88,9 @@ static const uint8_t bitmask[9] = { 0x00, 0x80, 0xc0, 0xe0, 0xf0,
 #define PRINTF(...)
 #endif
 
+#if CHAMELEON_BITOPT_PROGRAMS
+static void compile_program(const struct packetbuf_attrlist *attrlist);
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
 /*---------------------------------------------------------------------------*/
 /* For get_bits/set_bits functions in this file to work correctly,
  * the values contained in packetbuf_attr_t variables (uint16_t internally)
@@ -143,7 +166,11 @@ static int
 header_size(const struct packetbuf_attrlist *a)
 {
   int size, len;
-  
+
+#if CHAMELEON_BITOPT_PROGRAMS
+  compile_program(a);
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
+
   /* Compute the total size of the final header by summing the size of
      all attributes that are used on this channel. */
   
@@ -213,6 +240,188 @@ set_bits(uint8_t *ptr, int bitpos, uint8_t *val, int vallen)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if CHAMELEON_BITOPT_PROGRAMS
+/* The kinds of operations of a compiled program. */
+#define OP_BITS    0 /* Less than 8 bits within a single byte */
+#define OP_SPLIT   1 /* Less than 8 bits across a byte boundary */
+#define OP_BYTES   2 /* A whole number of bytes at any bit position */
+#define OP_GENERIC 3 /* Anything else, through get_bits()/set_bits() */
+
+struct bitopt_op {
+  uint8_t type;
+  uint8_t len;
+  uint8_t byteptr;
+  uint8_t bitpos;
+  uint8_t kind;
+};
+
+struct bitopt_program {
+  const struct packetbuf_attrlist *attrlist;
+  uint8_t len;
+  struct bitopt_op ops[CHAMELEON_BITOPT_PROGRAM_LEN];
+};
+
+static struct bitopt_program programs[CHAMELEON_BITOPT_PROGRAMS];
+static uint8_t next_program;
+/*---------------------------------------------------------------------------*/
+static struct bitopt_program *
+lookup_program(const struct packetbuf_attrlist *attrlist)
+{
+  int i;
+
+  for(i = 0; i < CHAMELEON_BITOPT_PROGRAMS; ++i) {
+    if(programs[i].attrlist == attrlist) {
+      return &programs[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+compile_program(const struct packetbuf_attrlist *attrlist)
+{
+  const struct packetbuf_attrlist *a;
+  struct bitopt_program *p;
+  struct bitopt_op *op;
+  int bitptr, n;
+
+  if(lookup_program(attrlist) != NULL) {
+    return;
+  }
+
+  /* Check that the layout fits in a program before evicting the
+     oldest one. */
+  n = bitptr = 0;
+  for(a = attrlist; a->type != PACKETBUF_ATTR_NONE; ++a) {
+    ++n;
+    bitptr += a->len;
+  }
+  if(n > CHAMELEON_BITOPT_PROGRAM_LEN || bitptr / 8 > 0xff) {
+    PRINTF("chameleon-bitopt: layout with %d attributes not compiled\n", n);
+    return;
+  }
+
+  p = &programs[next_program];
+  next_program = (next_program + 1) % CHAMELEON_BITOPT_PROGRAMS;
+
+  p->attrlist = attrlist;
+  p->len = 0;
+  bitptr = 0;
+  for(a = attrlist; a->type != PACKETBUF_ATTR_NONE; ++a) {
+#if CHAMELEON_WITH_MAC_LINK_ADDRESSES
+    if(a->type == PACKETBUF_ADDR_SENDER ||
+       a->type == PACKETBUF_ADDR_RECEIVER) {
+      /* Let the link layer handle sender and receiver */
+      continue;
+    }
+#endif /* CHAMELEON_WITH_MAC_LINK_ADDRESSES */
+    op = &p->ops[p->len++];
+    op->type = a->type;
+    op->len = a->len;
+    op->byteptr = bitptr / 8;
+    op->bitpos = bitptr & 7;
+    if(a->len < 8) {
+      op->kind = op->bitpos + a->len <= 8 ? OP_BITS : OP_SPLIT;
+    } else if((a->len & 7) == 0 &&
+              (PACKETBUF_IS_ADDR(a->type) || a->len <= 16)) {
+      op->kind = OP_BYTES;
+    } else {
+      op->kind = OP_GENERIC;
+    }
+    bitptr += a->len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The operations below produce exactly the same bits as set_bits()
+   and get_bits() do for the same attribute. */
+static void
+run_pack(const struct bitopt_program *p, uint8_t *hdrptr)
+{
+  const struct bitopt_op *op;
+  const uint8_t *val;
+  uint8_t buffer[2];
+  uint8_t *ptr;
+  int i;
+
+  for(op = p->ops; op < &p->ops[p->len]; ++op) {
+    ptr = &hdrptr[op->byteptr];
+    if(PACKETBUF_IS_ADDR(op->type)) {
+      val = (const uint8_t *)packetbuf_addr(op->type);
+    } else {
+      le16_write(buffer, packetbuf_attr(op->type));
+      val = buffer;
+    }
+    switch(op->kind) {
+    case OP_BITS:
+      ptr[0] |= val[0] << (8 - op->bitpos - op->len);
+      break;
+    case OP_SPLIT:
+      set_bits_in_byte(ptr, op->bitpos, val[0], op->len);
+      break;
+    case OP_BYTES:
+      if(op->bitpos == 0) {
+        memcpy(ptr, val, op->len / 8);
+      } else {
+        for(i = 0; i < op->len / 8; ++i) {
+          ptr[i] |= val[i] >> op->bitpos;
+          ptr[i + 1] |= val[i] << (8 - op->bitpos);
+        }
+      }
+      break;
+    default:
+      set_bits(ptr, op->bitpos, (uint8_t *)val, op->len);
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_unpack(const struct bitopt_program *p, uint8_t *hdrptr)
+{
+  const struct bitopt_op *op;
+  linkaddr_t addr;
+  uint8_t buffer[2];
+  uint8_t *ptr, *val;
+  int i;
+
+  for(op = p->ops; op < &p->ops[p->len]; ++op) {
+    ptr = &hdrptr[op->byteptr];
+    if(PACKETBUF_IS_ADDR(op->type)) {
+      val = (uint8_t *)&addr;
+    } else {
+      buffer[0] = buffer[1] = 0;
+      val = buffer;
+    }
+    switch(op->kind) {
+    case OP_BITS:
+      val[0] = (ptr[0] >> (8 - op->bitpos - op->len)) &
+        ((1 << op->len) - 1);
+      break;
+    case OP_SPLIT:
+      val[0] = get_bits_in_byte(ptr, op->bitpos, op->len);
+      break;
+    case OP_BYTES:
+      if(op->bitpos == 0) {
+        memcpy(val, ptr, op->len / 8);
+      } else {
+        for(i = 0; i < op->len / 8; ++i) {
+          val[i] = (ptr[i] << op->bitpos) | (ptr[i + 1] >> (8 - op->bitpos));
+        }
+      }
+      break;
+    default:
+      get_bits(val, ptr, op->bitpos, op->len);
+      break;
+    }
+    if(PACKETBUF_IS_ADDR(op->type)) {
+      packetbuf_set_addr(op->type, &addr);
+    } else {
+      packetbuf_set_attr(op->type, le16_read(buffer));
+    }
+  }
+}
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
+/*---------------------------------------------------------------------------*/
 #if 0
 static void
 printbin(int n, int digits)
@@ -259,6 +468,9 @@ pack_header(struct channel *c)
   int byteptr, bitptr, len;
   uint8_t *hdrptr;
   struct bitopt_hdr *hdr;
+#if CHAMELEON_BITOPT_PROGRAMS
+  struct bitopt_program *p;
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
   
   /* Compute the total size of the final header by summing the size of
      all attributes that are used on this channel. */
@@ -274,6 +486,14 @@ pack_header(struct channel *c)
 
   hdrptr = ((uint8_t *)packetbuf_hdrptr()) + sizeof(struct bitopt_hdr);
   memset(hdrptr, 0, hdrbytesize);
+
+#if CHAMELEON_BITOPT_PROGRAMS
+  p = lookup_program(c->attrlist);
+  if(p != NULL) {
+    run_pack(p, hdrptr);
+    return 1; /* Send out packet */
+  }
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
   
   byteptr = bitptr = 0;
   
@@ -325,6 +545,9 @@ unpack_header(void)
   uint8_t *hdrptr;
   struct bitopt_hdr *hdr;
   struct channel *c;
+#if CHAMELEON_BITOPT_PROGRAMS
+  struct bitopt_program *p;
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
   
 
   /* The packet has a header that tells us what channel the packet is
@@ -347,6 +570,15 @@ unpack_header(void)
     PRINTF("chameleon-bitopt: too short packet\n");
     return NULL;
   }
+
+#if CHAMELEON_BITOPT_PROGRAMS
+  p = lookup_program(c->attrlist);
+  if(p != NULL) {
+    run_unpack(p, hdrptr);
+    return c;
+  }
+#endif /* CHAMELEON_BITOPT_PROGRAMS */
+
   byteptr = bitptr = 0;
   for(a = c->attrlist; a->type != PACKETBUF_ATTR_NONE; ++a) {
 #if CHAMELEON_WITH_MAC_LINK_ADDRESSES
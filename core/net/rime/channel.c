@@ -41,13 +41,34 @@
 #include "net/rime/rime.h"
 #include "lib/list.h"
 
-LIST(channel_list);
+/* Open channels are kept in a hash table indexed by channel number,
+   so that incoming packets do not have to search all open channels.
+   Channels are usually numbered consecutively, so their low bits
+   spread them evenly across the buckets. */
+#ifdef CHANNEL_CONF_HASH
+#define CHANNEL_HASH CHANNEL_CONF_HASH
+#else /* CHANNEL_CONF_HASH */
+#define CHANNEL_HASH 8
+#endif /* CHANNEL_CONF_HASH */
+
+#define BUCKET(channelno) ((list_t)&channel_buckets[(channelno) % CHANNEL_HASH])
+
+static void *channel_buckets[CHANNEL_HASH];
+
+/* The channel found by the last lookup. Consecutive packets are
+   often received on the same channel. */
+static struct channel *last_channel;
 
 /*---------------------------------------------------------------------------*/
 void
 channel_init(void)
 {
-  list_init(channel_list);
+  int i;
+
+  for(i = 0; i < CHANNEL_HASH; i++) {
+    list_init(BUCKET(i));
+  }
+  last_channel = NULL;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -65,22 +86,35 @@ channel_set_attributes(uint16_t channelno,
 void
 channel_open(struct channel *c, uint16_t channelno)
 {
+  /* The channel may already be open, possibly with another number. */
+  list_remove(BUCKET(c->channelno), c);
+  if(c == last_channel) {
+    last_channel = NULL;
+  }
   c->channelno = channelno;
-  list_add(channel_list, c);
+  list_add(BUCKET(channelno), c);
 }
 /*---------------------------------------------------------------------------*/
 void
 channel_close(struct channel *c)
 {
-  list_remove(channel_list, c);
+  list_remove(BUCKET(c->channelno), c);
+  if(c == last_channel) {
+    last_channel = NULL;
+  }
 }
 /*---------------------------------------------------------------------------*/
 struct channel *
 channel_lookup(uint16_t channelno)
 {
   struct channel *c;
-  for(c = list_head(channel_list); c != NULL; c = list_item_next(c)) {
+
+  if(last_channel != NULL && last_channel->channelno == channelno) {
+    return last_channel;
+  }
+  for(c = list_head(BUCKET(channelno)); c != NULL; c = list_item_next(c)) {
     if(c->channelno == channelno) {
+      last_channel = c;
       return c;
     }
   }
@@ -90,6 +90,31 @@ struct data_msg_hdr {
   uint16_t rtmetric;
 };
 
+#define DATA_FLAGS_AGGREGATED           0x01
+
+#if COLLECT_AGGREGATION
+/* An aggregated data packet has the DATA_FLAGS_AGGREGATED flag set
+   and carries a sequence of records after the data header, one for
+   each originated packet. The record header holds the fields that
+   otherwise travel as packet attributes, and is followed by len
+   bytes of payload. */
+struct aggregate_hdr {
+  linkaddr_t originator;
+  uint8_t eseqno, hops, ttl, len;
+};
+
+/* The maximum number of record bytes that are placed in one
+   aggregated packet. The default leaves room for the 802.15.4,
+   ContikiMAC, and Rime headers in a 127 byte frame. */
+#ifdef COLLECT_CONF_AGGREGATION_MAX_LEN
+#define AGGREGATION_MAX_LEN COLLECT_CONF_AGGREGATION_MAX_LEN
+#else /* COLLECT_CONF_AGGREGATION_MAX_LEN */
+#define AGGREGATION_MAX_LEN 96
+#endif /* COLLECT_CONF_AGGREGATION_MAX_LEN */
+
+static uint8_t aggregate_buf[PACKETBUF_SIZE];
+#endif /* COLLECT_AGGREGATION */
+
 
 /* This is the header of ACK packets. It contains a flags field that
    indicates if the node is congested (ACK_FLAGS_CONGESTED), if the
@@ -206,6 +231,9 @@ struct {
   uint32_t ttldrop;
   uint32_t ackdrop;
   uint32_t timedout;
+
+  uint32_t aggregated;
+  uint32_t aggrecv;
 } stats;
 
 /* Debug definition: draw routing tree in Cooja. */
@@ -479,6 +507,7 @@ enqueue_dummy_packet(struct collect_conn *c, int rexmits)
 
   /* Allocate space for the header. */
   packetbuf_hdralloc(sizeof(struct data_msg_hdr));
+  memset(packetbuf_hdrptr(), 0, sizeof(struct data_msg_hdr));
 
   n = collect_neighbor_list_find(&c->neighbor_list, &c->parent);
   if(n != NULL) {
@@ -645,6 +674,9 @@ send_queued_packet(struct collect_conn *c)
          packet. */
       memset(&hdr, 0, sizeof(hdr));
       hdr.rtmetric = c->rtmetric;
+#if COLLECT_AGGREGATION
+      hdr.flags = *(uint8_t *)packetbuf_dataptr() & DATA_FLAGS_AGGREGATED;
+#endif /* COLLECT_AGGREGATION */
       memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
 
       /* Send the packet. */
@@ -746,6 +778,9 @@ retransmit_current_packet(struct collect_conn *c)
          packet. */
       memset(&hdr, 0, sizeof(hdr));
       hdr.rtmetric = c->rtmetric;
+#if COLLECT_AGGREGATION
+      hdr.flags = *(uint8_t *)packetbuf_dataptr() & DATA_FLAGS_AGGREGATED;
+#endif /* COLLECT_AGGREGATION */
       memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
 
       /* Send the packet. */
@@ -904,6 +939,16 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
 }
 /*---------------------------------------------------------------------------*/
 static void
+add_to_recent_packets(struct collect_conn *tc, const linkaddr_t *originator,
+                      uint8_t eseqno)
+{
+  recent_packets[recent_packet_ptr].eseqno = eseqno;
+  linkaddr_copy(&recent_packets[recent_packet_ptr].originator, originator);
+  recent_packets[recent_packet_ptr].conn = tc;
+  recent_packet_ptr = (recent_packet_ptr + 1) % NUM_RECENT_PACKETS;
+}
+/*---------------------------------------------------------------------------*/
+static void
 add_packet_to_recent_packets(struct collect_conn *tc)
 {
   /* Remember that we have seen this packet for later, but only if
@@ -911,15 +956,289 @@ add_packet_to_recent_packets(struct collect_conn *tc)
      zero are keepalive or proactive link estimate probes, so we do
      not record them in our history. */
   if(packetbuf_datalen() > sizeof(struct data_msg_hdr)) {
-    recent_packets[recent_packet_ptr].eseqno =
-      packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
-    linkaddr_copy(&recent_packets[recent_packet_ptr].originator,
-                  packetbuf_addr(PACKETBUF_ADDR_ESENDER));
-    recent_packets[recent_packet_ptr].conn = tc;
-    recent_packet_ptr = (recent_packet_ptr + 1) % NUM_RECENT_PACKETS;
+    add_to_recent_packets(tc, packetbuf_addr(PACKETBUF_ADDR_ESENDER),
+                          packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID));
   }
 }
 /*---------------------------------------------------------------------------*/
+#if COLLECT_AGGREGATION
+static int
+is_recent_packet(struct collect_conn *tc, const linkaddr_t *originator,
+                 uint8_t eseqno)
+{
+  int i;
+
+  for(i = 0; i < NUM_RECENT_PACKETS; i++) {
+    if(recent_packets[i].conn == tc &&
+       recent_packets[i].eseqno == eseqno &&
+       linkaddr_cmp(&recent_packets[i].originator, originator)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_records_to_recent_packets(struct collect_conn *tc,
+                              const uint8_t *records, int len)
+{
+  struct aggregate_hdr ahdr;
+  int i;
+
+  for(i = 0; i < len; i += sizeof(struct aggregate_hdr) + ahdr.len) {
+    memcpy(&ahdr, &records[i], sizeof(struct aggregate_hdr));
+    add_to_recent_packets(tc, &ahdr.originator, ahdr.eseqno);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function writes the records of a queued data packet to buf
+ * and returns their length. A packet that is not aggregated becomes
+ * a single record. If buf is NULL, only the length is returned.
+ *
+ */
+static int
+queuebuf_to_records(struct queuebuf *q, uint8_t *buf)
+{
+  struct data_msg_hdr hdr;
+  struct aggregate_hdr ahdr;
+  uint8_t *data;
+  int len;
+
+  data = queuebuf_dataptr(q);
+  len = queuebuf_datalen(q) - sizeof(struct data_msg_hdr);
+  memcpy(&hdr, data, sizeof(struct data_msg_hdr));
+  data += sizeof(struct data_msg_hdr);
+
+  if(hdr.flags & DATA_FLAGS_AGGREGATED) {
+    if(buf != NULL) {
+      memcpy(buf, data, len);
+    }
+    return len;
+  }
+
+  if(buf != NULL) {
+    linkaddr_copy(&ahdr.originator,
+                  queuebuf_addr(q, PACKETBUF_ADDR_ESENDER));
+    ahdr.eseqno = queuebuf_attr(q, PACKETBUF_ATTR_EPACKET_ID);
+    ahdr.hops = queuebuf_attr(q, PACKETBUF_ATTR_HOPS);
+    ahdr.ttl = queuebuf_attr(q, PACKETBUF_ATTR_TTL);
+    ahdr.len = len;
+    memcpy(buf, &ahdr, sizeof(struct aggregate_hdr));
+    memcpy(buf + sizeof(struct aggregate_hdr), data, len);
+  }
+  return sizeof(struct aggregate_hdr) + len;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * This function tries to merge the data packet in the packetbuf into
+ * the last packet on the send queue, so that both are sent to the
+ * parent in one transmission. The last packet is only extended if it
+ * is not being transmitted, if it is not a probe, and if the records
+ * of both packets fit within AGGREGATION_MAX_LEN. The packetbuf is
+ * left unchanged.
+ *
+ */
+static int
+aggregate_packetbuf(struct collect_conn *tc)
+{
+  struct packetqueue_item *i;
+  struct queuebuf *last, *q;
+  struct data_msg_hdr hdr;
+  uint8_t *records;
+  int len;
+
+  i = list_tail(tc->send_queue_list);
+  if(i == NULL ||
+     (tc->sending && i == packetqueue_first(&tc->send_queue))) {
+    return 0;
+  }
+
+  last = packetqueue_queuebuf(i);
+  if(queuebuf_datalen(last) <= sizeof(struct data_msg_hdr)) {
+    return 0;
+  }
+
+  /* We keep a copy of the packetbuf, both to read its records and
+     to restore it when we are done. The data header of an originated
+     packet is still in the header area of the packetbuf, so only the
+     copy tells how long the packet is. */
+  q = queuebuf_new_from_packetbuf();
+  if(q == NULL) {
+    return 0;
+  }
+  if(queuebuf_datalen(q) <= sizeof(struct data_msg_hdr)) {
+    queuebuf_free(q);
+    return 0;
+  }
+
+  len = queuebuf_to_records(last, NULL) + queuebuf_to_records(q, NULL);
+  if(len > AGGREGATION_MAX_LEN ||
+     len > PACKETBUF_SIZE - sizeof(struct data_msg_hdr)) {
+    queuebuf_free(q);
+    return 0;
+  }
+
+  /* Rewrite the last packet as an aggregated packet with the records
+     of both packets. The aggregated packet is retransmitted as many
+     times as the packet that allows the most retransmissions. */
+  queuebuf_to_packetbuf(last);
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.flags = DATA_FLAGS_AGGREGATED;
+  memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_msg_hdr));
+  records = (uint8_t *)packetbuf_dataptr() + sizeof(struct data_msg_hdr);
+  len = queuebuf_to_records(last, records);
+  len += queuebuf_to_records(q, records + len);
+  packetbuf_set_datalen(sizeof(struct data_msg_hdr) + len);
+  if(queuebuf_attr(q, PACKETBUF_ATTR_MAX_REXMIT) >
+     packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT)) {
+    packetbuf_set_attr(PACKETBUF_ATTR_MAX_REXMIT,
+                       queuebuf_attr(q, PACKETBUF_ATTR_MAX_REXMIT));
+  }
+  queuebuf_update_from_packetbuf(last);
+
+  queuebuf_to_packetbuf(q);
+  queuebuf_free(q);
+
+  PRINTF("%d.%d: aggregated packet, %d bytes of records\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], len);
+  stats.aggregated++;
+  return 1;
+}
+#endif /* COLLECT_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+/**
+ * This function puts the packet in the packetbuf on the send
+ * queue. With aggregation, the packet is merged into the last queued
+ * packet if possible. Otherwise, it is only queued if there are no
+ * more than max_queue_len packets on the queue.
+ *
+ */
+static int
+enqueue_packetbuf(struct collect_conn *tc, int max_queue_len)
+{
+#if COLLECT_AGGREGATION
+  if(aggregate_packetbuf(tc)) {
+    return 1;
+  }
+#endif /* COLLECT_AGGREGATION */
+  if(packetqueue_len(&tc->send_queue) > max_queue_len) {
+    return 0;
+  }
+  return packetqueue_enqueue_packetbuf(&tc->send_queue,
+                                       FORWARD_PACKET_LIFETIME_BASE *
+                                       packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT),
+                                       tc);
+}
+/*---------------------------------------------------------------------------*/
+#if COLLECT_AGGREGATION
+/**
+ * This function is called when an aggregated data packet is
+ * received. Records that we have recently seen and records whose TTL
+ * has expired are removed from the packet. The sink then passes each
+ * remaining record to the receive function, while other nodes queue
+ * the packet for their parent.
+ *
+ */
+static void
+aggregate_received(struct collect_conn *tc, const linkaddr_t *ack_to,
+                   uint8_t ackflags, uint16_t rtmetric)
+{
+  struct aggregate_hdr ahdr;
+  linkaddr_t sender;
+  uint8_t *records;
+  int in, out, len, reclen, expired;
+
+  stats.aggrecv++;
+
+  records = (uint8_t *)packetbuf_dataptr() + sizeof(struct data_msg_hdr);
+  len = packetbuf_datalen() - sizeof(struct data_msg_hdr);
+  expired = 0;
+  out = 0;
+  for(in = 0; in + (int)sizeof(struct aggregate_hdr) <= len; in += reclen) {
+    memcpy(&ahdr, &records[in], sizeof(struct aggregate_hdr));
+    reclen = sizeof(struct aggregate_hdr) + ahdr.len;
+    if(in + reclen > len) {
+      break;
+    }
+    if(is_recent_packet(tc, &ahdr.originator, ahdr.eseqno)) {
+      stats.duprecv++;
+      continue;
+    }
+    if(tc->rtmetric != RTMETRIC_SINK) {
+      if(ahdr.ttl <= 1) {
+        stats.ttldrop++;
+        expired = 1;
+        continue;
+      }
+      ahdr.hops++;
+      ahdr.ttl--;
+    }
+    memcpy(&records[out], &ahdr, sizeof(struct aggregate_hdr));
+    memmove(&records[out + sizeof(struct aggregate_hdr)],
+            &records[in + sizeof(struct aggregate_hdr)], ahdr.len);
+    out += reclen;
+  }
+
+  if(out == 0) {
+    /* All records were duplicates or had expired, so there is
+       nothing left to deliver or forward. */
+    if(expired) {
+      ackflags |= ACK_FLAGS_DROPPED | ACK_FLAGS_LIFETIME_EXCEEDED;
+    }
+    send_ack(tc, ack_to, ackflags);
+    return;
+  }
+
+  if(tc->rtmetric == RTMETRIC_SINK) {
+    /* The ACK overwrites the packetbuf, so we keep the records in a
+       separate buffer while passing them up one at a time. */
+    memcpy(aggregate_buf, records, out);
+    linkaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+    add_records_to_recent_packets(tc, aggregate_buf, out);
+    send_ack(tc, ack_to, 0);
+
+    for(in = 0; in < out; in += sizeof(struct aggregate_hdr) + ahdr.len) {
+      memcpy(&ahdr, &aggregate_buf[in], sizeof(struct aggregate_hdr));
+      packetbuf_copyfrom(&aggregate_buf[in + sizeof(struct aggregate_hdr)],
+                         ahdr.len);
+      packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+      packetbuf_set_addr(PACKETBUF_ADDR_ESENDER, &ahdr.originator);
+      packetbuf_set_attr(PACKETBUF_ATTR_EPACKET_ID, ahdr.eseqno);
+      packetbuf_set_attr(PACKETBUF_ATTR_HOPS, ahdr.hops);
+
+      PRINTF("%d.%d: sink received aggregated packet %d from %d.%d via %d.%d\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+             ahdr.eseqno,
+             ahdr.originator.u8[0], ahdr.originator.u8[1],
+             sender.u8[0], sender.u8[1]);
+
+      if(ahdr.len > 0 && tc->cb->recv != NULL) {
+        tc->cb->recv(&ahdr.originator, ahdr.eseqno, ahdr.hops);
+      }
+    }
+  } else if(tc->rtmetric != RTMETRIC_MAX) {
+    if(rtmetric <= tc->rtmetric) {
+      ackflags |= ACK_FLAGS_RTMETRIC_NEEDS_UPDATE;
+    }
+
+    packetbuf_set_datalen(sizeof(struct data_msg_hdr) + out);
+    if(enqueue_packetbuf(tc, MAX_SENDING_QUEUE - MIN_AVAILABLE_QUEUE_ENTRIES)) {
+      records = (uint8_t *)packetbuf_dataptr() + sizeof(struct data_msg_hdr);
+      add_records_to_recent_packets(tc, records, out);
+      send_ack(tc, ack_to, ackflags);
+      send_queued_packet(tc);
+    } else {
+      send_ack(tc, ack_to,
+               ackflags | ACK_FLAGS_DROPPED | ACK_FLAGS_CONGESTED);
+      PRINTF("%d.%d: aggregated packet dropped: no queue buffer available\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+      stats.qdrop++;
+    }
+  }
+}
+#endif /* COLLECT_AGGREGATION */
+/*---------------------------------------------------------------------------*/
 static void
 node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
 {
@@ -972,6 +1291,15 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
       ackflags |= ACK_FLAGS_CONGESTED;
     }
 
+#if COLLECT_AGGREGATION
+    /* Aggregated packets carry their own duplicate and TTL
+       information in each record. */
+    if(hdr.flags & DATA_FLAGS_AGGREGATED) {
+      aggregate_received(tc, &ack_to, ackflags, hdr.rtmetric);
+      return;
+    }
+#endif /* COLLECT_AGGREGATION */
+
     for(i = 0; i < NUM_RECENT_PACKETS; i++) {
       if(recent_packets[i].conn == tc &&
          recent_packets[i].eseqno == packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID) &&
@@ -1063,11 +1391,7 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
          memory problems. We first check the size of our sending queue
          to ensure that we always have entries for packets that
          are originated by this node. */
-      if(packetqueue_len(&tc->send_queue) <= MAX_SENDING_QUEUE - MIN_AVAILABLE_QUEUE_ENTRIES &&
-         packetqueue_enqueue_packetbuf(&tc->send_queue,
-                                       FORWARD_PACKET_LIFETIME_BASE *
-                                       packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT),
-                                       tc)) {
+      if(enqueue_packetbuf(tc, MAX_SENDING_QUEUE - MIN_AVAILABLE_QUEUE_ENTRIES)) {
         add_packet_to_recent_packets(tc);
         send_ack(tc, &ack_to, ackflags);
         send_queued_packet(tc);
@@ -1466,11 +1790,9 @@ collect_send(struct collect_conn *tc, int rexmits)
 
     /* Allocate space for the header. */
     packetbuf_hdralloc(sizeof(struct data_msg_hdr));
+    memset(packetbuf_hdrptr(), 0, sizeof(struct data_msg_hdr));
 
-    if(packetqueue_enqueue_packetbuf(&tc->send_queue,
-                                     FORWARD_PACKET_LIFETIME_BASE *
-                                     packetbuf_attr(PACKETBUF_ATTR_MAX_REXMIT),
-                                     tc)) {
+    if(enqueue_packetbuf(tc, MAX_SENDING_QUEUE)) {
       send_queued_packet(tc);
       ret = 1;
     } else {
@@ -1547,12 +1869,12 @@ collect_purge(struct collect_conn *tc)
 void
 collect_print_stats(void)
 {
-  PRINTF("collect stats foundroute %lu newparent %lu routelost %lu acksent %lu datasent %lu datarecv %lu ackrecv %lu badack %lu duprecv %lu qdrop %lu rtdrop %lu ttldrop %lu ackdrop %lu timedout %lu\n",
+  PRINTF("collect stats foundroute %lu newparent %lu routelost %lu acksent %lu datasent %lu datarecv %lu ackrecv %lu badack %lu duprecv %lu qdrop %lu rtdrop %lu ttldrop %lu ackdrop %lu timedout %lu aggregated %lu aggrecv %lu\n",
          stats.foundroute, stats.newparent, stats.routelost,
          stats.acksent, stats.datasent, stats.datarecv,
          stats.ackrecv, stats.badack, stats.duprecv,
          stats.qdrop, stats.rtdrop, stats.ttldrop, stats.ackdrop,
-         stats.timedout);
+         stats.timedout, stats.aggregated, stats.aggrecv);
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
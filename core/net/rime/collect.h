@@ -114,6 +114,17 @@ struct collect_callbacks {
 #define COLLECT_ANNOUNCEMENTS COLLECT_CONF_ANNOUNCEMENTS
 #endif /* COLLECT_CONF_ANNOUNCEMENTS */
 
+/* COLLECT_CONF_AGGREGATION defines if forwarding nodes should merge
+   data packets that wait in their send queue into a single frame to
+   their parent. Aggregated frames can only be parsed by nodes that
+   have aggregation enabled, so all nodes in a network must use the
+   same setting. */
+#ifdef COLLECT_CONF_AGGREGATION
+#define COLLECT_AGGREGATION COLLECT_CONF_AGGREGATION
+#else /* COLLECT_CONF_AGGREGATION */
+#define COLLECT_AGGREGATION 0
+#endif /* COLLECT_CONF_AGGREGATION */
+
 struct collect_conn {
   struct unicast_conn unicast_conn;
 #if ! COLLECT_ANNOUNCEMENTS
@@ -93,15 +93,30 @@ data_packet_forward(struct multihop_conn *multihop,
 
   rt = route_lookup(dest);
   if(rt == NULL) {
-    if(c->queued_data != NULL) {
-      queuebuf_free(c->queued_data);
+    struct queuebuf *q;
+
+    /* Sending the route request overwrites the packetbuf, so the
+       packet is copied first. The packet that is already queued is
+       only replaced if the route discovery is started. */
+    q = queuebuf_new_from_packetbuf();
+    if(route_discovery_discover(&c->route_discovery_conn, dest,
+                                PACKET_TIMEOUT)) {
+      PRINTF("data_packet_forward: queueing data, sending rreq\n");
+      if(c->queued_data != NULL) {
+        queuebuf_free(c->queued_data);
+      }
+      c->queued_data = q;
+      linkaddr_copy(&c->queued_data_dest, dest);
+    } else {
+      /* Another destination is being discovered, or this one has
+         recently failed: drop the packet rather than waiting for a
+         reply that will not come. */
+      PRINTF("data_packet_forward: no route discovery, dropping data\n");
+      if(q != NULL) {
+        queuebuf_free(q);
+      }
     }
 
-    PRINTF("data_packet_forward: queueing data, sending rreq\n");
-    c->queued_data = queuebuf_new_from_packetbuf();
-    linkaddr_copy(&c->queued_data_dest, dest);
-    route_discovery_discover(&c->route_discovery_conn, dest, PACKET_TIMEOUT);
-
     return NULL;
   } else {
     route_refresh(rt);
@@ -60,6 +60,10 @@
 
 #include "lib/list.h"
 
+#if RIME_WITH_LINK_STATS
+#include "net/link-stats.h"
+#endif /* RIME_WITH_LINK_STATS */
+
 #ifdef RIME_CONF_BROADCAST_ANNOUNCEMENT_CHANNEL
 #define BROADCAST_ANNOUNCEMENT_CHANNEL RIME_CONF_BROADCAST_ANNOUNCEMENT_CHANNEL
 #else /* RIME_CONF_BROADCAST_ANNOUNCEMENT_CHANNEL */
@@ -107,6 +111,9 @@ input(void)
   struct channel *c;
 
   RIMESTATS_ADD(rx);
+#if RIME_WITH_LINK_STATS
+  link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
+#endif /* RIME_WITH_LINK_STATS */
   c = chameleon_parse();
   
   for(s = list_head(sniffers); s != NULL; s = list_item_next(s)) {
@@ -126,6 +133,9 @@ init(void)
   queuebuf_init();
   packetbuf_clear();
   announcement_init();
+#if RIME_WITH_LINK_STATS
+  link_stats_init();
+#endif /* RIME_WITH_LINK_STATS */
 
   chameleon_init();
   
@@ -163,6 +173,11 @@ packet_sent(void *ptr, int status, int num_tx)
     PRINTF("rime: error %d after %d tx\n", status, num_tx);
   }
 
+#if RIME_WITH_LINK_STATS
+  link_stats_packet_sent(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), status,
+                         num_tx);
+#endif /* RIME_WITH_LINK_STATS */
+
   /* Call sniffers, pass along the MAC status code. */
   for(s = list_head(sniffers); s != NULL; s = list_item_next(s)) {
     if(s->output_callback != NULL) {
@@ -65,8 +65,18 @@
 #include "net/rime/runicast.h"
 #include "net/rime/timesynch.h"
 #include "net/rime/trickle.h"
+#include "net/rime/wrucb.h"
 
 #include "net/mac/mac.h"
+
+/* Keep link-stats (ETX and RSSI per neighbor) for Rime packets. The
+   wrucb module uses it to space its transmissions. */
+#ifdef RIME_CONF_WITH_LINK_STATS
+#define RIME_WITH_LINK_STATS RIME_CONF_WITH_LINK_STATS
+#else /* RIME_CONF_WITH_LINK_STATS */
+#define RIME_WITH_LINK_STATS 0
+#endif /* RIME_CONF_WITH_LINK_STATS */
+
 /**
  * \brief      Initialize Rime
  *
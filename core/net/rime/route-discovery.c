@@ -78,6 +78,61 @@ struct rrep_hdr {
 
 /*---------------------------------------------------------------------------*/
 static char rrep_pending;		/* A reply for a request is pending. */
+static struct route_discovery_conn *pending_conn;
+static linkaddr_t pending_dest;
+static clock_time_t pending_timeout;
+
+/* Destinations whose discovery timed out */
+struct backoff {
+  linkaddr_t dest;
+  struct timer hold;
+  uint8_t failures;
+};
+static struct backoff backoffs[ROUTE_DISCOVERY_ENTRIES];
+/*---------------------------------------------------------------------------*/
+static struct backoff *
+backoff_lookup(const linkaddr_t *dest)
+{
+  int i;
+
+  for(i = 0; i < ROUTE_DISCOVERY_ENTRIES; i++) {
+    if(backoffs[i].failures > 0 && linkaddr_cmp(&backoffs[i].dest, dest)) {
+      return &backoffs[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+backoff_failed(const linkaddr_t *dest, clock_time_t timeout)
+{
+  struct backoff *b, *e;
+  int i;
+
+  b = backoff_lookup(dest);
+  if(b == NULL) {
+    /* Take a free entry, or the one whose hold-down ends first */
+    for(i = 0; i < ROUTE_DISCOVERY_ENTRIES; i++) {
+      e = &backoffs[i];
+      if(e->failures == 0 || timer_expired(&e->hold)) {
+        b = e;
+        break;
+      }
+      if(b == NULL || timer_remaining(&e->hold) < timer_remaining(&b->hold)) {
+        b = e;
+      }
+    }
+    linkaddr_copy(&b->dest, dest);
+    b->failures = 0;
+  }
+  if(b->failures <= ROUTE_DISCOVERY_MAX_BACKOFF) {
+    b->failures++;
+  }
+  timer_set(&b->hold, timeout << (b->failures - 1));
+  PRINTF("route_discovery: holding down %d.%d for %lu ticks\n",
+         dest->u8[0], dest->u8[1],
+         (unsigned long)(timeout << (b->failures - 1)));
+}
 /*---------------------------------------------------------------------------*/
 static void
 send_rreq(struct route_discovery_conn *c, const linkaddr_t *dest)
@@ -164,6 +219,7 @@ rrep_packet_received(struct unicast_conn *uc, const linkaddr_t *from)
 {
   struct rrep_hdr *msg = packetbuf_dataptr();
   struct route_entry *rt;
+  struct backoff *b;
   linkaddr_t dest;
   struct route_discovery_conn *c = (struct route_discovery_conn *)
     ((char *)uc - offsetof(struct route_discovery_conn, rrepconn));
@@ -186,6 +242,10 @@ rrep_packet_received(struct unicast_conn *uc, const linkaddr_t *from)
     PRINTF("rrep for us!\n");
     rrep_pending = 0;
     ctimer_stop(&c->t);
+    b = backoff_lookup(&msg->originator);
+    if(b != NULL) {
+      b->failures = 0;
+    }
     if(c->cb->new_route) {
       linkaddr_t originator;
 
@@ -287,6 +347,9 @@ route_discovery_close(struct route_discovery_conn *c)
   unicast_close(&c->rrepconn);
   netflood_close(&c->rreqconn);
   ctimer_stop(&c->t);
+  if(rrep_pending && pending_conn == c) {
+    rrep_pending = 0;
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -295,6 +358,7 @@ timeout_handler(void *ptr)
   struct route_discovery_conn *c = ptr;
   PRINTF("route_discovery: timeout, timed out\n");
   rrep_pending = 0;
+  backoff_failed(&pending_dest, pending_timeout);
   if(c->cb->timedout) {
     c->cb->timedout(c);
   }
@@ -304,14 +368,29 @@ int
 route_discovery_discover(struct route_discovery_conn *c, const linkaddr_t *addr,
 			 clock_time_t timeout)
 {
+  struct backoff *b;
+
   if(rrep_pending) {
+    if(c == pending_conn && linkaddr_cmp(addr, &pending_dest)) {
+      PRINTF("route_discovery_send: joining pending request\n");
+      return 1;
+    }
     PRINTF("route_discovery_send: ignoring request because of pending response\n");
     return 0;
   }
 
+  b = backoff_lookup(addr);
+  if(b != NULL && !timer_expired(&b->hold)) {
+    PRINTF("route_discovery_send: ignoring request during hold-down\n");
+    return 0;
+  }
+
   PRINTF("route_discovery_send: sending route request\n");
   ctimer_set(&c->t, timeout, timeout_handler, c);
   rrep_pending = 1;
+  pending_conn = c;
+  linkaddr_copy(&pending_dest, addr);
+  pending_timeout = timeout;
   send_rreq(c, addr);
   return 1;
 }
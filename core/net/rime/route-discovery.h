@@ -46,7 +46,12 @@
  * \defgroup routediscovery Rime route discovery protocol
  * @{
  *
- * The route-discovery module does route discovery for Rime.
+ * The route-discovery module does route discovery for Rime. Only
+ * one discovery is in progress at a time. Asking again for the
+ * destination that is being discovered joins the discovery in
+ * progress. A destination whose discovery timed out is not asked for
+ * again until a hold-down time has passed, which doubles with every
+ * further timeout.
  *
  * \section route-discovery-channels Channels
  *
@@ -68,8 +73,17 @@ struct route_discovery_callbacks {
   void (* timedout)(struct route_discovery_conn *c);
 };
 
+/* Number of destinations whose failed discoveries are remembered */
 #define ROUTE_DISCOVERY_ENTRIES 8
 
+/* The hold-down time after a timed out discovery is the discovery
+   timeout doubled up to this many times */
+#ifdef ROUTE_DISCOVERY_CONF_MAX_BACKOFF
+#define ROUTE_DISCOVERY_MAX_BACKOFF ROUTE_DISCOVERY_CONF_MAX_BACKOFF
+#else
+#define ROUTE_DISCOVERY_MAX_BACKOFF 3
+#endif
+
 struct route_discovery_conn {
   struct netflood_conn rreqconn;
   struct unicast_conn rrepconn;
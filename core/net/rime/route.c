@@ -43,6 +43,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "lib/list.h"
 #include "lib/memb.h"
@@ -68,12 +69,25 @@
 #define DEFAULT_LIFETIME 60
 #endif /* ROUTE_CONF_DEFAULT_LIFETIME */
 
+#ifdef ROUTE_CONF_HASH
+#define ROUTE_HASH ROUTE_CONF_HASH
+#else /* ROUTE_CONF_HASH */
+#define ROUTE_HASH 4
+#endif /* ROUTE_CONF_HASH */
+
 /*
- * List of route entries.
+ * List of route entries, most recently added or refreshed first.
  */
 LIST(route_table);
 MEMB(route_mem, struct route_entry, NUM_RT_ENTRIES);
 
+/*
+ * Route entries by destination, chained through hash_next.
+ */
+static struct route_entry *route_hash[ROUTE_HASH];
+
+struct route_stats route_stats;
+
 static struct ctimer t;
 
 static int max_time = DEFAULT_LIFETIME;
@@ -86,22 +100,50 @@ static int max_time = DEFAULT_LIFETIME;
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static struct route_entry **
+bucket(const linkaddr_t *dest)
+{
+  uint8_t h;
+  int i;
 
+  h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h ^= dest->u8[i];
+  }
+  return &route_hash[h % ROUTE_HASH];
+}
+/*---------------------------------------------------------------------------*/
+static void
+unlink_entry(struct route_entry *e)
+{
+  struct route_entry **p;
+
+  for(p = bucket(&e->dest); *p != NULL; p = &(*p)->hash_next) {
+    if(*p == e) {
+      *p = e->hash_next;
+      break;
+    }
+  }
+  list_remove(route_table, e);
+}
 /*---------------------------------------------------------------------------*/
 static void
 periodic(void *ptr)
 {
-  struct route_entry *e;
+  struct route_entry *e, *next;
 
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
+  for(e = list_head(route_table); e != NULL; e = next) {
+    next = list_item_next(e);
     e->time++;
     if(e->time >= max_time) {
       PRINTF("route periodic: removing entry to %d.%d with nexthop %d.%d and cost %d\n",
 	     e->dest.u8[0], e->dest.u8[1],
 	     e->nexthop.u8[0], e->nexthop.u8[1],
 	     e->cost);
-      list_remove(route_table, e);
+      unlink_entry(e);
       memb_free(&route_mem, e);
+      route_stats.expired++;
     }
   }
 
@@ -113,6 +155,8 @@ route_init(void)
 {
   list_init(route_table);
   memb_init(&route_mem);
+  memset(route_hash, 0, sizeof(route_hash));
+  memset(&route_stats, 0, sizeof(route_stats));
 
   ctimer_set(&t, CLOCK_SECOND, periodic, NULL);
 }
@@ -121,29 +165,31 @@ int
 route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
 	  uint8_t cost, uint8_t seqno)
 {
-  struct route_entry *e, *oldest = NULL;
+  struct route_entry *e, **b;
 
   /* Avoid inserting duplicate entries. */
-  e = route_lookup(dest);
-  if(e != NULL && linkaddr_cmp(&e->nexthop, nexthop)) {
-    list_remove(route_table, e);
+  b = bucket(dest);
+  for(e = *b; e != NULL; e = e->hash_next) {
+    if(linkaddr_cmp(&e->dest, dest) && linkaddr_cmp(&e->nexthop, nexthop)) {
+      break;
+    }
+  }
+  if(e != NULL) {
+    unlink_entry(e);
   } else {
-    /* Allocate a new entry or reuse the oldest entry with highest cost. */
+    /* Allocate a new entry or reuse the least recently used one. */
     e = memb_alloc(&route_mem);
     if(e == NULL) {
-      /* Remove oldest entry. */
-      for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
-        if(oldest == NULL || e->time >= oldest->time) {
-          oldest = e;
-        }
-      }
-      e = oldest;
-      list_remove(route_table, e);
+      e = list_tail(route_table);
+      unlink_entry(e);
+      route_stats.evicted++;
       PRINTF("route_add: removing entry to %d.%d with nexthop %d.%d and cost %d\n",
 	     e->dest.u8[0], e->dest.u8[1],
 	     e->nexthop.u8[0], e->nexthop.u8[1],
 	     e->cost);
     }
+    e->uses = 0;
+    route_stats.added++;
   }
 
   linkaddr_copy(&e->dest, dest);
@@ -155,6 +201,8 @@ route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
 
   /* New entry goes first. */
   list_push(route_table, e);
+  e->hash_next = *b;
+  *b = e;
 
   PRINTF("route_add: new entry to %d.%d with nexthop %d.%d and cost %d\n",
 	 e->dest.u8[0], e->dest.u8[1],
@@ -173,9 +221,10 @@ route_lookup(const linkaddr_t *dest)
 
   lowest_cost = -1;
   best_entry = NULL;
+  route_stats.lookups++;
   
   /* Find the route with the lowest cost. */
-  for(e = list_head(route_table); e != NULL; e = list_item_next(e)) {
+  for(e = *bucket(dest); e != NULL; e = e->hash_next) {
     /*    printf("route_lookup: comparing %d.%d.%d.%d with %d.%d.%d.%d\n",
 	   uip_ipaddr_to_quad(dest), uip_ipaddr_to_quad(&e->dest));*/
 
@@ -186,6 +235,9 @@ route_lookup(const linkaddr_t *dest)
       }
     }
   }
+  if(best_entry == NULL) {
+    route_stats.misses++;
+  }
   return best_entry;
 }
 /*---------------------------------------------------------------------------*/
@@ -197,6 +249,11 @@ route_refresh(struct route_entry *e)
        out. */
     e->time = 0;
     e->decay = 0;
+    e->uses++;
+
+    /* Keep the table in least recently used order. */
+    list_remove(route_table, e);
+    list_push(route_table, e);
     
     PRINTF("route_refresh: time %d last %d decay %d for entry to %d.%d with nexthop %d.%d and cost %d\n",
            e->time, e->time_last_decay, e->decay,
@@ -230,6 +287,7 @@ route_decay(struct route_entry *e)
 	     e->nexthop.u8[0], e->nexthop.u8[1],
 	     e->cost);
       route_remove(e);
+      route_stats.expired++;
     }
   }
 }
@@ -237,7 +295,7 @@ route_decay(struct route_entry *e)
 void
 route_remove(struct route_entry *e)
 {
-  list_remove(route_table, e);
+  unlink_entry(e);
   memb_free(&route_mem, e);
 }
 /*---------------------------------------------------------------------------*/
@@ -254,6 +312,7 @@ route_flush_all(void)
       break;
     }
   }
+  memset(route_hash, 0, sizeof(route_hash));
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -46,7 +46,10 @@
  * \defgroup rimeroute Rime route table
  * @{
  *
- * The route module handles the route table in Rime.
+ * The route module handles the route table in Rime. Routes are
+ * found through a hash of their destination, and when the table is
+ * full the route that was least recently added or refreshed is
+ * replaced.
  */
 
 #ifndef ROUTE_H_
@@ -56,6 +59,7 @@
 
 struct route_entry {
   struct route_entry *next;
+  struct route_entry *hash_next;
   linkaddr_t dest;
   linkaddr_t nexthop;
   uint8_t seqno;
@@ -64,8 +68,21 @@ struct route_entry {
 
   uint8_t decay;
   uint8_t time_last_decay;
+
+  /* Number of times the route has been refreshed by traffic */
+  uint16_t uses;
+};
+
+struct route_stats {
+  uint16_t lookups;  /* Calls to route_lookup() */
+  uint16_t misses;   /* Lookups that did not find a route */
+  uint16_t added;    /* New routes */
+  uint16_t evicted;  /* Routes replaced because the table was full */
+  uint16_t expired;  /* Routes removed by lifetime or decay */
 };
 
+extern struct route_stats route_stats;
+
 void route_init(void);
 int route_add(const linkaddr_t *dest, const linkaddr_t *nexthop,
 	      uint8_t cost, uint8_t seqno);
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Windowed reliable unicast bulk transfer
+ */
+
+/**
+ * \addtogroup wrucb
+ * @{
+ */
+
+#include "net/rime/wrucb.h"
+#include "net/rime/rime.h"
+#if RIME_WITH_LINK_STATS
+#include "net/link-stats.h"
+#endif /* RIME_WITH_LINK_STATS */
+#include "lib/random.h"
+#include <string.h>
+
+/* Time without progress after which the missing chunks of the
+   window are sent again, doubled for every further timeout */
+#define REXMIT_TIME (CLOCK_SECOND / 2)
+#define MAX_TIMEOUTS 8
+
+/* Extra time between two transmissions for every expected
+   retransmission on the link */
+#define SPACING (CLOCK_SECOND / 16)
+
+/* Time after which a transfer that has not received any chunk may be
+   replaced by a transfer from another sender */
+#define RX_TIMEOUT (CLOCK_SECOND * 8)
+
+#define LAST_UNKNOWN 0xffff
+
+struct data_hdr {
+  uint8_t type;
+  uint8_t transfer;
+  uint16_t chunk;
+};
+
+struct ack_hdr {
+  uint8_t type;
+  uint8_t transfer;
+  uint16_t base;
+  uint16_t received;
+};
+
+enum {
+  TYPE_DATA,
+  TYPE_ACK,
+};
+
+#define FLAG_SENDING    0x01
+#define FLAG_TX_PENDING 0x02
+#define FLAG_SPACING    0x04
+
+#define RX_FLAG_ACTIVE  0x01
+#define RX_FLAG_DONE    0x02
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+static void send_next(struct wrucb_conn *c);
+/*---------------------------------------------------------------------------*/
+static int
+is_acked(struct wrucb_conn *c, uint16_t chunk)
+{
+  return chunk < c->base ||
+    (chunk - c->base < WRUCB_WINDOW && (c->acked & (1 << (chunk - c->base))));
+}
+/*---------------------------------------------------------------------------*/
+static void
+stop_sending(struct wrucb_conn *c)
+{
+  c->flags &= ~(FLAG_SENDING | FLAG_SPACING);
+  ctimer_stop(&c->send_timer);
+  ctimer_stop(&c->rexmit_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+spacing_done(void *ptr)
+{
+  struct wrucb_conn *c = ptr;
+
+  c->flags &= ~FLAG_SPACING;
+  send_next(c);
+}
+/*---------------------------------------------------------------------------*/
+static int
+send_chunk(struct wrucb_conn *c, uint16_t chunk)
+{
+  struct data_hdr hdr;
+  int len;
+
+  packetbuf_clear();
+  len = 0;
+  if(c->u->read_chunk) {
+    len = c->u->read_chunk(c, (uint32_t)chunk * WRUCB_DATASIZE,
+                           (char *)packetbuf_dataptr() + sizeof(struct data_hdr),
+                           WRUCB_DATASIZE);
+  }
+  if(len < 0) {
+    len = 0;
+  }
+  if(len < WRUCB_DATASIZE && chunk < c->last) {
+    c->last = chunk;
+  }
+  hdr.type = TYPE_DATA;
+  hdr.transfer = c->transfer;
+  hdr.chunk = chunk;
+  memcpy(packetbuf_dataptr(), &hdr, sizeof(struct data_hdr));
+  packetbuf_set_datalen(sizeof(struct data_hdr) + len);
+
+  PRINTF("%d.%d: wrucb: send chunk %u len %d\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], chunk, len);
+
+  c->flags |= FLAG_TX_PENDING;
+  if(unicast_send(&c->c, &c->receiver) == 0) {
+    /* Try again a little later */
+    c->flags &= ~FLAG_TX_PENDING;
+    c->flags |= FLAG_SPACING;
+    ctimer_set(&c->send_timer, SPACING, spacing_done, c);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_next(struct wrucb_conn *c)
+{
+  if((c->flags & FLAG_SENDING) == 0 ||
+     (c->flags & (FLAG_TX_PENDING | FLAG_SPACING)) != 0) {
+    return;
+  }
+
+  /* Chunks that are known to be missing go first */
+  while(c->resend < c->next && is_acked(c, c->resend)) {
+    c->resend++;
+  }
+  if(c->resend < c->next) {
+    if(send_chunk(c, c->resend)) {
+      c->resend++;
+    }
+  } else if(c->next < c->base + WRUCB_WINDOW && c->next <= c->last) {
+    if(send_chunk(c, c->next)) {
+      c->resend = ++c->next;
+    }
+  }
+  /* A chunk that could not be sent is tried again when the spacing
+     timer expires. */
+  /* Otherwise the window is full, or every chunk has been sent, and
+     we wait for an acknowledgement or a retransmission timeout. */
+}
+/*---------------------------------------------------------------------------*/
+static void
+rexmit_timeout(void *ptr)
+{
+  struct wrucb_conn *c = ptr;
+
+  c->timeouts++;
+  PRINTF("%d.%d: wrucb: timeout %d at chunk %u\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+         c->timeouts, c->base);
+  if(c->timeouts > MAX_TIMEOUTS) {
+    stop_sending(c);
+    if(c->u->timedout) {
+      c->u->timedout(c);
+    }
+    return;
+  }
+
+  c->resend = c->base;
+  c->fast_rexmit = LAST_UNKNOWN;
+  ctimer_set(&c->rexmit_timer,
+             REXMIT_TIME << (c->timeouts < 3 ? c->timeouts : 3),
+             rexmit_timeout, c);
+  send_next(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_input(struct wrucb_conn *c, const linkaddr_t *from)
+{
+  struct ack_hdr ack;
+
+  if((c->flags & FLAG_SENDING) == 0 ||
+     packetbuf_datalen() < sizeof(struct ack_hdr)) {
+    return;
+  }
+  memcpy(&ack, packetbuf_dataptr(), sizeof(struct ack_hdr));
+  if(ack.transfer != c->transfer ||
+     !linkaddr_cmp(from, &c->receiver) ||
+     ack.base < c->base || ack.base > c->next) {
+    return;
+  }
+
+  if(ack.base > c->base) {
+    c->base = ack.base;
+    c->timeouts = 0;
+    ctimer_set(&c->rexmit_timer, REXMIT_TIME, rexmit_timeout, c);
+  }
+  c->acked = ack.received;
+
+  if(c->base > c->last) {
+    PRINTF("%d.%d: wrucb: all %u chunks acked\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], c->base);
+    stop_sending(c);
+    return;
+  }
+
+  /* Chunks are sent in order, so a hole before a received chunk means
+     that the first missing chunk was lost. It is sent again once. */
+  if(c->acked != 0 && c->fast_rexmit != c->base) {
+    c->fast_rexmit = c->base;
+    if(c->resend > c->base) {
+      c->resend = c->base;
+    }
+  }
+  send_next(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_ack(struct wrucb_conn *c, const linkaddr_t *to, uint8_t transfer)
+{
+  struct ack_hdr ack;
+
+  ack.type = TYPE_ACK;
+  ack.transfer = transfer;
+  ack.base = c->rx_base;
+  ack.received = c->rx_received;
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), &ack, sizeof(struct ack_hdr));
+  packetbuf_set_datalen(sizeof(struct ack_hdr));
+  unicast_send(&c->c, to);
+}
+/*---------------------------------------------------------------------------*/
+static void
+data_input(struct wrucb_conn *c, const linkaddr_t *from)
+{
+  struct data_hdr hdr;
+  char *data;
+  int len;
+  uint16_t bit;
+
+  if(packetbuf_datalen() < sizeof(struct data_hdr)) {
+    return;
+  }
+  memcpy(&hdr, packetbuf_dataptr(), sizeof(struct data_hdr));
+  data = (char *)packetbuf_dataptr() + sizeof(struct data_hdr);
+  len = packetbuf_datalen() - sizeof(struct data_hdr);
+
+  if(!linkaddr_cmp(from, &c->sender) || hdr.transfer != c->rx_transfer) {
+    /* A sender may abandon its transfer and start a new one right
+       away. Chunks of its older transfers are still ignored. */
+    if((c->rx_flags & RX_FLAG_ACTIVE) &&
+       clock_time() - c->rx_time < RX_TIMEOUT &&
+       !(linkaddr_cmp(from, &c->sender) &&
+         (int8_t)(hdr.transfer - c->rx_transfer) > 0)) {
+      /* Busy with another transfer */
+      return;
+    }
+    linkaddr_copy(&c->sender, from);
+    c->rx_transfer = hdr.transfer;
+    c->rx_base = 0;
+    c->rx_received = 0;
+    c->rx_last = LAST_UNKNOWN;
+    c->rx_flags = RX_FLAG_ACTIVE;
+    c->u->write_chunk(c, 0, WRUCB_FLAG_NEWFILE, data, 0);
+  }
+  c->rx_time = clock_time();
+
+  if((c->rx_flags & RX_FLAG_ACTIVE) &&
+     hdr.chunk >= c->rx_base && hdr.chunk - c->rx_base < WRUCB_WINDOW) {
+    bit = 1 << (hdr.chunk - c->rx_base);
+    if((c->rx_received & bit) == 0) {
+      PRINTF("%d.%d: wrucb: chunk %u len %d from %d.%d\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+             hdr.chunk, len, from->u8[0], from->u8[1]);
+      if(len > 0) {
+        c->u->write_chunk(c, (uint32_t)hdr.chunk * WRUCB_DATASIZE,
+                          WRUCB_FLAG_NONE, data, len);
+      }
+      c->rx_received |= bit;
+      if(len < WRUCB_DATASIZE) {
+        c->rx_last = hdr.chunk;
+        c->rx_last_len = len;
+      }
+      while(c->rx_received & 1) {
+        c->rx_received >>= 1;
+        c->rx_base++;
+      }
+      if(c->rx_last != LAST_UNKNOWN && c->rx_base > c->rx_last) {
+        c->rx_flags = RX_FLAG_DONE;
+        c->u->write_chunk(c,
+                          (uint32_t)c->rx_last * WRUCB_DATASIZE +
+                          c->rx_last_len,
+                          WRUCB_FLAG_LASTCHUNK, data, 0);
+      }
+    }
+  }
+
+  /* Chunks before the window are duplicates whose acknowledgement was
+     lost, so every chunk is acknowledged. */
+  send_ack(c, from, hdr.transfer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv(struct unicast_conn *uc, const linkaddr_t *from)
+{
+  struct wrucb_conn *c = (struct wrucb_conn *)uc;
+  uint8_t type;
+
+  if(packetbuf_datalen() < 1) {
+    return;
+  }
+  type = *(uint8_t *)packetbuf_dataptr();
+  if(type == TYPE_DATA) {
+    data_input(c, from);
+  } else if(type == TYPE_ACK) {
+    ack_input(c, from);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sent(struct unicast_conn *uc, int status, int num_tx)
+{
+  struct wrucb_conn *c = (struct wrucb_conn *)uc;
+#if RIME_WITH_LINK_STATS
+  const struct link_stats *stats;
+#endif /* RIME_WITH_LINK_STATS */
+  clock_time_t delay;
+
+  if((c->flags & FLAG_TX_PENDING) == 0) {
+    /* An acknowledgement */
+    return;
+  }
+  c->flags &= ~FLAG_TX_PENDING;
+
+  if((c->flags & FLAG_SENDING) == 0) {
+    return;
+  }
+  /* Leave room for the retransmissions that the link needs */
+  delay = 0;
+#if RIME_WITH_LINK_STATS
+  stats = link_stats_from_lladdr(&c->receiver);
+  if(stats != NULL && stats->etx > LINK_STATS_ETX_DIVISOR) {
+    delay = (uint32_t)SPACING * (stats->etx - LINK_STATS_ETX_DIVISOR) /
+      LINK_STATS_ETX_DIVISOR;
+  }
+#endif /* RIME_WITH_LINK_STATS */
+  c->flags |= FLAG_SPACING;
+  ctimer_set(&c->send_timer, delay, spacing_done, c);
+}
+/*---------------------------------------------------------------------------*/
+static const struct unicast_callbacks wrucb = {recv, sent};
+/*---------------------------------------------------------------------------*/
+void
+wrucb_open(struct wrucb_conn *c, uint16_t channel,
+	   const struct wrucb_callbacks *u)
+{
+  unicast_open(&c->c, channel, &wrucb);
+  c->u = u;
+  c->flags = 0;
+  c->rx_flags = 0;
+  c->transfer = random_rand();
+  c->rx_transfer = 0;
+  linkaddr_copy(&c->sender, &linkaddr_null);
+}
+/*---------------------------------------------------------------------------*/
+void
+wrucb_close(struct wrucb_conn *c)
+{
+  stop_sending(c);
+  unicast_close(&c->c);
+}
+/*---------------------------------------------------------------------------*/
+int
+wrucb_send(struct wrucb_conn *c, const linkaddr_t *receiver)
+{
+  if(c->flags & FLAG_SENDING) {
+    return 0;
+  }
+  c->transfer++;
+  c->base = c->next = c->resend = 0;
+  c->acked = 0;
+  c->last = LAST_UNKNOWN;
+  c->fast_rexmit = LAST_UNKNOWN;
+  c->timeouts = 0;
+  linkaddr_copy(&c->receiver, receiver);
+  c->flags = FLAG_SENDING;
+  ctimer_set(&c->rexmit_timer, REXMIT_TIME, rexmit_timeout, c);
+  send_next(c);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
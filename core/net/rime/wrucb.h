@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup rime
+ * @{
+ */
+
+/**
+ * \defgroup wrucb Windowed reliable unicast bulk transfer
+ * @{
+ *
+ * The wrucb module transfers a file to a single-hop neighbor. Unlike
+ * rucb, which waits for the acknowledgement of every chunk before it
+ * reads the next one, wrucb keeps up to WRUCB_WINDOW chunks in
+ * flight. The receiver acknowledges with the number of the first
+ * chunk it is missing and a bitmap of the chunks it has received
+ * after it, and the sender only retransmits the chunks that are
+ * missing. Transmissions are spaced by the ETX of the link to the
+ * receiver, as kept by link-stats. Rime only keeps link-stats when
+ * RIME_CONF_WITH_LINK_STATS is set to 1; without it, chunks are sent
+ * back to back.
+ *
+ * Chunks may be retransmitted, so the read_chunk() callback must be
+ * able to read any offset of the file more than once. Chunks may
+ * arrive out of order, so write_chunk() must honor the offset. When
+ * the whole file has been written, write_chunk() is called once more
+ * with WRUCB_FLAG_LASTCHUNK, the size of the file as offset and no
+ * data.
+ *
+ * \section wrucb-channels Channels
+ *
+ * The wrucb module uses 1 channel.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the windowed reliable unicast bulk transfer module
+ */
+
+#ifndef WRUCB_H_
+#define WRUCB_H_
+
+#include "net/rime/unicast.h"
+#include "sys/ctimer.h"
+
+struct wrucb_conn;
+
+enum {
+  WRUCB_FLAG_NONE,
+  WRUCB_FLAG_NEWFILE,
+  WRUCB_FLAG_LASTCHUNK,
+};
+
+struct wrucb_callbacks {
+  void (* write_chunk)(struct wrucb_conn *c, uint32_t offset, int flag,
+		       char *data, int len);
+  int (* read_chunk)(struct wrucb_conn *c, uint32_t offset, char *to,
+		     int maxsize);
+  void (* timedout)(struct wrucb_conn *c);
+};
+
+#define WRUCB_DATASIZE 64
+
+/* The number of chunks in flight. At most 16, the size of the
+   acknowledgement bitmap. */
+#ifdef WRUCB_CONF_WINDOW
+#define WRUCB_WINDOW WRUCB_CONF_WINDOW
+#else
+#define WRUCB_WINDOW 8
+#endif
+
+#if WRUCB_WINDOW > 16
+#error "WRUCB_WINDOW must be at most 16"
+#endif
+
+struct wrucb_conn {
+  struct unicast_conn c;
+  const struct wrucb_callbacks *u;
+  struct ctimer send_timer, rexmit_timer;
+  linkaddr_t receiver, sender;
+
+  /* Sender state. base is the first chunk that is not acknowledged,
+     next the first chunk that has not been sent and resend the next
+     chunk to retransmit. acked holds the chunks after base that are
+     acknowledged. */
+  uint16_t base, next, resend, last, fast_rexmit;
+  uint16_t acked;
+  uint8_t transfer, timeouts, flags;
+
+  /* Receiver state */
+  clock_time_t rx_time;
+  uint16_t rx_base, rx_received, rx_last;
+  uint8_t rx_transfer, rx_last_len, rx_flags;
+};
+
+void wrucb_open(struct wrucb_conn *c, uint16_t channel,
+	       const struct wrucb_callbacks *u);
+void wrucb_close(struct wrucb_conn *c);
+
+int wrucb_send(struct wrucb_conn *c, const linkaddr_t *receiver);
+
+#endif /* WRUCB_H_ */
+/** @} */
+/** @} */
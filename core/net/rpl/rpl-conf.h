@@ -314,4 +314,13 @@
 #define RPL_DIS_START_DELAY             5
 #endif
 
+/*
+ * Shape downward traffic at the DAG root, see rpl-shaper.h
+ */
+#ifdef RPL_CONF_SHAPER
+#define RPL_SHAPER                      RPL_CONF_SHAPER
+#else
+#define RPL_SHAPER                      0
+#endif
+
 #endif /* RPL_CONF_H */
@@ -76,6 +76,8 @@ static rpl_of_t * const objective_functions[] = {&RPL_OF};
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
 NBR_TABLE_GLOBAL(rpl_parent_t, rpl_parents);
+/* All parents, ordered by increasing path cost */
+LIST(parent_order);
 /*---------------------------------------------------------------------------*/
 /* Allocate instance table. */
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
@@ -94,13 +96,15 @@ rpl_print_neighbor_list()
 
     printf("RPL: rank %u dioint %u, %u nbr(s)\n", curr_rank, curr_dio_interval, uip_ds6_nbr_num());
     while(p != NULL) {
-      uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
-      printf("RPL: nbr %3u %5u, %5u => %5u %c (last tx %u min ago)\n",
+      const struct link_stats *stats = rpl_get_parent_link_stats(p);
+      printf("RPL: nbr %3u %5u, %5u => %5u %c%c (last tx %u min ago)\n",
           nbr_table_get_lladdr(rpl_parents, p)->u8[7],
-          p->rank, nbr ? nbr->link_metric : 0,
+          p->rank, rpl_get_parent_link_metric(p),
           default_instance->of->calculate_rank(p, 0),
           p == default_instance->current_dag->preferred_parent ? '*' : ' ',
-          (unsigned)((now - p->last_tx_time) / (60 * CLOCK_SECOND)));
+          link_stats_is_fresh(stats) ? 'f' : ' ',
+          stats != NULL ?
+          (unsigned)((now - stats->last_tx_time) / (60 * CLOCK_SECOND)) : 0);
       p = nbr_table_next(rpl_parents, p);
     }
     printf("RPL: end of list\n");
@@ -129,6 +133,7 @@ void
 rpl_dag_init(void)
 {
   nbr_table_register(rpl_parents, (nbr_table_callback *)nbr_callback);
+  list_init(parent_order);
 }
 /*---------------------------------------------------------------------------*/
 rpl_parent_t *
@@ -149,17 +154,23 @@ rpl_get_parent_rank(uip_lladdr_t *addr)
   }
 }
 /*---------------------------------------------------------------------------*/
+const struct link_stats *
+rpl_get_parent_link_stats(rpl_parent_t *p)
+{
+  const linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
+  return lladdr != NULL ? link_stats_from_lladdr(lladdr) : NULL;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
-rpl_get_parent_link_metric(const uip_lladdr_t *addr)
+rpl_get_parent_link_metric(rpl_parent_t *p)
 {
-  uip_ds6_nbr_t *nbr;
-  nbr = nbr_table_get_from_lladdr(ds6_neighbors, (const linkaddr_t *)addr);
-  
-  if(nbr != NULL) {
-    return nbr->link_metric;
-  } else {
-    return 0;
+  const struct link_stats *stats = rpl_get_parent_link_stats(p);
+
+  if(stats == NULL || stats->etx == 0) {
+    /* We have not sent anything to this parent yet */
+    return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   }
+  return (uint32_t)stats->etx * RPL_DAG_MC_ETX_DIVISOR / LINK_STATS_ETX_DIVISOR;
 }
 /*---------------------------------------------------------------------------*/
 uip_ipaddr_t *
@@ -346,6 +357,7 @@ rpl_set_root(uint8_t instance_id, uip_ipaddr_t *dag_id)
   instance->min_hoprankinc = RPL_MIN_HOPRANKINC;
   instance->default_lifetime = RPL_DEFAULT_LIFETIME;
   instance->lifetime_unit = RPL_DEFAULT_LIFETIME_UNIT;
+  dio_invalidate_template();
 
   dag->rank = ROOT_RANK(instance);
 
@@ -452,6 +464,7 @@ rpl_set_prefix(rpl_dag_t *dag, uip_ipaddr_t *prefix, unsigned len)
   memcpy(&dag->prefix_info.prefix, prefix, (len + 7) / 8);
   dag->prefix_info.length = len;
   dag->prefix_info.flags = UIP_ND6_RA_FLAG_AUTONOMOUS;
+  dio_invalidate_template();
   PRINTF("RPL: Prefix set - will announce this in DIOs\n");
   /* Autoconfigure an address if this node does not already have an address
      with this prefix. Otherwise, update the prefix */
@@ -610,6 +623,31 @@ rpl_free_dag(rpl_dag_t *dag)
     remove_parents(dag, 0);
   }
   dag->used = 0;
+  dio_invalidate_template();
+}
+/*---------------------------------------------------------------------------*/
+/* Recompute the path cost of a parent and move it to its place in the
+   ordering. Called whenever something the cost depends on has changed. */
+static void
+update_parent_order(rpl_parent_t *p)
+{
+  rpl_parent_t *prev, *q;
+
+  if(p->rank == INFINITE_RANK || p->dag == NULL ||
+     p->dag->instance->of == NULL) {
+    p->path_cost = 0xffff;
+  } else {
+    p->path_cost = p->dag->instance->of->parent_path_cost(p);
+  }
+
+  list_remove(parent_order, p);
+  prev = NULL;
+  for(q = list_head(parent_order);
+      q != NULL && q->path_cost <= p->path_cost;
+      q = list_item_next(q)) {
+    prev = q;
+  }
+  list_insert(parent_order, prev, p);
 }
 /*---------------------------------------------------------------------------*/
 rpl_parent_t *
@@ -624,25 +662,23 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
   if(lladdr != NULL) {
+    /* The entry is about to be cleared, take it out of the ordering first */
+    p = nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)lladdr);
+    if(p != NULL) {
+      list_remove(parent_order, p);
+    }
     /* Add parent in rpl_parents */
     p = nbr_table_add_lladdr(rpl_parents, (linkaddr_t *)lladdr);
     if(p == NULL) {
       PRINTF("RPL: rpl_add_parent p NULL\n");
     } else {
-      uip_ds6_nbr_t *nbr;
-      nbr = rpl_get_nbr(p);
-
       p->dag = dag;
       p->rank = dio->rank;
       p->dtsn = dio->dtsn;
-      
-      /* Check whether we have a neighbor that has not gotten a link metric yet */
-      if(nbr != NULL && nbr->link_metric == 0) {
-	nbr->link_metric = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-      }
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
+      update_parent_order(p);
     }
   }
 
@@ -789,18 +825,20 @@ best_parent(rpl_dag_t *dag)
 {
   rpl_parent_t *p, *best;
 
-  best = NULL;
-
-  p = nbr_table_head(rpl_parents);
-  while(p != NULL) {
-    if(p->dag != dag || p->rank == INFINITE_RANK) {
-      /* ignore this neighbor */
-    } else if(best == NULL) {
-      best = p;
-    } else {
-      best = dag->instance->of->best_parent(best, p);
+  /* The first usable parent of this DAG in the ordering is the cheapest */
+  for(best = list_head(parent_order); best != NULL;
+      best = list_item_next(best)) {
+    if(best->dag == dag && best->rank != INFINITE_RANK) {
+      break;
     }
-    p = nbr_table_next(rpl_parents, p);
+  }
+
+  /* Let the OF decide whether it is better enough to replace the preferred
+     parent */
+  p = dag->preferred_parent;
+  if(best != NULL && p != NULL && p != best &&
+     p->dag == dag && p->rank != INFINITE_RANK) {
+    best = dag->instance->of->best_parent(p, best);
   }
 
   return best;
@@ -830,6 +868,7 @@ rpl_remove_parent(rpl_parent_t *parent)
 
   rpl_nullify_parent(parent);
 
+  list_remove(parent_order, parent);
   nbr_table_remove(rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
@@ -998,6 +1037,8 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
   memcpy(&dag->prefix_info, &dio->prefix_info, sizeof(rpl_prefix_t));
 
   rpl_set_preferred_parent(dag, p);
+  /* The OF was not known yet when the parent was added */
+  update_parent_order(p);
   instance->of->update_metric_container(instance);
   dag->rank = instance->of->calculate_rank(p, 0);
   /* So far this is the lowest rank we are aware of. */
@@ -1201,6 +1242,8 @@ rpl_process_parent_event(rpl_instance_t *instance, rpl_parent_t *p)
 
   return_value = 1;
 
+  update_parent_order(p);
+
   if(!acceptable_rank(p->dag, p->rank)) {
     /* The candidate parent is no longer valid: the rank increase resulting
        from the choice of it as a parent would be too high. */
@@ -1387,7 +1430,7 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
   PRINTF(", rank %u, min_rank %u, ",
 	 instance->current_dag->rank, instance->current_dag->min_rank);
   PRINTF("parent rank %u, parent etx %u, link metric %u, instance etx %u\n",
-	 p->rank, -1/*p->mc.obj.etx*/, rpl_get_nbr(p)->link_metric, instance->mc.obj.etx);
+	 p->rank, -1/*p->mc.obj.etx*/, rpl_get_parent_link_metric(p), instance->mc.obj.etx);
 
   /* We have allocated a candidate parent; process the DIO further. */
 
@@ -89,8 +89,29 @@ static uint8_t dao_sequence = RPL_LOLLIPOP_INIT;
 
 extern rpl_of_t RPL_OF;
 
-#if RPL_CONF_MULTICAST
-static uip_mcast6_route_t *mcast_group;
+/* Pre-encoded DIO body, reused until the DAG, its version or the
+   configuration change. */
+#define DIO_TEMPLATE_SIZE  (24 + 8 + 16 + 32)
+#define DIO_RANK_POS       2
+#define DIO_DTSN_POS       5
+static unsigned char dio_template[DIO_TEMPLATE_SIZE];
+static uint8_t dio_template_len;
+static uint8_t dio_template_mc_pos;
+static uint8_t dio_template_mc_type;
+static uint8_t dio_template_version;
+static rpl_dag_t *dio_template_dag;
+
+static uint8_t path_sequence = RPL_LOLLIPOP_INIT;
+
+/* Targets parsed from the DAO being processed. */
+static rpl_dao_target_t dao_input_targets[RPL_DAO_MAX_TARGETS];
+
+/* Targets waiting to be packed into the next DAO. */
+static rpl_dao_target_t dao_queue[RPL_DAO_MAX_TARGETS];
+static uint8_t dao_queue_len;
+static rpl_instance_t *dao_queue_instance;
+#if RPL_DAO_FORWARD_DELAY
+static struct ctimer dao_queue_timer;
 #endif
 /*---------------------------------------------------------------------------*/
 /* Initialise RPL ICMPv6 message handlers */
@@ -423,38 +444,51 @@ dio_input(void)
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
-void
-dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
+#if !RPL_LEAF_ONLY
+static int
+dio_encode_mc(unsigned char *buffer, int pos, rpl_instance_t *instance)
+{
+  buffer[pos++] = RPL_OPTION_DAG_METRIC_CONTAINER;
+  buffer[pos++] = 6;
+  buffer[pos++] = instance->mc.type;
+  buffer[pos++] = instance->mc.flags >> 1;
+  buffer[pos] = (instance->mc.flags & 1) << 7;
+  buffer[pos++] |= (instance->mc.aggr << 4) | instance->mc.prec;
+  if(instance->mc.type == RPL_DAG_MC_ETX) {
+    buffer[pos++] = 2;
+    set16(buffer, pos, instance->mc.obj.etx);
+    pos += 2;
+  } else if(instance->mc.type == RPL_DAG_MC_ENERGY) {
+    buffer[pos++] = 2;
+    buffer[pos++] = instance->mc.obj.energy.flags;
+    buffer[pos++] = instance->mc.obj.energy.energy_est;
+  } else {
+    PRINTF("RPL: Unable to send DIO because of unhandled DAG MC type %u\n",
+      (unsigned)instance->mc.type);
+    return -1;
+  }
+  return pos;
+}
+#endif /* !RPL_LEAF_ONLY */
+/*---------------------------------------------------------------------------*/
+static int
+dio_build_template(rpl_instance_t *instance)
 {
   unsigned char *buffer;
   int pos;
   rpl_dag_t *dag = instance->current_dag;
-#if !RPL_LEAF_ONLY
-  uip_ipaddr_t addr;
-#endif /* !RPL_LEAF_ONLY */
 
-#if RPL_LEAF_ONLY
-  /* In leaf mode, we only send DIO messages as unicasts in response to
-     unicast DIS messages. */
-  if(uc_addr == NULL) {
-    PRINTF("RPL: LEAF ONLY have multicast addr: skip dio_output\n");
-    return;
-  }
-#endif /* RPL_LEAF_ONLY */
+  dio_template_dag = NULL;
+  dio_template_mc_pos = 0;
 
   /* DAG Information Object */
   pos = 0;
 
-  buffer = UIP_ICMP_PAYLOAD;
+  buffer = dio_template;
   buffer[pos++] = instance->instance_id;
   buffer[pos++] = dag->version;
 
-#if RPL_LEAF_ONLY
-  PRINTF("RPL: LEAF ONLY DIO rank set to INFINITE_RANK\n");
-  set16(buffer, pos, INFINITE_RANK);
-#else /* RPL_LEAF_ONLY */
-  set16(buffer, pos, dag->rank);
-#endif /* RPL_LEAF_ONLY */
+  /* The rank is patched in by dio_output() */
   pos += 2;
 
   buffer[pos] = 0;
@@ -466,14 +500,8 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
   buffer[pos] |= dag->preference & RPL_DIO_PREFERENCE_MASK;
   pos++;
 
-  buffer[pos++] = instance->dtsn_out;
-
-  if(uc_addr == NULL) {
-    /* Request new DAO to refresh route. We do not do this for unicast DIO
-     * in order to avoid DAO messages after a DIS-DIO update,
-     * or upon unicast DIO probing. */
-    RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
-  }
+  /* The DTSN is patched in by dio_output() */
+  pos++;
 
   /* reserved 2 bytes */
   buffer[pos++] = 0; /* flags */
@@ -484,26 +512,10 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 
 #if !RPL_LEAF_ONLY
   if(instance->mc.type != RPL_DAG_MC_NONE) {
-    instance->of->update_metric_container(instance);
-
-    buffer[pos++] = RPL_OPTION_DAG_METRIC_CONTAINER;
-    buffer[pos++] = 6;
-    buffer[pos++] = instance->mc.type;
-    buffer[pos++] = instance->mc.flags >> 1;
-    buffer[pos] = (instance->mc.flags & 1) << 7;
-    buffer[pos++] |= (instance->mc.aggr << 4) | instance->mc.prec;
-    if(instance->mc.type == RPL_DAG_MC_ETX) {
-      buffer[pos++] = 2;
-      set16(buffer, pos, instance->mc.obj.etx);
-      pos += 2;
-    } else if(instance->mc.type == RPL_DAG_MC_ENERGY) {
-      buffer[pos++] = 2;
-      buffer[pos++] = instance->mc.obj.energy.flags;
-      buffer[pos++] = instance->mc.obj.energy.energy_est;
-    } else {
-      PRINTF("RPL: Unable to send DIO because of unhandled DAG MC type %u\n",
-	(unsigned)instance->mc.type);
-      return;
+    dio_template_mc_pos = pos;
+    pos = dio_encode_mc(buffer, pos, instance);
+    if(pos < 0) {
+      return 0;
     }
   }
 #endif /* !RPL_LEAF_ONLY */
@@ -549,6 +561,80 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
            dag->prefix_info.length);
   }
 
+  dio_template_len = pos;
+  dio_template_dag = dag;
+  dio_template_version = dag->version;
+  dio_template_mc_type = instance->mc.type;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+dio_invalidate_template(void)
+{
+  dio_template_dag = NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
+{
+  unsigned char *buffer;
+  int pos;
+  rpl_dag_t *dag = instance->current_dag;
+#if !RPL_LEAF_ONLY
+  uip_ipaddr_t addr;
+#endif /* !RPL_LEAF_ONLY */
+
+#if RPL_LEAF_ONLY
+  /* In leaf mode, we only send DIO messages as unicasts in response to
+     unicast DIS messages. */
+  if(uc_addr == NULL) {
+    PRINTF("RPL: LEAF ONLY have multicast addr: skip dio_output\n");
+    return;
+  }
+#endif /* RPL_LEAF_ONLY */
+
+#if !RPL_LEAF_ONLY
+  if(instance->mc.type != RPL_DAG_MC_NONE) {
+    instance->of->update_metric_container(instance);
+  }
+#endif /* !RPL_LEAF_ONLY */
+
+  /* Only rank, DTSN and metrics change between DIOs of the same DAG
+     version, so the rest of the message is encoded once. */
+  if(dio_template_dag != dag ||
+     dio_template_version != dag->version ||
+     dio_template_mc_type != instance->mc.type) {
+    if(!dio_build_template(instance)) {
+      return;
+    }
+  }
+
+  buffer = UIP_ICMP_PAYLOAD;
+  memcpy(buffer, dio_template, dio_template_len);
+  pos = dio_template_len;
+
+#if RPL_LEAF_ONLY
+  PRINTF("RPL: LEAF ONLY DIO rank set to INFINITE_RANK\n");
+  set16(buffer, DIO_RANK_POS, INFINITE_RANK);
+#else /* RPL_LEAF_ONLY */
+  set16(buffer, DIO_RANK_POS, dag->rank);
+#endif /* RPL_LEAF_ONLY */
+
+  buffer[DIO_DTSN_POS] = instance->dtsn_out;
+
+  if(uc_addr == NULL) {
+    /* Request new DAO to refresh route. We do not do this for unicast DIO
+     * in order to avoid DAO messages after a DIS-DIO update,
+     * or upon unicast DIO probing. */
+    RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
+  }
+
+#if !RPL_LEAF_ONLY
+  if(dio_template_mc_pos != 0) {
+    dio_encode_mc(buffer, dio_template_mc_pos, instance);
+  }
+#endif /* !RPL_LEAF_ONLY */
+
 #if RPL_LEAF_ONLY
 #if (DEBUG) & DEBUG_PRINT
   if(uc_addr == NULL) {
@@ -578,33 +664,178 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 }
 /*---------------------------------------------------------------------------*/
 static void
+dao_send(rpl_parent_t *parent, rpl_dao_target_t *targets, int count)
+{
+  rpl_dag_t *dag;
+  rpl_instance_t *instance;
+  unsigned char *buffer;
+  int pos;
+  int i;
+
+  dag = parent->dag;
+  instance = dag->instance;
+
+#ifdef RPL_DEBUG_DAO_OUTPUT
+  RPL_DEBUG_DAO_OUTPUT(parent);
+#endif
+
+  buffer = UIP_ICMP_PAYLOAD;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_CONF_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_CONF_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos+=sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+
+  for(i = 0; i < count; i++) {
+    /* create target subopt */
+    buffer[pos++] = RPL_OPTION_TARGET;
+    buffer[pos++] = 2 + ((targets[i].prefixlen + 7) / CHAR_BIT);
+    buffer[pos++] = 0; /* reserved */
+    buffer[pos++] = targets[i].prefixlen;
+    memcpy(buffer + pos, &targets[i].prefix, (targets[i].prefixlen + 7) / CHAR_BIT);
+    pos += ((targets[i].prefixlen + 7) / CHAR_BIT);
+
+    PRINTF("RPL: Sending DAO with prefix ");
+    PRINT6ADDR(&targets[i].prefix);
+    PRINTF(" to ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(parent));
+    PRINTF("\n");
+
+    /* Consecutive targets with the same transit information share
+       one Transit Information option. */
+    if(i + 1 < count &&
+       targets[i + 1].lifetime == targets[i].lifetime &&
+       targets[i + 1].path_sequence == targets[i].path_sequence) {
+      continue;
+    }
+
+    /* Create a transit information sub-option. */
+    buffer[pos++] = RPL_OPTION_TRANSIT;
+    buffer[pos++] = 4;
+    buffer[pos++] = 0; /* flags - ignored */
+    buffer[pos++] = 0; /* path control - ignored */
+    buffer[pos++] = targets[i].path_sequence;
+    buffer[pos++] = targets[i].lifetime;
+  }
+
+  if(rpl_get_parent_ipaddr(parent) != NULL) {
+    uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static rpl_parent_t *
+dao_queue_parent(void)
+{
+  if(dao_queue_instance == NULL || !dao_queue_instance->used ||
+     dao_queue_instance->current_dag == NULL) {
+    return NULL;
+  }
+  return dao_queue_instance->current_dag->preferred_parent;
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_queue_flush(rpl_parent_t *parent)
+{
+#if RPL_DAO_FORWARD_DELAY
+  ctimer_stop(&dao_queue_timer);
+#endif
+
+  if(dao_queue_len > 0 && parent != NULL) {
+    dao_send(parent, dao_queue, dao_queue_len);
+  }
+  dao_queue_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_DAO_FORWARD_DELAY
+static void
+handle_dao_queue_timer(void *ptr)
+{
+  dao_queue_flush(dao_queue_parent());
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+dao_queue_add(rpl_parent_t *parent, const rpl_dao_target_t *target)
+{
+  rpl_dao_target_t *queued;
+  int i;
+
+  /* A newer advertisement of a queued target replaces it. The routing
+     table has already filtered out stale path sequences. */
+  for(i = 0; i < dao_queue_len; i++) {
+    queued = &dao_queue[i];
+    if(queued->prefixlen == target->prefixlen &&
+       uip_ipaddr_cmp(&queued->prefix, &target->prefix)) {
+      if(uip_is_addr_mcast(&target->prefix)) {
+        /* Groups have many listeners; keep the longest lifetime. */
+        if(queued->lifetime < target->lifetime) {
+          queued->lifetime = target->lifetime;
+        }
+      } else {
+        memcpy(queued, target, sizeof(*queued));
+      }
+      return;
+    }
+  }
+
+  if(dao_queue_len == RPL_DAO_MAX_TARGETS) {
+    dao_queue_flush(parent);
+  }
+  memcpy(&dao_queue[dao_queue_len++], target, sizeof(*target));
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_target_needs_nbr(const rpl_dao_target_t *target)
+{
+  if(target->lifetime == RPL_ZERO_LIFETIME) {
+    return 0;
+  }
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(&target->prefix)) {
+    return 0;
+  }
+#endif
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
 dao_input(void)
 {
   uip_ipaddr_t dao_sender_addr;
   rpl_dag_t *dag;
   rpl_instance_t *instance;
+  rpl_dao_target_t *target;
   unsigned char *buffer;
   uint16_t sequence;
   uint8_t instance_id;
-  uint8_t lifetime;
   uint8_t prefixlen;
   uint8_t flags;
   uint8_t subopt_type;
-  /*
-  uint8_t pathcontrol;
-  uint8_t pathsequence;
-  */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
-  uint8_t buffer_length;
+  uint16_t buffer_length;
   int pos;
   int len;
   int i;
+  int j;
+  int count;
+  int transit;
   int learned_from;
   rpl_parent_t *parent;
   uip_ds6_nbr_t *nbr;
 
-  prefixlen = 0;
   parent = NULL;
 
   uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
@@ -627,8 +858,6 @@ dao_input(void)
     goto discard;
   }
 
-  lifetime = instance->default_lifetime;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -672,7 +901,10 @@ dao_input(void)
     }
   }
 
-  /* Check if there are any RPL options present. */
+  /* Collect the targets. A Transit Information option applies to
+     all targets that precede it since the previous one. */
+  count = 0;
+  transit = 0;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -686,71 +918,52 @@ dao_input(void)
     case RPL_OPTION_TARGET:
       /* Handle the target option. */
       prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      if(prefixlen > sizeof(uip_ipaddr_t) * CHAR_BIT) {
+        PRINTF("RPL: Invalid DAO target prefix length %u\n", prefixlen);
+        RPL_STAT(rpl_stats.malformed_msgs++);
+        goto discard;
+      }
+      if(count == RPL_DAO_MAX_TARGETS) {
+        PRINTF("RPL: Too many targets in DAO, ignoring the rest\n");
+        break;
+      }
+      target = &dao_input_targets[count++];
+      target->prefixlen = prefixlen;
+      memset(&target->prefix, 0, sizeof(target->prefix));
+      memcpy(&target->prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      target->lifetime = instance->default_lifetime;
+      target->path_sequence = 0;
       break;
     case RPL_OPTION_TRANSIT:
-      /* The path sequence and control are ignored. */
-      /*      pathcontrol = buffer[i + 3];
-              pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
+      /* The path control and the parent address are ignored. */
+      for(j = transit; j < count; j++) {
+        dao_input_targets[j].path_sequence = buffer[i + 4];
+        dao_input_targets[j].lifetime = buffer[i + 5];
+      }
+      transit = count;
       break;
     }
   }
 
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
-    }
-    goto fwd_dao;
+  if(count == 0) {
+    PRINTF("RPL: DAO without targets\n");
+    goto discard;
   }
-#endif
 
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
-
-      /* We forward the incoming no-path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding no-path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-      }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
-      }
+  /* Unicast routes through the sender need it in the neighbor cache. */
+  for(i = 0; i < count; i++) {
+    target = &dao_input_targets[i];
+    PRINTF("RPL: DAO lifetime: %u, path sequence: %u, prefix length: %u prefix: ",
+           (unsigned)target->lifetime, (unsigned)target->path_sequence,
+           (unsigned)target->prefixlen);
+    PRINT6ADDR(&target->prefix);
+    PRINTF("\n");
+    if(dao_target_needs_nbr(target)) {
+      break;
     }
-    goto discard;
   }
 
-  PRINTF("RPL: adding DAO route\n");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
+  if(i < count && (nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
     if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
                               (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
                               0, NBR_REACHABLE)) != NULL) {
@@ -762,40 +975,49 @@ dao_input(void)
       PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
       PRINTF("\n");
     } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINTF("RPL: Out of Memory, ignoring routes via ");
       PRINT6ADDR(&dao_sender_addr);
       PRINTF(", ");
       PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
       PRINTF("\n");
-      goto discard;
+      /* No-Path and multicast targets are still applied. */
+      for(j = i; i < count; i++) {
+        if(!dao_target_needs_nbr(&dao_input_targets[i])) {
+          if(i != j) {
+            memcpy(&dao_input_targets[j], &dao_input_targets[i],
+                   sizeof(dao_input_targets[j]));
+          }
+          j++;
+        }
+      }
+      count = j;
+      /* Do not acknowledge, so that the sender retries the DAO. */
+      flags &= ~RPL_DAO_K_FLAG;
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
 
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
-    goto discard;
-  }
-
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-  rep->state.nopath_received = 0;
-
-#if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
+  count = rpl_update_routes(dag, dao_input_targets, count,
+                            &dao_sender_addr, learned_from);
 
   if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF("\n");
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+    /* Only targets that changed our routes are worth propagating. */
+    if(count > 0 && dag->preferred_parent != NULL) {
+      PRINTF("RPL: Forwarding %d DAO targets\n", count);
+      if(dao_queue_instance != instance) {
+        dao_queue_flush(dao_queue_parent());
+        dao_queue_instance = instance;
+      }
+      for(i = 0; i < count; i++) {
+        dao_queue_add(dag->preferred_parent, &dao_input_targets[i]);
+      }
+#if RPL_DAO_FORWARD_DELAY
+      if(ctimer_expired(&dao_queue_timer)) {
+        ctimer_set(&dao_queue_timer, RPL_DAO_FORWARD_DELAY,
+                   handle_dao_queue_timer, NULL);
+      }
+#else
+      dao_queue_flush(dag->preferred_parent);
+#endif
     }
     if(flags & RPL_DAO_K_FLAG) {
       dao_ack_output(instance, &dao_sender_addr, sequence);
@@ -806,6 +1028,56 @@ fwd_dao:
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
+static rpl_instance_t *
+dao_output_instance(rpl_parent_t *parent)
+{
+  /* If we are in feather mode, we should not send any DAOs */
+  if(rpl_get_mode() == RPL_MODE_FEATHER) {
+    return NULL;
+  }
+
+  if(parent == NULL) {
+    PRINTF("RPL dao_output_target error parent NULL\n");
+    return NULL;
+  }
+
+  if(parent->dag == NULL) {
+    PRINTF("RPL dao_output_target error dag NULL\n");
+    return NULL;
+  }
+
+  if(parent->dag->instance == NULL) {
+    PRINTF("RPL dao_output_target error instance NULL\n");
+  }
+  return parent->dag->instance;
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_output_begin(rpl_parent_t *parent)
+{
+  /* Targets waiting for another parent cannot share our DAOs. */
+  if(dao_queue_len > 0 && dao_queue_parent() != parent) {
+    dao_queue_flush(dao_queue_parent());
+  }
+  dao_queue_instance = parent->dag->instance;
+
+  /* Our targets get a fresh path sequence in every DAO round, which
+     lets the nodes on the way tell them from stale copies. */
+  RPL_LOLLIPOP_INCREMENT(path_sequence);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_output_add(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
+{
+  rpl_dao_target_t target;
+
+  target.prefixlen = sizeof(*prefix) * CHAR_BIT;
+  uip_ipaddr_copy(&target.prefix, prefix);
+  target.lifetime = lifetime;
+  target.path_sequence = path_sequence;
+  dao_queue_add(parent, &target);
+}
+/*---------------------------------------------------------------------------*/
 void
 dao_output(rpl_parent_t *parent, uint8_t lifetime)
 {
@@ -824,91 +1096,70 @@ dao_output(rpl_parent_t *parent, uint8_t lifetime)
 void
 dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 {
-  rpl_dag_t *dag;
-  rpl_instance_t *instance;
-  unsigned char *buffer;
-  uint8_t prefixlen;
-  int pos;
-
   /* Destination Advertisement Object */
-
-  /* If we are in feather mode, we should not send any DAOs */
-  if(rpl_get_mode() == RPL_MODE_FEATHER) {
+  if(dao_output_instance(parent) == NULL) {
     return;
   }
 
-  if(parent == NULL) {
-    PRINTF("RPL dao_output_target error parent NULL\n");
-    return;
-  }
-
-  dag = parent->dag;
-  if(dag == NULL) {
-    PRINTF("RPL dao_output_target error dag NULL\n");
-    return;
-  }
-
-  instance = dag->instance;
-
-  if(instance == NULL) {
-    PRINTF("RPL dao_output_target error instance NULL\n");
-    return;
-  }
   if(prefix == NULL) {
     PRINTF("RPL dao_output_target error prefix NULL\n");
     return;
   }
-#ifdef RPL_DEBUG_DAO_OUTPUT
-  RPL_DEBUG_DAO_OUTPUT(parent);
+
+  dao_output_begin(parent);
+  dao_output_add(parent, prefix, lifetime);
+  dao_queue_flush(parent);
+}
+/*---------------------------------------------------------------------------*/
+void
+dao_output_all(rpl_parent_t *parent, uint8_t lifetime)
+{
+  uip_ipaddr_t prefix;
+#if RPL_CONF_MULTICAST
+  rpl_instance_t *instance;
+  uip_mcast6_route_t *mcast_route;
+  uint8_t i;
 #endif
 
-  buffer = UIP_ICMP_PAYLOAD;
+  /* Advertise all our targets, packed into as few DAOs as possible. */
+  if(dao_output_instance(parent) == NULL) {
+    return;
+  }
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
+  dao_output_begin(parent);
 
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
-#if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
-#endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
+  if(get_global_addr(&prefix)) {
+    dao_output_add(parent, &prefix, lifetime);
+  } else {
+    PRINTF("RPL: No global address set for this node\n");
+  }
 
-  /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
-
-  /* Create a transit information sub-option. */
-  buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
-  buffer[pos++] = 0; /* flags - ignored */
-  buffer[pos++] = 0; /* path control - ignored */
-  buffer[pos++] = 0; /* path seq - ignored */
-  buffer[pos++] = lifetime;
-
-  PRINTF("RPL: Sending DAO with prefix ");
-  PRINT6ADDR(prefix);
-  PRINTF(" to ");
-  PRINT6ADDR(rpl_get_parent_ipaddr(parent));
-  PRINTF("\n");
+#if RPL_CONF_MULTICAST
+  instance = parent->dag->instance;
+
+  /* Send DAOs for multicast prefixes only if the instance is in MOP 3 */
+  if(instance->mop == RPL_MOP_STORING_MULTICAST) {
+    /* Own multicast addresses */
+    for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
+      if(uip_ds6_if.maddr_list[i].isused
+          && uip_is_addr_mcast_global(&uip_ds6_if.maddr_list[i].ipaddr)) {
+        dao_output_add(parent, &uip_ds6_if.maddr_list[i].ipaddr,
+                       RPL_MCAST_LIFETIME);
+      }
+    }
 
-  if(rpl_get_parent_ipaddr(parent) != NULL) {
-    uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+    /* Groups we route for; our own addresses are already in the list */
+    mcast_route = uip_mcast6_route_list_head();
+    while(mcast_route != NULL) {
+      if(uip_ds6_maddr_lookup(&mcast_route->group) == NULL) {
+        dao_output_add(parent, &mcast_route->group, RPL_MCAST_LIFETIME);
+      }
+      mcast_route = list_item_next(mcast_route);
+    }
   }
+#endif
+
+  dao_queue_flush(parent);
 }
 /*---------------------------------------------------------------------------*/
 static void
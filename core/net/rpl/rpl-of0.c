@@ -48,6 +48,7 @@
 
 static void reset(rpl_dag_t *);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
@@ -56,6 +57,7 @@ rpl_of_t rpl_of0 = {
   reset,
   NULL,
   best_parent,
+  parent_path_cost,
   best_dag,
   calculate_rank,
   update_metric_container,
@@ -122,6 +124,16 @@ best_dag(rpl_dag_t *d1, rpl_dag_t *d2)
   }
 }
 
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  if(rpl_get_nbr(p) == NULL) {
+    return 0xffff;
+  }
+  return DAG_RANK(p->rank, p->dag->instance) * RPL_MIN_HOPRANKINC +
+    rpl_get_parent_link_metric(p);
+}
+
 static rpl_parent_t *
 best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 {
@@ -140,16 +152,14 @@ best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
   PRINTF("RPL: Comparing parent ");
   PRINT6ADDR(rpl_get_parent_ipaddr(p1));
   PRINTF(" (confidence %d, rank %d) with parent ",
-        nbr1->link_metric, p1->rank);
+        rpl_get_parent_link_metric(p1), p1->rank);
   PRINT6ADDR(rpl_get_parent_ipaddr(p2));
   PRINTF(" (confidence %d, rank %d)\n",
-        nbr2->link_metric, p2->rank);
+        rpl_get_parent_link_metric(p2), p2->rank);
 
 
-  r1 = DAG_RANK(p1->rank, p1->dag->instance) * RPL_MIN_HOPRANKINC  +
-    nbr1->link_metric;
-  r2 = DAG_RANK(p2->rank, p1->dag->instance) * RPL_MIN_HOPRANKINC  +
-    nbr2->link_metric;
+  r1 = parent_path_cost(p1);
+  r2 = parent_path_cost(p2);
   /* Compare two parents by looking both and their rank and at the ETX
      for that parent. We choose the parent that has the most
      favourable combination. */
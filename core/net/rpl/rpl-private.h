@@ -110,6 +110,25 @@
 #define RPL_DAO_DELAY                 (CLOCK_SECOND * 4)
 #endif /* RPL_CONF_DAO_DELAY */
 
+/* Maximum number of targets packed into a single DAO. A node's own
+   address and its multicast groups are advertised together, and
+   forwarded targets are coalesced up to this limit. Each target adds
+   20 bytes to the DAO, so lower this on links without fragmentation. */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS           RPL_CONF_DAO_MAX_TARGETS
+#else /* RPL_CONF_DAO_MAX_TARGETS */
+#define RPL_DAO_MAX_TARGETS           4
+#endif /* RPL_CONF_DAO_MAX_TARGETS */
+
+/* Time that targets received from children are held before being
+   forwarded, so that DAOs arriving close together leave in one
+   message. Zero forwards the targets of every DAO immediately. */
+#ifdef RPL_CONF_DAO_FORWARD_DELAY
+#define RPL_DAO_FORWARD_DELAY         RPL_CONF_DAO_FORWARD_DELAY
+#else /* RPL_CONF_DAO_FORWARD_DELAY */
+#define RPL_DAO_FORWARD_DELAY         (CLOCK_SECOND / 4)
+#endif /* RPL_CONF_DAO_FORWARD_DELAY */
+
 /* Delay between reception of a no-path DAO and actual route removal */
 #ifdef RPL_CONF_NOPATH_REMOVAL_DELAY
 #define RPL_NOPATH_REMOVAL_DELAY          RPL_CONF_NOPATH_REMOVAL_DELAY
@@ -207,6 +226,24 @@
 
 #define RPL_LOLLIPOP_IS_INIT(counter)		\
   ((counter) > RPL_LOLLIPOP_CIRCULAR_REGION)
+
+/* Lollipop comparison as specified in RFC 6550, section 7.2. */
+#define RPL_LOLLIPOP_GREATER_THAN_LOCAL(a, b)                           \
+  (((a) < (b) &&                                                        \
+    (RPL_LOLLIPOP_CIRCULAR_REGION + 1 - (b) + (a)) <                    \
+    RPL_LOLLIPOP_SEQUENCE_WINDOWS) ||                                   \
+   ((a) > (b) && ((a) - (b)) < RPL_LOLLIPOP_SEQUENCE_WINDOWS))
+
+#define RPL_LOLLIPOP_GREATER_THAN(a, b)                                 \
+  (RPL_LOLLIPOP_IS_INIT(a) ?                                            \
+   (RPL_LOLLIPOP_IS_INIT(b) ?                                           \
+    RPL_LOLLIPOP_GREATER_THAN_LOCAL(a, b) :                             \
+    (RPL_LOLLIPOP_MAX_VALUE + 1 + (b) - (a)) >                          \
+    RPL_LOLLIPOP_SEQUENCE_WINDOWS) :                                    \
+   (RPL_LOLLIPOP_IS_INIT(b) ?                                           \
+    (RPL_LOLLIPOP_MAX_VALUE + 1 + (a) - (b)) <=                         \
+    RPL_LOLLIPOP_SEQUENCE_WINDOWS :                                     \
+    RPL_LOLLIPOP_GREATER_THAN_LOCAL(a, b)))
 /*---------------------------------------------------------------------------*/
 /* Logical representation of a DAG Information Object (DIO.) */
 struct rpl_dio {
@@ -232,6 +269,16 @@ struct rpl_dio {
 };
 typedef struct rpl_dio rpl_dio_t;
 
+/* A DAO target together with the Transit Information that applies
+   to it. */
+struct rpl_dao_target {
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  uint8_t lifetime;
+  uint8_t path_sequence;
+};
+typedef struct rpl_dao_target rpl_dao_target_t;
+
 #if RPL_CONF_STATS
 /* Statistics for fault management. */
 struct rpl_stats {
@@ -266,8 +313,10 @@ extern rpl_instance_t *default_instance;
 /* ICMPv6 functions for RPL. */
 void dis_output(uip_ipaddr_t *addr);
 void dio_output(rpl_instance_t *, uip_ipaddr_t *uc_addr);
+void dio_invalidate_template(void);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
+void dao_output_all(rpl_parent_t *, uint8_t lifetime);
 void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
 void rpl_icmp6_register_handlers(void);
 
@@ -301,6 +350,8 @@ void rpl_remove_routes(rpl_dag_t *dag);
 void rpl_remove_routes_by_nexthop(uip_ipaddr_t *nexthop, rpl_dag_t *dag);
 uip_ds6_route_t *rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix,
                                int prefix_len, uip_ipaddr_t *next_hop);
+int rpl_update_routes(rpl_dag_t *dag, rpl_dao_target_t *targets, int count,
+                      uip_ipaddr_t *next_hop, uint8_t learned_from);
 void rpl_purge_routes(void);
 
 /* Objective function. */
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Shaping of downward traffic at the DAG root
+ */
+
+#include "contiki.h"
+#include "net/rpl/rpl-shaper.h"
+
+#if RPL_SHAPER
+
+#include "net/ip/tcpip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/link-stats.h"
+#include "net/nbr-table.h"
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-dag-root.h"
+#include "lib/memb.h"
+
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+struct shaper_packet {
+  struct shaper_packet *next;
+  uint16_t len;
+  uint8_t buf[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+NBR_TABLE(struct rpl_shaper_subtree, subtrees);
+MEMB(packets_memb, struct shaper_packet, RPL_SHAPER_QUEUE_NUM);
+
+static struct ctimer release_timer;
+static struct ctimer update_timer;
+/*---------------------------------------------------------------------------*/
+static void
+update_budget(struct rpl_shaper_subtree *st)
+{
+  const struct link_stats *stats;
+  uint16_t etx;
+
+  /* A link with an ETX of 2 takes twice the airtime per packet */
+  stats = link_stats_from_lladdr(nbr_table_get_lladdr(subtrees, st));
+  if(stats != NULL && stats->etx != 0) {
+    etx = stats->etx;
+  } else {
+    etx = RPL_INIT_LINK_METRIC * LINK_STATS_ETX_DIVISOR;
+  }
+  st->rate = (uint32_t)RPL_SHAPER_RATE * RPL_SHAPER_TOKEN_SCALE *
+    LINK_STATS_ETX_DIVISOR / etx;
+  if(st->rate == 0) {
+    st->rate = 1;
+  }
+
+  /* Packets to different destinations of the subtree fan out below
+     the child, so larger subtrees may take larger bursts */
+  if(st->routes == 0) {
+    st->depth = RPL_SHAPER_TOKEN_SCALE;
+  } else if(st->routes > RPL_SHAPER_MAX_BURST) {
+    st->depth = RPL_SHAPER_MAX_BURST * RPL_SHAPER_TOKEN_SCALE;
+  } else {
+    st->depth = st->routes * RPL_SHAPER_TOKEN_SCALE;
+  }
+  if(st->tokens > st->depth) {
+    st->tokens = st->depth;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+count_routes(void)
+{
+  struct rpl_shaper_subtree *st;
+  uip_ds6_route_t *r;
+
+  for(st = nbr_table_head(subtrees); st != NULL;
+      st = nbr_table_next(subtrees, st)) {
+    st->routes = 0;
+  }
+
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if(r->state.learned_from != RPL_ROUTE_FROM_UNICAST_DAO) {
+      continue;
+    }
+    st = nbr_table_get_from_lladdr(subtrees,
+        (const linkaddr_t *)uip_ds6_route_nexthop_lladdr(r));
+    if(st != NULL && st->routes < 0xff) {
+      st->routes++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+refill(struct rpl_shaper_subtree *st)
+{
+  clock_time_t now;
+  clock_time_t elapsed;
+  uint32_t tokens;
+
+  now = clock_time();
+  elapsed = now - st->last_refill;
+  if(elapsed >= (uint32_t)CLOCK_SECOND * st->depth / st->rate) {
+    /* Idle for long enough to fill the bucket */
+    st->tokens = st->depth;
+    st->last_refill = now;
+    return;
+  }
+  tokens = (uint32_t)elapsed * st->rate / CLOCK_SECOND;
+  if(tokens == 0) {
+    /* Let the time accumulate until it is worth a token fraction */
+    return;
+  }
+  tokens += st->tokens;
+  st->tokens = tokens > st->depth ? st->depth : tokens;
+  st->last_refill = now;
+}
+/*---------------------------------------------------------------------------*/
+static void release(void *ptr);
+
+static void
+schedule_release(void)
+{
+  struct rpl_shaper_subtree *st;
+  clock_time_t wait;
+  clock_time_t next;
+  int pending;
+
+  /* Wake up when the first subtree with a queue has a token */
+  pending = 0;
+  next = 0;
+  for(st = nbr_table_head(subtrees); st != NULL;
+      st = nbr_table_next(subtrees, st)) {
+    if(st->queue_len == 0) {
+      continue;
+    }
+    if(st->tokens >= RPL_SHAPER_TOKEN_SCALE) {
+      wait = 0;
+    } else {
+      wait = ((uint32_t)(RPL_SHAPER_TOKEN_SCALE - st->tokens) *
+              CLOCK_SECOND + st->rate - 1) / st->rate;
+    }
+    if(!pending || wait < next) {
+      next = wait;
+    }
+    pending = 1;
+  }
+
+  if(pending) {
+    ctimer_set(&release_timer, next > 0 ? next : 1, release, NULL);
+  } else {
+    ctimer_stop(&release_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+release(void *ptr)
+{
+  struct rpl_shaper_subtree *st;
+  struct shaper_packet *p;
+
+  for(st = nbr_table_head(subtrees); st != NULL;
+      st = nbr_table_next(subtrees, st)) {
+    refill(st);
+    while(st->queue_len > 0 && st->tokens >= RPL_SHAPER_TOKEN_SCALE) {
+      p = list_pop(st->queue);
+      st->queue_len--;
+      st->tokens -= RPL_SHAPER_TOKEN_SCALE;
+
+      uip_len = p->len;
+      memcpy(UIP_IP_BUF, p->buf, p->len);
+      memb_free(&packets_memb, p);
+      tcpip_output((const uip_lladdr_t *)nbr_table_get_lladdr(subtrees, st));
+      uip_clear_buf();
+    }
+  }
+
+  schedule_release();
+}
+/*---------------------------------------------------------------------------*/
+static void
+update(void *ptr)
+{
+  struct rpl_shaper_subtree *st;
+
+  count_routes();
+  for(st = nbr_table_head(subtrees); st != NULL;
+      st = nbr_table_next(subtrees, st)) {
+    refill(st);
+    update_budget(st);
+  }
+  ctimer_reset(&update_timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+subtree_removed(void *item)
+{
+  struct rpl_shaper_subtree *st;
+  struct shaper_packet *p;
+
+  st = item;
+  while((p = list_pop(st->queue)) != NULL) {
+    memb_free(&packets_memb, p);
+  }
+  st->queue_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct rpl_shaper_subtree *
+add_subtree(const linkaddr_t *lladdr)
+{
+  struct rpl_shaper_subtree *st;
+  uip_ds6_route_t *r;
+
+  st = nbr_table_add_lladdr(subtrees, lladdr);
+  if(st == NULL) {
+    return NULL;
+  }
+  memset(st, 0, sizeof(*st));
+  LIST_STRUCT_INIT(st, queue);
+
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if(r->state.learned_from == RPL_ROUTE_FROM_UNICAST_DAO &&
+       linkaddr_cmp(lladdr,
+                    (const linkaddr_t *)uip_ds6_route_nexthop_lladdr(r)) &&
+       st->routes < 0xff) {
+      st->routes++;
+    }
+  }
+  update_budget(st);
+
+  /* Start with a full bucket */
+  st->tokens = st->depth;
+  st->last_refill = clock_time();
+  return st;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_shaper_output(const uip_lladdr_t *lladdr)
+{
+  struct rpl_shaper_subtree *st;
+  struct shaper_packet *p;
+
+  /* Only traffic that the root forwards into the DAG is shaped */
+  if(lladdr == NULL || !rpl_dag_root_is_root() ||
+     uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr)) {
+    return 0;
+  }
+
+  st = nbr_table_get_from_lladdr(subtrees, (const linkaddr_t *)lladdr);
+  if(st == NULL) {
+    st = add_subtree((const linkaddr_t *)lladdr);
+    if(st == NULL) {
+      return 0;
+    }
+  }
+
+  refill(st);
+  if(st->queue_len == 0 && st->tokens >= RPL_SHAPER_TOKEN_SCALE) {
+    st->tokens -= RPL_SHAPER_TOKEN_SCALE;
+    st->sent++;
+    return 0;
+  }
+
+  p = memb_alloc(&packets_memb);
+  if(p == NULL) {
+    PRINTF("RPL shaper: dropping packet to ");
+    PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+    PRINTF("\n");
+    st->drops++;
+    return 1;
+  }
+
+  p->len = uip_len;
+  memcpy(p->buf, UIP_IP_BUF, uip_len);
+  list_add(st->queue, p);
+  st->queue_len++;
+  st->delayed++;
+  schedule_release();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+struct rpl_shaper_subtree *
+rpl_shaper_head(void)
+{
+  return nbr_table_head(subtrees);
+}
+/*---------------------------------------------------------------------------*/
+struct rpl_shaper_subtree *
+rpl_shaper_next(struct rpl_shaper_subtree *st)
+{
+  return nbr_table_next(subtrees, st);
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+rpl_shaper_lladdr(struct rpl_shaper_subtree *st)
+{
+  return nbr_table_get_lladdr(subtrees, st);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_shaper_init(void)
+{
+  memb_init(&packets_memb);
+  nbr_table_register(subtrees, subtree_removed);
+  ctimer_set(&update_timer, RPL_SHAPER_UPDATE_INTERVAL, update, NULL);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* RPL_SHAPER */
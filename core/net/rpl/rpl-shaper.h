@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Shaping of downward traffic at the DAG root. Every child of
+ *         the root heads a subtree of the DAG, and gets a token bucket
+ *         whose rate follows the ETX of the link to the child and
+ *         whose depth follows the number of DAO routes through it.
+ *         Forwarded packets that exceed the budget of their subtree
+ *         are held back and released as tokens accumulate, instead of
+ *         overflowing the MAC queue of the first hop.
+ */
+
+#ifndef RPL_SHAPER_H_
+#define RPL_SHAPER_H_
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/linkaddr.h"
+#include "net/rpl/rpl-conf.h"
+#include "lib/list.h"
+
+/* Packets per second that a subtree may receive when the link to
+   its head has an ETX of 1 */
+#ifdef RPL_SHAPER_CONF_RATE
+#define RPL_SHAPER_RATE RPL_SHAPER_CONF_RATE
+#else
+#define RPL_SHAPER_RATE 10
+#endif
+
+/* Upper bound of the burst a subtree may receive, in packets */
+#ifdef RPL_SHAPER_CONF_MAX_BURST
+#define RPL_SHAPER_MAX_BURST RPL_SHAPER_CONF_MAX_BURST
+#else
+#define RPL_SHAPER_MAX_BURST 8
+#endif
+
+/* Number of packets held back, shared by all subtrees */
+#ifdef RPL_SHAPER_CONF_QUEUE_NUM
+#define RPL_SHAPER_QUEUE_NUM RPL_SHAPER_CONF_QUEUE_NUM
+#else
+#define RPL_SHAPER_QUEUE_NUM 4
+#endif
+
+/* Interval at which budgets are derived again from the routes and
+   the link statistics */
+#ifdef RPL_SHAPER_CONF_UPDATE_INTERVAL
+#define RPL_SHAPER_UPDATE_INTERVAL RPL_SHAPER_CONF_UPDATE_INTERVAL
+#else
+#define RPL_SHAPER_UPDATE_INTERVAL (30 * CLOCK_SECOND)
+#endif
+
+/* Tokens are kept in fractions of a packet */
+#define RPL_SHAPER_TOKEN_SCALE 256
+
+struct rpl_shaper_subtree {
+  LIST_STRUCT(queue);
+  clock_time_t last_refill;
+  uint32_t rate;      /* tokens per second */
+  uint16_t tokens;
+  uint16_t depth;     /* bucket depth in tokens */
+  uint8_t routes;     /* DAO routes through the child */
+  uint8_t queue_len;
+  uint16_t sent;      /* packets sent without delay */
+  uint16_t delayed;   /* packets held back */
+  uint16_t drops;     /* packets dropped for lack of queue space */
+};
+
+/* Called for a packet in uip_buf that is about to be sent to
+   lladdr. Returns non-zero if the shaper has taken the packet, either
+   into a queue or by dropping it. */
+int rpl_shaper_output(const uip_lladdr_t *lladdr);
+
+/* Iterate over the subtrees, and find the child heading each */
+struct rpl_shaper_subtree *rpl_shaper_head(void);
+struct rpl_shaper_subtree *rpl_shaper_next(struct rpl_shaper_subtree *st);
+const linkaddr_t *rpl_shaper_lladdr(struct rpl_shaper_subtree *st);
+
+void rpl_shaper_init(void);
+
+#endif /* RPL_SHAPER_H_ */
@@ -226,10 +226,6 @@ static void
 handle_dao_timer(void *ptr)
 {
   rpl_instance_t *instance;
-#if RPL_CONF_MULTICAST
-  uip_mcast6_route_t *mcast_route;
-  uint8_t i;
-#endif
 
   instance = (rpl_instance_t *)ptr;
 
@@ -242,33 +238,9 @@ handle_dao_timer(void *ptr)
   /* Send the DAO to the DAO parent set -- the preferred parent in our case. */
   if(instance->current_dag->preferred_parent != NULL) {
     PRINTF("RPL: handle_dao_timer - sending DAO\n");
-    /* Set the route lifetime to the default value. */
-    dao_output(instance->current_dag->preferred_parent, instance->default_lifetime);
-
-#if RPL_CONF_MULTICAST
-    /* Send DAOs for multicast prefixes only if the instance is in MOP 3 */
-    if(instance->mop == RPL_MOP_STORING_MULTICAST) {
-      /* Send a DAO for own multicast addresses */
-      for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
-        if(uip_ds6_if.maddr_list[i].isused
-            && uip_is_addr_mcast_global(&uip_ds6_if.maddr_list[i].ipaddr)) {
-          dao_output_target(instance->current_dag->preferred_parent,
-              &uip_ds6_if.maddr_list[i].ipaddr, RPL_MCAST_LIFETIME);
-        }
-      }
-
-      /* Iterate over multicast routes and send DAOs */
-      mcast_route = uip_mcast6_route_list_head();
-      while(mcast_route != NULL) {
-        /* Don't send if it's also our own address, done that already */
-        if(uip_ds6_maddr_lookup(&mcast_route->group) == NULL) {
-          dao_output_target(instance->current_dag->preferred_parent,
-                     &mcast_route->group, RPL_MCAST_LIFETIME);
-        }
-        mcast_route = list_item_next(mcast_route);
-      }
-    }
-#endif
+    /* Set the route lifetime to the default value. All our targets
+       are packed into as few DAOs as possible. */
+    dao_output_all(instance->current_dag->preferred_parent, instance->default_lifetime);
   } else {
     PRINTF("RPL: No suitable DAO parent\n");
   }
@@ -329,6 +301,13 @@ rpl_cancel_dao(rpl_instance_t *instance)
 }
 /*---------------------------------------------------------------------------*/
 #if RPL_WITH_PROBING
+static clock_time_t
+parent_last_tx_time(rpl_parent_t *p)
+{
+  const struct link_stats *stats = rpl_get_parent_link_stats(p);
+  return stats != NULL ? stats->last_tx_time : 0;
+}
+/*---------------------------------------------------------------------------*/
 static rpl_parent_t *
 get_probing_target(rpl_dag_t *dag)
 {
@@ -354,7 +333,7 @@ get_probing_target(rpl_dag_t *dag)
   }
 
   /* Our preferred parent needs probing */
-  if(dag->preferred_parent->last_tx_time < min_last_tx) {
+  if(parent_last_tx_time(dag->preferred_parent) < min_last_tx) {
     probing_target = dag->preferred_parent;
   }
 
@@ -362,7 +341,7 @@ get_probing_target(rpl_dag_t *dag)
   if(probing_target == NULL && (random_rand() % 2) == 0) {
     p = nbr_table_head(rpl_parents);
     while(p != NULL) {
-      if(p->dag == dag && p->last_tx_time < min_last_tx) {
+      if(p->dag == dag && parent_last_tx_time(p) < min_last_tx) {
         /* p is in our dag and needs probing */
         rpl_rank_t p_rank = dag->instance->of->calculate_rank(p, 0);
         if(probing_target == NULL
@@ -381,7 +360,7 @@ get_probing_target(rpl_dag_t *dag)
     while(p != NULL) {
       if(p->dag == dag) {
         if(probing_target == NULL
-            || p->last_tx_time < probing_target->last_tx_time) {
+            || parent_last_tx_time(p) < parent_last_tx_time(probing_target)) {
           probing_target = p;
         }
       }
@@ -43,10 +43,12 @@
  */
 
 #include "net/ip/uip.h"
+#include "net/packetbuf.h"
 #include "net/ip/tcpip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-shaper.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 
 #define DEBUG DEBUG_NONE
@@ -115,6 +117,9 @@ rpl_purge_routes(void)
   rpl_dag_t *dag;
 #if RPL_CONF_MULTICAST
   uip_mcast6_route_t *mcast_route;
+#if UIP_MCAST6_ROUTE_FILTERS
+  uip_mcast6_filter_t *mcast_filter;
+#endif
 #endif
 
   /* First pass, decrement lifetime */
@@ -170,6 +175,26 @@ rpl_purge_routes(void)
       mcast_route = list_item_next(mcast_route);
     }
   }
+
+#if UIP_MCAST6_ROUTE_FILTERS
+  mcast_filter = uip_mcast6_filter_list_head();
+
+  while(mcast_filter != NULL) {
+    if(mcast_filter->lifetime <= 1) {
+      /* Drop the groups that were not renewed during the last two periods */
+      if(uip_mcast6_filter_age(mcast_filter)) {
+        mcast_filter->lifetime = mcast_filter->period;
+        mcast_filter = list_item_next(mcast_filter);
+      } else {
+        uip_mcast6_filter_rm(mcast_filter);
+        mcast_filter = uip_mcast6_filter_list_head();
+      }
+    } else {
+      mcast_filter->lifetime--;
+      mcast_filter = list_item_next(mcast_filter);
+    }
+  }
+#endif
 #endif
 }
 /*---------------------------------------------------------------------------*/
@@ -179,6 +204,9 @@ rpl_remove_routes(rpl_dag_t *dag)
   uip_ds6_route_t *r;
 #if RPL_CONF_MULTICAST
   uip_mcast6_route_t *mcast_route;
+#if UIP_MCAST6_ROUTE_FILTERS
+  uip_mcast6_filter_t *mcast_filter;
+#endif
 #endif
 
   r = uip_ds6_route_head();
@@ -203,6 +231,19 @@ rpl_remove_routes(rpl_dag_t *dag)
       mcast_route = list_item_next(mcast_route);
     }
   }
+
+#if UIP_MCAST6_ROUTE_FILTERS
+  mcast_filter = uip_mcast6_filter_list_head();
+
+  while(mcast_filter != NULL) {
+    if(mcast_filter->dag == dag) {
+      uip_mcast6_filter_rm(mcast_filter);
+      mcast_filter = uip_mcast6_filter_list_head();
+    } else {
+      mcast_filter = list_item_next(mcast_filter);
+    }
+  }
+#endif
 #endif
 }
 /*---------------------------------------------------------------------------*/
@@ -249,6 +290,139 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
   return rep;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_CONF_MULTICAST
+static void
+update_mcast_route(rpl_dag_t *dag, rpl_dao_target_t *target,
+                   uip_ipaddr_t *next_hop, uint8_t learned_from)
+{
+  uip_mcast6_route_t *mcast_route;
+#if UIP_MCAST6_ROUTE_FILTERS
+  uip_mcast6_filter_t *mcast_filter;
+  const uip_lladdr_t *lladdr;
+#endif
+
+  mcast_route = uip_mcast6_route_add(&target->prefix);
+  if(mcast_route) {
+    mcast_route->dag = dag;
+    mcast_route->lifetime = RPL_LIFETIME(dag->instance, target->lifetime);
+  }
+#if UIP_MCAST6_ROUTE_FILTERS
+  /* Remember that the group has listeners below this child. The
+     sender need not be in the neighbor cache, so take its link-layer
+     address from the DAO frame. */
+  lladdr = (const uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO &&
+     target->lifetime != RPL_ZERO_LIFETIME && lladdr != NULL) {
+    mcast_filter = uip_mcast6_filter_add(lladdr, &target->prefix);
+    if(mcast_filter) {
+      mcast_filter->dag = dag;
+      mcast_filter->period = RPL_LIFETIME(dag->instance, target->lifetime);
+      if(mcast_filter->lifetime == 0) {
+        mcast_filter->lifetime = mcast_filter->period;
+      }
+    }
+  }
+#endif
+}
+#endif /* RPL_CONF_MULTICAST */
+/*---------------------------------------------------------------------------*/
+int
+rpl_update_routes(rpl_dag_t *dag, rpl_dao_target_t *targets, int count,
+                  uip_ipaddr_t *next_hop, uint8_t learned_from)
+{
+  rpl_dao_target_t *target;
+  uip_ds6_route_t *rep;
+  int changed;
+  int i;
+
+  /*
+   * Apply all targets of a DAO in one pass. Targets that change the
+   * routing state are moved to the front of the array, so that the
+   * caller can propagate them; stale and duplicate targets are left
+   * behind.
+   */
+  changed = 0;
+  for(i = 0; i < count; i++) {
+    target = &targets[i];
+
+#if RPL_CONF_MULTICAST
+    if(uip_is_addr_mcast_global(&target->prefix)) {
+      /* Multicast groups have many listeners, so their path sequences
+         cannot be compared. */
+      update_mcast_route(dag, target, next_hop, learned_from);
+      goto propagate;
+    }
+#endif
+
+    rep = uip_ds6_route_lookup(&target->prefix);
+
+    if(target->lifetime == RPL_ZERO_LIFETIME) {
+      /* No-Path DAO; schedule the route for removal if it goes
+         through the sender. */
+      if(rep != NULL &&
+         rep->state.nopath_received == 0 &&
+         rep->length == target->prefixlen &&
+         uip_ds6_route_nexthop(rep) != NULL &&
+         uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), next_hop)) {
+        PRINTF("RPL: Setting expiration timer for prefix ");
+        PRINT6ADDR(&target->prefix);
+        PRINTF("\n");
+        rep->state.nopath_received = 1;
+        rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
+        goto propagate;
+      }
+      continue;
+    }
+
+    /*
+     * Path sequences are only compared for routes through the same
+     * next hop. A target that moves to another next hop is always
+     * accepted, and so is path sequence 0, which older Contiki nodes
+     * and other stacks send with every DAO.
+     */
+    if(rep != NULL &&
+       rep->length == target->prefixlen &&
+       rep->state.learned_from == learned_from &&
+       target->path_sequence != 0 &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), next_hop) &&
+       !RPL_LOLLIPOP_GREATER_THAN(target->path_sequence,
+                                  rep->state.path_sequence)) {
+      if(target->path_sequence == rep->state.path_sequence &&
+         rep->state.nopath_received == 0) {
+        /* Another copy of a DAO that we have already propagated. */
+        rep->state.lifetime = RPL_LIFETIME(dag->instance, target->lifetime);
+      } else {
+        PRINTF("RPL: Ignoring stale DAO target ");
+        PRINT6ADDR(&target->prefix);
+        PRINTF(" (path sequence %u, have %u)\n",
+               target->path_sequence, rep->state.path_sequence);
+      }
+      continue;
+    }
+
+    rep = rpl_add_route(dag, &target->prefix, target->prefixlen, next_hop);
+    if(rep == NULL) {
+      RPL_STAT(rpl_stats.mem_overflows++);
+      PRINTF("RPL: Could not add a route after receiving a DAO\n");
+      continue;
+    }
+
+    rep->state.lifetime = RPL_LIFETIME(dag->instance, target->lifetime);
+    rep->state.learned_from = learned_from;
+    rep->state.nopath_received = 0;
+    rep->state.path_sequence = target->path_sequence;
+
+  propagate:
+    if(i != changed) {
+      memcpy(&targets[changed], target, sizeof(*target));
+    }
+    changed++;
+  }
+
+  return changed;
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
 {
@@ -269,7 +443,6 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
         parent->flags |= RPL_PARENT_FLAG_UPDATED;
         if(instance->of->neighbor_link_callback != NULL) {
           instance->of->neighbor_link_callback(parent, status, numtx);
-          parent->last_tx_time = clock_time();
         }
       }
     }
@@ -346,6 +519,10 @@ rpl_init(void)
   memset(&rpl_stats, 0, sizeof(rpl_stats));
 #endif
 
+#if RPL_SHAPER
+  rpl_shaper_init();
+#endif
+
   RPL_OF.reset(NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -43,6 +43,7 @@
 #include "lib/list.h"
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/link-stats.h"
 #include "sys/ctimer.h"
 
 /*---------------------------------------------------------------------------*/
@@ -105,15 +106,15 @@ struct rpl_instance;
 struct rpl_dag;
 /*---------------------------------------------------------------------------*/
 #define RPL_PARENT_FLAG_UPDATED           0x1
-#define RPL_PARENT_FLAG_LINK_METRIC_VALID 0x2
 
 struct rpl_parent {
+  struct rpl_parent *next; /* Parents are ordered by increasing path cost */
   struct rpl_dag *dag;
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
   rpl_metric_container_t mc;
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
   rpl_rank_t rank;
-  clock_time_t last_tx_time;
+  uint16_t path_cost;
   uint8_t dtsn;
   uint8_t flags;
 };
@@ -164,6 +165,14 @@ typedef struct rpl_instance rpl_instance_t;
  * best_parent(parent1, parent2)
  *
  *  Compares two parents and returns the best one, according to the OF.
+ *  This is only used to decide whether a parent is better enough than the
+ *  preferred parent to replace it.
+ *
+ * parent_path_cost(parent)
+ *
+ *  Returns the cost of the path to the root through a parent, used to keep
+ *  the parents ordered. A parent with a lower cost is a better parent,
+ *  ignoring hysteresis.
  *
  * best_dag(dag1, dag2)
  *
@@ -186,6 +195,7 @@ struct rpl_of {
   void (*reset)(struct rpl_dag *);
   void (*neighbor_link_callback)(rpl_parent_t *, int, int);
   rpl_parent_t *(*best_parent)(rpl_parent_t *, rpl_parent_t *);
+  uint16_t (*parent_path_cost)(rpl_parent_t *);
   rpl_dag_t *(*best_dag)(rpl_dag_t *, rpl_dag_t *);
   rpl_rank_t (*calculate_rank)(rpl_parent_t *, rpl_rank_t);
   void (*update_metric_container)( rpl_instance_t *);
@@ -252,7 +262,8 @@ uint8_t rpl_invert_header(void);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
-uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
+uint16_t rpl_get_parent_link_metric(rpl_parent_t *p);
+const struct link_stats *rpl_get_parent_link_stats(rpl_parent_t *p);
 void rpl_dag_init(void);
 uip_ds6_nbr_t *rpl_get_nbr(rpl_parent_t *parent);
 void rpl_print_neighbor_list();
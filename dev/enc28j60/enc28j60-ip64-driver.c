@@ -80,15 +80,20 @@ output(uint8_t *packet, uint16_t len)
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(enc28j60_ip64_driver_process, ev, data)
 {
-  static int len;
+  static int len, n;
   static struct etimer e;
   PROCESS_BEGIN();
 
   while(1) {
     etimer_set(&e, 1);
     PROCESS_WAIT_EVENT();
-    len = enc28j60_read(ip64_packet_buffer, ip64_packet_buffer_maxlen);
-    if(len > 0) {
+    /* Drain up to a batch of packets each time we are polled, rather
+       than a single packet per clock tick. */
+    for(n = 0; n < IP64_INPUT_BATCH; n++) {
+      len = enc28j60_read(ip64_packet_buffer, ip64_packet_buffer_maxlen);
+      if(len <= 0) {
+        break;
+      }
       IP64_INPUT(ip64_packet_buffer, len);
     }
   }
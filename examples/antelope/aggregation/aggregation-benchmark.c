@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	A benchmark that compares grouped aggregation in a single
+ *	streaming pass (GROUP BY) with computing the same aggregates by
+ *	first materializing a selection for each group in storage.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "contiki.h"
+#include "dev/watchdog.h"
+
+#include "antelope.h"
+
+#ifndef BENCHMARK_TUPLES
+#define BENCHMARK_TUPLES	256
+#endif
+
+#ifndef BENCHMARK_GROUPS
+#define BENCHMARK_GROUPS	DB_GROUP_TABLE_SIZE
+#endif
+
+struct query_cost {
+  clock_time_t time;
+  unsigned long rows_stored;
+  unsigned long bytes_stored;
+  unsigned long rows_returned;
+};
+
+PROCESS(aggregation_benchmark, "Aggregation benchmark");
+AUTOSTART_PROCESSES(&aggregation_benchmark);
+
+static db_result_t
+run_query(struct query_cost *cost, int stored, const char *format, ...)
+{
+  static db_handle_t handle;
+  static char query[AQL_MAX_QUERY_LENGTH];
+  va_list ap;
+  db_result_t result;
+  clock_time_t start;
+
+  va_start(ap, format);
+  vsnprintf(query, sizeof(query), format, ap);
+  va_end(ap);
+
+  start = clock_time();
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    printf("Query \"%s\" failed: %s\n", query, db_get_result_message(result));
+    db_free(&handle);
+    return result;
+  }
+
+  while(db_processing(&handle)) {
+    watchdog_periodic();
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW) {
+      cost->rows_returned++;
+      if(stored) {
+        /* Every row of an assigned result is written to storage. */
+        cost->rows_stored++;
+        cost->bytes_stored += handle.result_rel->row_length;
+      }
+    } else if(result != DB_OK) {
+      if(DB_ERROR(result)) {
+        printf("Processing \"%s\" failed: %s\n",
+               query, db_get_result_message(result));
+      }
+      db_free(&handle);
+      break;
+    }
+  }
+
+  cost->time += clock_time() - start;
+
+  return DB_ERROR(result) ? result : DB_OK;
+}
+
+static void
+print_cost(const char *name, struct query_cost *cost)
+{
+  printf("%s: %lu ms, %lu rows returned, %lu rows (%lu bytes) stored\n",
+         name, (unsigned long)cost->time * 1000 / CLOCK_SECOND,
+         cost->rows_returned, cost->rows_stored, cost->bytes_stored);
+}
+
+PROCESS_THREAD(aggregation_benchmark, ev, data)
+{
+  static struct query_cost streaming;
+  static struct query_cost materializing;
+  static unsigned i;
+
+  PROCESS_BEGIN();
+
+  db_init();
+
+  printf("Populating the relation with %u tuples in %u groups\n",
+         (unsigned)BENCHMARK_TUPLES, (unsigned)BENCHMARK_GROUPS);
+
+  db_query(NULL, "REMOVE RELATION samples;");
+  db_query(NULL, "CREATE RELATION samples;");
+  db_query(NULL, "CREATE ATTRIBUTE sensor DOMAIN INT IN samples;");
+  db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN samples;");
+
+  for(i = 0; i < BENCHMARK_TUPLES; i++) {
+    watchdog_periodic();
+    if(DB_ERROR(db_query(NULL, "INSERT (%u, %u) INTO samples;",
+                         i % BENCHMARK_GROUPS, i))) {
+      printf("Failed to insert tuple %u\n", i);
+      PROCESS_EXIT();
+    }
+  }
+
+  /* Aggregate all groups in a single pass, keeping the aggregation
+     state of each group in RAM. */
+  run_query(&streaming, 0,
+            "SELECT sensor, SUM(value), MAX(value) FROM samples "
+            "GROUP BY sensor;");
+
+  /* Compute the same result by materializing each group into a
+     relation in storage, and then aggregating that relation. */
+  for(i = 0; i < BENCHMARK_GROUPS; i++) {
+    if(DB_ERROR(run_query(&materializing, 1,
+                          "grp <- SELECT value FROM samples "
+                          "WHERE sensor = %u;", i)) ||
+       DB_ERROR(run_query(&materializing, 0,
+                          "SELECT SUM(value), MAX(value) FROM grp;"))) {
+      break;
+    }
+  }
+  /* Only count the aggregated rows as results. */
+  materializing.rows_returned -= materializing.rows_stored;
+
+  db_query(NULL, "REMOVE RELATION grp;");
+  db_query(NULL, "REMOVE RELATION samples;");
+
+  print_cost("GROUP BY", &streaming);
+  print_cost("Materialized", &materializing);
+
+  PROCESS_END();
+}
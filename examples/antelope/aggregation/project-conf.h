@@ -0,0 +1,14 @@
+#undef QUEUEBUF_CONF_NUM
+#define QUEUEBUF_CONF_NUM	4
+
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC       nullrdc_driver
+
+#undef DB_FEATURE_GROUP
+#define DB_FEATURE_GROUP	1
+
+#ifdef CONTIKI_TARGET_NATIVE
+/* The native platform stores relations through the POSIX file system. */
+#undef DB_FEATURE_COFFEE
+#define DB_FEATURE_COFFEE	0
+#endif /* CONTIKI_TARGET_NATIVE */
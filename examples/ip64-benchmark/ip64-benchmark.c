@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	A benchmark that measures how fast the ip64 module translates
+ *	UDP datagrams when a large number of address mappings are in
+ *	use. Datagrams from BENCHMARK_FLOWS IPv6 hosts are translated
+ *	to IPv4 with ip64_6to4(), and a reply to each is translated
+ *	back with ip64_4to6(). The IPv6 datagrams are then translated
+ *	again in place, the way the ip64 Ethernet interface does it. The
+ *	null driver is used, so nothing is sent.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "dev/watchdog.h"
+#include "ip64.h"
+#include "ip64-addrmap.h"
+
+#ifndef BENCHMARK_FLOWS
+#define BENCHMARK_FLOWS		1000
+#endif
+
+#ifndef BENCHMARK_PACKETS
+#define BENCHMARK_PACKETS	1000000UL
+#endif
+
+#ifndef PAYLOAD_LEN
+#define PAYLOAD_LEN	64
+#endif
+
+#define IPV6_HDRLEN	40
+#define IPV4_HDRLEN	20
+#define UDP_HDRLEN	8
+
+#define SERVER_PORT	5683
+#define CLIENT_PORT	50000
+
+static uint8_t packet6[IPV6_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN];
+static uint8_t packet4[IPV4_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN];
+static uint8_t result[UIP_BUFSIZE];
+static uint16_t mapped_ports[BENCHMARK_FLOWS];
+static uint16_t udpsum4;
+
+PROCESS(ip64_benchmark, "ip64 translation benchmark");
+AUTOSTART_PROCESSES(&ip64_benchmark);
+/*---------------------------------------------------------------------------*/
+static uint16_t
+chksum(uint32_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t i;
+
+  for(i = 0; i + 1 < len; i += 2) {
+    sum += (data[i] << 8) + data[i + 1];
+  }
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_packets(void)
+{
+  uint16_t sum;
+
+  memset(packet6, 0, sizeof(packet6));
+  packet6[0] = 0x60;
+  packet6[4] = (UDP_HDRLEN + PAYLOAD_LEN) >> 8;
+  packet6[5] = (UDP_HDRLEN + PAYLOAD_LEN) & 0xff;
+  packet6[6] = UIP_PROTO_UDP;
+  packet6[7] = 64;
+  /* Source fd00::<flow>, destination ::ffff:192.0.2.1. */
+  packet6[8] = 0xfd;
+  packet6[34] = packet6[35] = 0xff;
+  packet6[36] = 192;
+  packet6[38] = 2;
+  packet6[39] = 1;
+  packet6[40] = CLIENT_PORT >> 8;
+  packet6[41] = CLIENT_PORT & 0xff;
+  packet6[42] = SERVER_PORT >> 8;
+  packet6[43] = SERVER_PORT & 0xff;
+  packet6[44] = (UDP_HDRLEN + PAYLOAD_LEN) >> 8;
+  packet6[45] = (UDP_HDRLEN + PAYLOAD_LEN) & 0xff;
+  memset(&packet6[IPV6_HDRLEN + UDP_HDRLEN], 'x', PAYLOAD_LEN);
+  sum = chksum(UDP_HDRLEN + PAYLOAD_LEN + UIP_PROTO_UDP, &packet6[8], 32);
+  sum = ~chksum(sum, &packet6[IPV6_HDRLEN], UDP_HDRLEN + PAYLOAD_LEN);
+  packet6[46] = sum >> 8;
+  packet6[47] = sum & 0xff;
+
+  memset(packet4, 0, sizeof(packet4));
+  packet4[0] = 0x45;
+  packet4[2] = sizeof(packet4) >> 8;
+  packet4[3] = sizeof(packet4) & 0xff;
+  packet4[8] = 64;
+  packet4[9] = UIP_PROTO_UDP;
+  /* Source 192.0.2.1, destination 10.0.0.1. */
+  packet4[12] = 192;
+  packet4[14] = 2;
+  packet4[15] = 1;
+  packet4[16] = 10;
+  packet4[19] = 1;
+  packet4[20] = SERVER_PORT >> 8;
+  packet4[21] = SERVER_PORT & 0xff;
+  packet4[24] = (UDP_HDRLEN + PAYLOAD_LEN) >> 8;
+  packet4[25] = (UDP_HDRLEN + PAYLOAD_LEN) & 0xff;
+  memset(&packet4[IPV4_HDRLEN + UDP_HDRLEN], 'x', PAYLOAD_LEN);
+  sum = ~chksum(0, packet4, IPV4_HDRLEN);
+  packet4[10] = sum >> 8;
+  packet4[11] = sum & 0xff;
+  /* The UDP checksum is completed with the mapped port of each flow
+     in translate_4to6(). */
+  sum = chksum(UDP_HDRLEN + PAYLOAD_LEN + UIP_PROTO_UDP, &packet4[12], 8);
+  udpsum4 = chksum(sum, &packet4[IPV4_HDRLEN], UDP_HDRLEN + PAYLOAD_LEN);
+}
+/*---------------------------------------------------------------------------*/
+static int
+translate_6to4(uint16_t flow)
+{
+  int len;
+
+  packet6[22] = flow >> 8;
+  packet6[23] = flow & 0xff;
+  len = ip64_6to4(packet6, sizeof(packet6), result);
+  if(len > 0) {
+    /* The source port of the IPv4 datagram is the mapped port. */
+    mapped_ports[flow] = (result[IPV4_HDRLEN] << 8) + result[IPV4_HDRLEN + 1];
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+translate_4to6(uint16_t flow)
+{
+  int len;
+  uint16_t sum;
+
+  packet4[22] = mapped_ports[flow] >> 8;
+  packet4[23] = mapped_ports[flow] & 0xff;
+  sum = ~chksum(udpsum4, &packet4[22], 2);
+  packet4[26] = sum >> 8;
+  packet4[27] = sum & 0xff;
+  len = ip64_4to6(packet4, sizeof(packet4), result);
+  return len > 0 && result[38] == (flow >> 8) && result[39] == (flow & 0xff);
+}
+/*---------------------------------------------------------------------------*/
+static int
+translate_in_place(uint16_t flow)
+{
+  /* The translation overwrites the headers, so they are put back
+     before each datagram. The payload stays where it is. */
+  memcpy(result, packet6, IPV6_HDRLEN + UDP_HDRLEN);
+  result[22] = flow >> 8;
+  result[23] = flow & 0xff;
+  return ip64_6to4(result, sizeof(packet6), &result[IP64_6TO4_OFFSET]);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ip64_benchmark, ev, data)
+{
+  static unsigned long i, translated;
+  static clock_time_t start;
+  static uint16_t flows;
+  uip_ip4addr_t addr, netmask;
+
+  PROCESS_BEGIN();
+
+  ip64_init();
+  uip_ipaddr(&addr, 10, 0, 0, 1);
+  uip_ipaddr(&netmask, 255, 255, 255, 0);
+  ip64_set_ipv4_address(&addr, &netmask);
+
+  build_packets();
+
+  for(flows = 0; flows < BENCHMARK_FLOWS; flows++) {
+    if(translate_6to4(flows) == 0) {
+      break;
+    }
+  }
+  printf("Set up %u address mappings\n", flows);
+  if(flows == 0) {
+    PROCESS_EXIT();
+  }
+
+  translated = 0;
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    if(translate_6to4(i % flows) > 0) {
+      translated++;
+    }
+  }
+  printf("Translated %lu of %lu IPv6 datagrams in %lu ms\n",
+         translated, BENCHMARK_PACKETS,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND));
+
+  translated = 0;
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    if(translate_4to6(i % flows)) {
+      translated++;
+    }
+  }
+  printf("Translated %lu of %lu IPv4 datagrams in %lu ms\n",
+         translated, BENCHMARK_PACKETS,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND));
+
+  memcpy(result, packet6, sizeof(packet6));
+  translated = 0;
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    if(translate_in_place(i % flows) > 0) {
+      translated++;
+    }
+  }
+  printf("Translated %lu of %lu IPv6 datagrams in place in %lu ms\n",
+         translated, BENCHMARK_PACKETS,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND));
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -41,6 +41,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl.h"
+#include "net/rpl/rpl-shaper.h"
 
 #include "net/netstack.h"
 #include "dev/button-sensor.h"
@@ -145,6 +146,10 @@ PT_THREAD(generate_routes(struct httpd_state *s))
 {
   static uip_ds6_route_t *r;
   static uip_ds6_nbr_t *nbr;
+#if RPL_SHAPER
+  static struct rpl_shaper_subtree *st;
+  static const linkaddr_t *lladdr;
+#endif
 #if BUF_USES_STACK
   char buf[256];
 #endif
@@ -259,6 +264,33 @@ PT_THREAD(generate_routes(struct httpd_state *s))
   }
   ADD("</pre>");
 
+#if RPL_SHAPER
+  ADD("Shaping<pre>");
+  SEND_STRING(&s->sout, buf);
+#if BUF_USES_STACK
+  bufptr = buf; bufend = bufptr + sizeof(buf);
+#else
+  blen = 0;
+#endif
+
+  for(st = rpl_shaper_head(); st != NULL; st = rpl_shaper_next(st)) {
+    lladdr = rpl_shaper_lladdr(st);
+    ADD("%02x%02x: %u routes, %u.%02u pkt/s, queue %u, sent %u, delayed %u, dropped %u\n",
+        lladdr->u8[LINKADDR_SIZE - 2], lladdr->u8[LINKADDR_SIZE - 1],
+        st->routes, (unsigned)(st->rate / RPL_SHAPER_TOKEN_SCALE),
+        (unsigned)((100 * (st->rate % RPL_SHAPER_TOKEN_SCALE)) /
+                   RPL_SHAPER_TOKEN_SCALE),
+        st->queue_len, st->sent, st->delayed, st->drops);
+    SEND_STRING(&s->sout, buf);
+#if BUF_USES_STACK
+    bufptr = buf; bufend = bufptr + sizeof(buf);
+#else
+    blen = 0;
+#endif
+  }
+  ADD("</pre>");
+#endif /* RPL_SHAPER */
+
 #if WEBSERVER_CONF_FILESTATS
   static uint16_t numtimes;
   ADD("<br><i>This page sent %u times</i>",++numtimes);
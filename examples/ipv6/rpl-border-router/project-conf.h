@@ -47,6 +47,11 @@
 #define UIP_CONF_RECEIVE_WINDOW  60
 #endif
 
+/* Pace traffic from the backbone into the DAG */
+#ifndef RPL_CONF_SHAPER
+#define RPL_CONF_SHAPER 1
+#endif
+
 #ifndef WEBSERVER_CONF_CFS_CONNS
 #define WEBSERVER_CONF_CFS_CONNS 2
 #endif
@@ -0,0 +1,14 @@
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* Room for the benchmark sockets plus the ones the stack uses. */
+#undef UIP_CONF_UDP_CONNS
+#define UIP_CONF_UDP_CONNS	1040
+
+/* Build with DEFINES=UIP_CONF_CONN_HASH=0 to compare against the
+   linear search. */
+#ifndef UIP_CONF_CONN_HASH
+#define UIP_CONF_CONN_HASH	64
+#endif
+
+#endif /* PROJECT_CONF_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	A benchmark that measures how long the IPv6 stack takes to
+ *	deliver UDP datagrams when a large number of UDP sockets are
+ *	open. Datagrams are fed directly to uip_input() and addressed to
+ *	the socket that was opened last, which is the worst case for a
+ *	linear search of the connection table.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "dev/watchdog.h"
+
+#ifndef BENCHMARK_SOCKETS
+#define BENCHMARK_SOCKETS	1024
+#endif
+
+#ifndef BENCHMARK_PACKETS
+#define BENCHMARK_PACKETS	100000UL
+#endif
+
+#define PAYLOAD_LEN	8
+
+#define UIP_IP_BUF	((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF	((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+static uint8_t packet[UIP_IPUDPH_LEN + PAYLOAD_LEN];
+static unsigned long received;
+
+PROCESS(udp_demux_benchmark, "UDP demultiplexing benchmark");
+PROCESS(udp_sink, "UDP sink");
+AUTOSTART_PROCESSES(&udp_demux_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(udp_sink, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD();
+    if(ev == tcpip_event && uip_newdata()) {
+      received++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_sockets(struct uip_udp_conn **last)
+{
+  struct uip_udp_conn *conn;
+  int n;
+
+  /* The sockets belong to the sink process, so that incoming
+     datagrams are delivered to it rather than to the benchmark
+     process while it is running. */
+  conn = NULL;
+  PROCESS_CONTEXT_BEGIN(&udp_sink);
+  for(n = 0; n < BENCHMARK_SOCKETS; n++) {
+    conn = udp_new(NULL, 0, NULL);
+    if(conn == NULL) {
+      break;
+    }
+    *last = conn;
+  }
+  PROCESS_CONTEXT_END(&udp_sink);
+
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_packet(uint16_t destport)
+{
+  uip_ds6_addr_t *lladdr;
+
+  /* Build the datagram in uip_buf to compute its checksum, and keep
+     a copy to feed the stack with. */
+  memset(uip_buf, 0, UIP_LLH_LEN + sizeof(packet));
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[1] = UIP_UDPH_LEN + PAYLOAD_LEN;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 1);
+  lladdr = uip_ds6_get_link_local(-1);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &lladdr->ipaddr);
+
+  UIP_UDP_BUF->srcport = UIP_HTONS(5683);
+  UIP_UDP_BUF->destport = destport;
+  UIP_UDP_BUF->udplen = UIP_HTONS(UIP_UDPH_LEN + PAYLOAD_LEN);
+  memcpy(&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], "datagram", PAYLOAD_LEN);
+
+  uip_len = sizeof(packet);
+  UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+  if(UIP_UDP_BUF->udpchksum == 0) {
+    UIP_UDP_BUF->udpchksum = 0xffff;
+  }
+  memcpy(packet, &uip_buf[UIP_LLH_LEN], sizeof(packet));
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(udp_demux_benchmark, ev, data)
+{
+  static struct uip_udp_conn *last;
+  static unsigned long i;
+  static clock_time_t start;
+  static int sockets;
+
+  PROCESS_BEGIN();
+
+  process_start(&udp_sink, NULL);
+
+  sockets = open_sockets(&last);
+  if(sockets == 0) {
+    printf("Could not open any UDP sockets\n");
+    PROCESS_EXIT();
+  }
+  printf("Opened %d UDP sockets (%d buckets)\n", sockets, UIP_CONN_HASH);
+
+  build_packet(last->lport);
+
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    memcpy(&uip_buf[UIP_LLH_LEN], packet, sizeof(packet));
+    uip_len = sizeof(packet);
+    uip_input();
+    uip_clear_buf();
+  }
+
+  printf("Delivered %lu of %lu datagrams to socket %d in %lu ms\n",
+         received, BENCHMARK_PACKETS, sockets,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND));
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *	A benchmark that measures how long the Chameleon module takes to
+ *	create and parse the headers of the collect and multihop Rime
+ *	channels. Build with
+ *	DEFINES=CHAMELEON_BITOPT_CONF_PROGRAMS=0 to measure the generic
+ *	bit-by-bit code of chameleon-bitopt. Both builds must print the
+ *	same header bytes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "net/rime/collect.h"
+#include "net/rime/multihop.h"
+#include "dev/watchdog.h"
+
+#ifndef BENCHMARK_PACKETS
+#define BENCHMARK_PACKETS	1000000UL
+#endif
+
+/* Each loop is timed this many times and the fastest round is
+   reported, which keeps other load on the host out of the result. */
+#ifndef BENCHMARK_ROUNDS
+#define BENCHMARK_ROUNDS	5
+#endif
+
+#define PAYLOAD_LEN	8
+
+static const struct packetbuf_attrlist collect_attributes[] = {
+  COLLECT_ATTRIBUTES
+  PACKETBUF_ATTR_LAST
+};
+static const struct packetbuf_attrlist multihop_attributes[] = {
+  MULTIHOP_ATTRIBUTES
+  PACKETBUF_ATTR_LAST
+};
+
+static struct channel collect_channel, multihop_channel;
+static uint8_t frame[PACKETBUF_SIZE];
+static int frame_len;
+
+PROCESS(chameleon_benchmark, "Chameleon header benchmark");
+AUTOSTART_PROCESSES(&chameleon_benchmark);
+/*---------------------------------------------------------------------------*/
+static packetbuf_attr_t
+attr_value(const struct packetbuf_attrlist *a)
+{
+  /* A value that fills the attribute with a mix of ones and zeros. */
+  return (0xa5c3 + a->type) & ((1UL << a->len) - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+addr_value(const struct packetbuf_attrlist *a, linkaddr_t *addr)
+{
+  int i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    addr->u8[i] = 0x81 + a->type * 16 + i;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_attributes(const struct packetbuf_attrlist *a)
+{
+  linkaddr_t addr;
+
+  for(; a->type != PACKETBUF_ATTR_NONE; ++a) {
+    if(PACKETBUF_IS_ADDR(a->type)) {
+      addr_value(a, &addr);
+      packetbuf_set_addr(a->type, &addr);
+    } else {
+      packetbuf_set_attr(a->type, attr_value(a));
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_attributes(const struct packetbuf_attrlist *a)
+{
+  linkaddr_t addr;
+
+  for(; a->type != PACKETBUF_ATTR_NONE; ++a) {
+    if(PACKETBUF_IS_ADDR(a->type)) {
+      addr_value(a, &addr);
+      if(!linkaddr_cmp(packetbuf_addr(a->type), &addr)) {
+        return 0;
+      }
+    } else if(packetbuf_attr(a->type) != attr_value(a)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+time_create(struct channel *c)
+{
+  clock_time_t t;
+  unsigned long i;
+
+  t = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    packetbuf_clear_hdr();
+    chameleon_create(c);
+  }
+  return clock_time() - t;
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+time_parse(void)
+{
+  clock_time_t t;
+  unsigned long i;
+
+  t = clock_time();
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    if((i & 0x3ff) == 0) {
+      watchdog_periodic();
+    }
+    packetbuf_copyfrom(frame, frame_len);
+    chameleon_parse();
+  }
+  return clock_time() - t;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, struct channel *c)
+{
+  clock_time_t create_time, parse_time, t;
+  int j;
+
+  packetbuf_clear();
+  packetbuf_copyfrom("payload!", PAYLOAD_LEN);
+  set_attributes(c->attrlist);
+
+  create_time = time_create(c);
+  for(j = 1; j < BENCHMARK_ROUNDS; j++) {
+    t = time_create(c);
+    if(t < create_time) {
+      create_time = t;
+    }
+  }
+
+  frame_len = packetbuf_copyto(frame);
+  printf("%s: %d header bits:", name, c->hdrsize);
+  for(j = 0; j < frame_len - PAYLOAD_LEN; j++) {
+    printf(" %02x", frame[j]);
+  }
+  printf("\n");
+
+  parse_time = time_parse();
+  for(j = 1; j < BENCHMARK_ROUNDS; j++) {
+    t = time_parse();
+    if(t < parse_time) {
+      parse_time = t;
+    }
+  }
+
+  printf("%s: created %lu headers in %lu ms, parsed in %lu ms, %s\n",
+         name, BENCHMARK_PACKETS,
+         (unsigned long)(create_time * 1000 / CLOCK_SECOND),
+         (unsigned long)(parse_time * 1000 / CLOCK_SECOND),
+         check_attributes(c->attrlist) ? "attributes match" :
+         "ATTRIBUTES DIFFER");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(chameleon_benchmark, ev, data)
+{
+  PROCESS_BEGIN();
+
+  channel_open(&collect_channel, 130);
+  channel_set_attributes(130, collect_attributes);
+  channel_open(&multihop_channel, 131);
+  channel_set_attributes(131, multihop_attributes);
+
+  run("collect", &collect_channel);
+  run("multihop", &multihop_channel);
+
+  channel_close(&collect_channel);
+  channel_close(&multihop_channel);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
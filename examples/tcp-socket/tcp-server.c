@@ -43,7 +43,11 @@ static struct tcp_socket socket;
 #define INPUTBUFSIZE 400
 static uint8_t inputbuf[INPUTBUFSIZE];
 
+/* A larger output buffer lets a windowed connection
+   (UIP_CONF_TCP_SEND_WINDOW > 1) keep several segments in flight. */
+#ifndef OUTPUTBUFSIZE
 #define OUTPUTBUFSIZE 400
+#endif
 static uint8_t outputbuf[OUTPUTBUFSIZE];
 
 PROCESS(tcp_server_process, "TCP echo process");